@@ -0,0 +1,31 @@
+// 对外接口 e3d.h 的事件分发开销。e3d.h 与 e3d.hpp 都定义了 Engine，单独放在一个编译单元中。
+
+#include <vector>
+
+#include "bench.hpp"
+#include "e3d/e3d.h"
+
+using e3d::bench::DoNotOptimize;
+using e3d::bench::State;
+
+namespace {
+
+// 按 addEventListener 的方式保存监听器，每个事件依次分发给全部监听器
+E3D_BENCHMARK("event/Dispatch16", [](State &state) {
+  constexpr size_t kListeners = 16;
+  std::vector<e3d::EventListener> listeners;
+  uint64_t handled = 0;
+  for (size_t i = 0; i < kListeners; ++i)
+    listeners.push_back([&handled, i](e3d::WindowEvent event) { handled += event.type ^ i; });
+
+  e3d::WindowEvent event{0};
+  for (auto _ : state) {
+    for (auto &listener : listeners)
+      listener(event);
+    event.type++;
+    DoNotOptimize(handled);
+  }
+  state.SetCounter("listeners", kListeners);
+});
+
+}  // namespace
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace e3d::bench {
+
+// 阻止编译器把基准测试中的计算当作无用代码删除
+template <typename T>
+inline void DoNotOptimize(const T &value) {
+#if defined(_MSC_VER)
+  static volatile const void *sink;
+  sink = &value;
+  _ReadWriteBarrier();
+#else
+  asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+inline void ClobberMemory() {
+#if defined(_MSC_VER)
+  _ReadWriteBarrier();
+#else
+  asm volatile("" : : : "memory");
+#endif
+}
+
+// 一次运行的状态。计时只覆盖 for (auto _ : state) 循环本身，循环前后的准备和清理不计入。
+class State {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit State(uint64_t iterations) : iterations_(iterations) {}
+
+  struct Value {
+    ~Value() {}  // 非平凡析构，循环变量 _ 不会触发未使用变量的警告
+  };
+
+  struct Iterator {
+    State *state;
+    uint64_t remaining;
+
+    bool operator!=(const Iterator &) {
+      if (remaining != 0)
+        return true;
+      state->stop_ = Clock::now();
+      return false;
+    }
+    void operator++() { --remaining; }
+    Value operator*() const { return {}; }
+  };
+
+  Iterator begin() {
+    start_ = Clock::now();
+    return {this, skipped_ ? 0 : iterations_};
+  }
+  Iterator end() { return {this, 0}; }
+
+  uint64_t iterations() const { return iterations_; }
+  double elapsed_ns() const { return std::chrono::duration<double, std::nano>(stop_ - start_).count(); }
+
+  // 附加的统计值，例如 GPU 帧时间，原样写入结果
+  void SetCounter(const std::string &name, double value) { counters_[name] = value; }
+  const std::map<std::string, double> &counters() const { return counters_; }
+
+  // 环境不满足（例如没有可用的 Vulkan 设备）时跳过，不参与基线比较
+  void Skip(const std::string &reason) {
+    skipped_ = true;
+    skip_reason_ = reason;
+  }
+  bool skipped() const { return skipped_; }
+  const std::string &skip_reason() const { return skip_reason_; }
+
+ private:
+  uint64_t iterations_;
+  Clock::time_point start_{};
+  Clock::time_point stop_{};
+  std::map<std::string, double> counters_;
+  bool skipped_{false};
+  std::string skip_reason_;
+};
+
+enum class Kind {
+  kMicro,  // CPU 热路径，自动确定迭代次数，多次重复取中位数
+  kMacro,  // 渲染整帧，迭代次数为帧数
+};
+
+struct Benchmark {
+  std::string name;
+  Kind kind;
+  std::function<void(State &)> fn;
+};
+
+inline std::vector<Benchmark> &Registry() {
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+struct Registrar {
+  Registrar(std::string name, Kind kind, std::function<void(State &)> fn) { Registry().push_back({std::move(name), kind, std::move(fn)}); }
+};
+
+}  // namespace e3d::bench
+
+#define E3D_BENCH_CONCAT_(a, b) a##b
+#define E3D_BENCH_CONCAT(a, b) E3D_BENCH_CONCAT_(a, b)
+
+// 在任意源文件中注册基准测试：E3D_BENCHMARK("helper/LookAt", [](e3d::bench::State &state) { ... });
+#define E3D_BENCHMARK(name, ...) \
+  static ::e3d::bench::Registrar E3D_BENCH_CONCAT(e3d_bench_registrar_, __LINE__)(name, ::e3d::bench::Kind::kMicro, __VA_ARGS__)
+#define E3D_MACRO_BENCHMARK(name, ...) \
+  static ::e3d::bench::Registrar E3D_BENCH_CONCAT(e3d_bench_registrar_, __LINE__)(name, ::e3d::bench::Kind::kMacro, __VA_ARGS__)
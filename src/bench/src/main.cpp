@@ -0,0 +1,307 @@
+// e3d_bench：运行已注册的基准测试，结果写成 JSON，并可与保存的基线比较。
+//
+//   e3d_bench [--filter substr] [--min-time ms] [--repetitions n] [--frames n] [--skip-macro]
+//             [--out result.json] [--baseline baseline.json] [--threshold pct] [--update-baseline]
+//
+// 任一基准的耗时、帧时间分位数或卡顿帧数比基线高出 threshold 百分比以上时返回 1，基线文件不存在时不做比较。
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+using namespace e3d::bench;
+
+namespace {
+
+struct Options {
+  std::string filter;
+  double min_time_ms{100.0};
+  int repetitions{5};
+  uint64_t frames{300};
+  bool skip_macro{false};
+  std::string out;
+  std::string baseline;
+  double threshold_pct{10.0};
+  bool update_baseline{false};
+};
+
+struct Result {
+  std::string name;
+  Kind kind;
+  uint64_t iterations{};
+  double ns_per_op{};  // 多次重复的中位数
+  double min_ns{};
+  double max_ns{};
+  std::map<std::string, double> counters;
+  bool skipped{false};
+  std::string skip_reason;
+};
+
+Options ParseOptions(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc)
+        throw std::runtime_error("missing value for " + arg);
+      return argv[++i];
+    };
+    if (arg == "--filter")
+      options.filter = value();
+    else if (arg == "--min-time")
+      options.min_time_ms = std::stod(value());
+    else if (arg == "--repetitions")
+      options.repetitions = std::max(1, std::stoi(value()));
+    else if (arg == "--frames")
+      options.frames = std::max<uint64_t>(1, std::stoull(value()));
+    else if (arg == "--skip-macro")
+      options.skip_macro = true;
+    else if (arg == "--out")
+      options.out = value();
+    else if (arg == "--baseline")
+      options.baseline = value();
+    else if (arg == "--threshold")
+      options.threshold_pct = std::stod(value());
+    else if (arg == "--update-baseline")
+      options.update_baseline = true;
+    else
+      throw std::runtime_error("unknown option " + arg);
+  }
+  if (options.update_baseline && options.baseline.empty())
+    throw std::runtime_error("--update-baseline requires --baseline");
+  return options;
+}
+
+double RunOnce(const Benchmark &benchmark, uint64_t iterations, Result &result) {
+  State state(iterations);
+  benchmark.fn(state);
+  result.counters = state.counters();
+  if (state.skipped()) {
+    result.skipped = true;
+    result.skip_reason = state.skip_reason();
+    return 0.0;
+  }
+  return state.elapsed_ns() / double(iterations);
+}
+
+Result Run(const Benchmark &benchmark, const Options &options) {
+  Result result;
+  result.name = benchmark.name;
+  result.kind = benchmark.kind;
+
+  uint64_t iterations = options.frames;
+  if (benchmark.kind == Kind::kMicro) {
+    // 逐步放大迭代次数，直到单次运行时间不少于 min_time
+    iterations = 1;
+    for (;;) {
+      double ns = RunOnce(benchmark, iterations, result) * double(iterations);
+      if (result.skipped)
+        return result;
+      if (ns >= options.min_time_ms * 1e6 || iterations >= (uint64_t(1) << 40))
+        break;
+      double scale = ns > 0.0 ? options.min_time_ms * 1e6 / ns * 1.4 : 10.0;
+      iterations = std::max(iterations + 1, uint64_t(double(iterations) * std::min(scale, 10.0)));
+    }
+  }
+  result.iterations = iterations;
+
+  // 宏基准每次都要创建设备和渲染 N 帧，只运行一次
+  int repetitions = benchmark.kind == Kind::kMicro ? options.repetitions : 1;
+  std::vector<double> samples;
+  for (int i = 0; i < repetitions; ++i) {
+    double ns = RunOnce(benchmark, iterations, result);
+    if (result.skipped)
+      return result;
+    samples.push_back(ns);
+  }
+  std::sort(samples.begin(), samples.end());
+  result.ns_per_op = samples[samples.size() / 2];
+  result.min_ns = samples.front();
+  result.max_ns = samples.back();
+  return result;
+}
+
+std::string Escape(const std::string &s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+void WriteJson(const std::string &path, const std::vector<Result> &results) {
+  std::ofstream file(path);
+  if (!file)
+    throw std::runtime_error("failed to open " + path);
+
+  file << std::setprecision(6) << "{\n  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto &r = results[i];
+    file << "    {\"name\": \"" << Escape(r.name) << "\", \"kind\": \"" << (r.kind == Kind::kMicro ? "micro" : "macro") << "\"";
+    if (r.skipped) {
+      file << ", \"skipped\": true, \"reason\": \"" << Escape(r.skip_reason) << "\"}";
+    } else {
+      file << ", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << r.ns_per_op << ", \"min_ns\": " << r.min_ns << ", \"max_ns\": " << r.max_ns
+           << ", \"counters\": {";
+      bool first = true;
+      for (const auto &[name, value] : r.counters) {
+        file << (first ? "" : ", ") << "\"" << Escape(name) << "\": " << value;
+        first = false;
+      }
+      file << "}}";
+    }
+    file << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  file << "  ]\n}\n";
+}
+
+// 只读取自己写出的格式：每个基准一行，取 name、ns_per_op 和 counters 中的各项。
+// 基线文件不存在时（例如新检出、还没有在本机生成基线）返回空基线，所有结果都按新基准处理。
+using Baseline = std::map<std::string, std::map<std::string, double>>;
+
+Baseline ReadBaseline(const std::string &path) {
+  Baseline baseline;
+  std::ifstream file(path);
+  if (!file) {
+    std::cout << "\nno baseline at " << path << ", run with --update-baseline to create one\n";
+    return baseline;
+  }
+
+  std::string line;
+  while (std::getline(file, line)) {
+    auto name_pos = line.find("\"name\": \"");
+    auto ns_pos = line.find("\"ns_per_op\": ");
+    if (name_pos == std::string::npos || ns_pos == std::string::npos)
+      continue;
+    name_pos += 9;
+    auto name_end = line.find('"', name_pos);
+    auto &metrics = baseline[line.substr(name_pos, name_end - name_pos)];
+    metrics["ns_per_op"] = std::strtod(line.c_str() + ns_pos + 13, nullptr);
+
+    auto pos = line.find("\"counters\": {");
+    if (pos == std::string::npos)
+      continue;
+    for (pos += 13; (pos = line.find('"', pos)) != std::string::npos;) {
+      auto key_end = line.find("\": ", pos + 1);
+      if (key_end == std::string::npos)
+        break;
+      metrics[line.substr(pos + 1, key_end - pos - 1)] = std::strtod(line.c_str() + key_end + 3, nullptr);
+      pos = line.find_first_of(",}", key_end);
+    }
+  }
+  return baseline;
+}
+
+// 参与回退判定的指标：每次操作耗时、帧时间分位数和卡顿帧数。其余计数器只是描述工作量，不做比较。
+bool IsGated(const std::string &metric) {
+  auto ends_with = [&](const char *suffix) {
+    std::string s(suffix);
+    return metric.size() >= s.size() && metric.compare(metric.size() - s.size(), s.size(), s) == 0;
+  };
+  return metric == "ns_per_op" || metric == "hitches" || ends_with("_p50_ms") || ends_with("_p95_ms") || ends_with("_p99_ms");
+}
+
+// 打印与基线的差异，返回回退的指标数
+int Compare(const std::vector<Result> &results, const Baseline &baseline, double threshold_pct) {
+  int regressions = 0;
+  std::cout << "\ncomparison against baseline (threshold " << threshold_pct << "%):\n";
+  for (const auto &r : results) {
+    if (r.skipped)
+      continue;
+    auto it = baseline.find(r.name);
+    if (it == baseline.end()) {
+      std::cout << "  " << std::left << std::setw(36) << r.name << " new\n";
+      continue;
+    }
+
+    std::vector<std::pair<std::string, double>> current{{"ns_per_op", r.ns_per_op}};
+    current.insert(current.end(), r.counters.begin(), r.counters.end());
+    for (const auto &[metric, value] : current) {
+      if (!IsGated(metric))
+        continue;
+      auto base = it->second.find(metric);
+      if (base == it->second.end())
+        continue;
+      // 卡顿帧数的基线常为 0，按至少 1 帧计算相对变化，避免除零，同时一帧新卡顿也会超出阈值
+      double reference = metric == "hitches" ? std::max(base->second, 1.0) : base->second;
+      if (reference <= 0.0)
+        continue;
+      double delta = (value - base->second) / reference * 100.0;
+      bool regressed = delta > threshold_pct;
+      regressions += regressed;
+      std::string label = metric == "ns_per_op" ? r.name : r.name + " " + metric;
+      std::cout << "  " << std::left << std::setw(36) << label << std::right << std::fixed << std::setprecision(1) << std::setw(8) << std::showpos << delta
+                << std::noshowpos << "%" << (regressed ? "  REGRESSION" : "") << "\n";
+      std::cout.unsetf(std::ios::floatfield);
+    }
+  }
+  return regressions;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  try {
+    Options options = ParseOptions(argc, argv);
+
+    std::vector<Result> results;
+    for (const auto &benchmark : Registry()) {
+      if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos)
+        continue;
+      if (options.skip_macro && benchmark.kind == Kind::kMacro)
+        continue;
+
+      Result result = Run(benchmark, options);
+      if (result.skipped) {
+        std::cout << std::left << std::setw(36) << result.name << " skipped: " << result.skip_reason << "\n";
+      } else {
+        std::cout << std::left << std::setw(36) << result.name << std::right << std::setw(14) << std::fixed << std::setprecision(2) << result.ns_per_op
+                  << " ns/op  (min " << result.min_ns << ", max " << result.max_ns << ", " << result.iterations << " iterations)";
+        std::cout.unsetf(std::ios::floatfield);
+        for (const auto &[name, value] : result.counters)
+          std::cout << "  " << name << "=" << value;
+        std::cout << "\n";
+      }
+      results.push_back(std::move(result));
+    }
+
+    if (!options.out.empty())
+      WriteJson(options.out, results);
+
+    if (options.update_baseline) {
+      WriteJson(options.baseline, results);
+      std::cout << "baseline written to " << options.baseline << "\n";
+      return 0;
+    }
+
+    if (!options.baseline.empty()) {
+      int regressions = Compare(results, ReadBaseline(options.baseline), options.threshold_pct);
+      if (regressions > 0) {
+        std::cout << regressions << " metric(s) regressed\n";
+        return 1;
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "e3d_bench: " << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,342 @@
+// CPU 热路径的微基准：数学辅助函数、UBO 打包、变换更新、LOD 选择/剔除和空间查询
+
+#include <cstring>
+#include <random>
+
+#include "bench.hpp"
+#include "e3d/e3d.hpp"
+
+using e3d::bench::DoNotOptimize;
+using e3d::bench::State;
+
+namespace {
+
+E3D_BENCHMARK("helper/LookAt", [](State &state) {
+  Eigen::Vector3f eye(2.0f, 2.0f, 2.0f), center(0.0f, 0.0f, 0.0f), up(0.0f, 0.0f, 1.0f);
+  for (auto _ : state) {
+    DoNotOptimize(eye);
+    Eigen::Matrix4f view = e3d::helper::LookAt(eye, center, up);
+    DoNotOptimize(view);
+  }
+});
+
+E3D_BENCHMARK("helper/Perspective", [](State &state) {
+  float fov = 45.0f * float(M_PI) / 180.0f, aspect = 16.0f / 9.0f;
+  for (auto _ : state) {
+    DoNotOptimize(fov);
+    Eigen::Matrix4f proj = e3d::helper::Perspective(fov, aspect, 0.1f, 100.0f);
+    DoNotOptimize(proj);
+  }
+});
+
+E3D_BENCHMARK("helper/ColorU32ToF32", [](State &state) {
+  uint32_t color = 0x3366ccff;
+  for (auto _ : state) {
+    DoNotOptimize(color);
+    auto rgba = e3d::helper::ColorU32ToF32(color);
+    DoNotOptimize(rgba);
+    color += 0x01010101;
+  }
+});
+
+// 与 SceneRenderer::UpdateUniformBuffer 相同的打包方式，写入模拟的映射内存
+E3D_BENCHMARK("uniform/Pack", [](State &state) {
+  alignas(64) unsigned char mapped[sizeof(e3d::Uniform)];
+  Eigen::Matrix4f view = e3d::helper::LookAt(Eigen::Vector3f(2.0f, 2.0f, 2.0f), Eigen::Vector3f::Zero(), Eigen::Vector3f::UnitZ());
+  Eigen::Matrix4f proj = e3d::helper::PerspectiveReverseZ(45.0f * float(M_PI) / 180.0f, 16.0f / 9.0f, 0.1f);
+  for (auto _ : state) {
+    e3d::Uniform ubo{};
+    ubo.view = view;
+    ubo.proj = proj;
+    memcpy(mapped, &ubo, sizeof(ubo));
+    DoNotOptimize(mapped);
+  }
+  state.SetCounter("bytes", sizeof(e3d::Uniform));
+});
+
+// 每帧为所有对象重新计算模型矩阵并写入 push constant 数组
+E3D_BENCHMARK("transform/Update1024", [](State &state) {
+  constexpr size_t kObjects = 1024;
+  std::vector<Eigen::Vector3f> translations(kObjects);
+  std::vector<e3d::DrawConstants> constants(kObjects);
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+  for (auto &t : translations)
+    t = Eigen::Vector3f(dist(rng), dist(rng), dist(rng));
+
+  float time = 0.0f;
+  for (auto _ : state) {
+    Eigen::Matrix3f rotation = Eigen::AngleAxisf(time, Eigen::Vector3f::UnitZ()).toRotationMatrix();
+    for (size_t i = 0; i < kObjects; ++i) {
+      Eigen::Isometry3f model = Eigen::Isometry3f::Identity();
+      model.translate(translations[i]);
+      model.rotate(rotation);
+      constants[i].model = model.matrix();
+    }
+    DoNotOptimize(constants.data());
+    time += 0.01f;
+  }
+  state.SetCounter("objects", kObjects);
+});
+
+// 过小对象和整个位于近平面之前的对象的剔除、LOD 选择和三角形预算（不做视锥剔除），对应 SceneRenderer::Render 中的 SelectAll
+E3D_BENCHMARK("culling/SelectAll4096", [](State &state) {
+  constexpr size_t kObjects = 4096;
+  std::vector<e3d::meshopt::MeshLod> lods = {{0, 3000, 0.0f}, {3000, 1500, 0.01f}, {4500, 750, 0.04f}, {5250, 375, 0.16f}};
+  std::vector<e3d::meshopt::LodSelector::Object> objects;
+  std::mt19937 rng(2);
+  std::uniform_real_distribution<float> dist(-50.0f, 50.0f);
+  for (size_t i = 0; i < kObjects; ++i)
+    objects.push_back({Eigen::Vector3f(dist(rng), dist(rng), dist(rng)), 0.5f, &lods});
+
+  e3d::meshopt::LodSelector selector;
+  selector.triangle_budget = 500000;
+  Eigen::Matrix4f view = e3d::helper::LookAt(Eigen::Vector3f(60.0f, 60.0f, 60.0f), Eigen::Vector3f::Zero(), Eigen::Vector3f::UnitZ());
+  Eigen::Matrix4f proj = e3d::helper::Perspective(45.0f * float(M_PI) / 180.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+  selector.SetCamera(view, proj, 720);
+
+  uint64_t triangles = 0;
+  for (auto _ : state) {
+    triangles = selector.SelectAll(objects);
+    DoNotOptimize(triangles);
+  }
+  state.SetCounter("objects", kObjects);
+  state.SetCounter("triangles", double(triangles));
+});
+
+// 点云节点选择：按屏幕空间密度遍历八叉树，直到用完点数预算，与点云总大小无关
+E3D_BENCHMARK("pointcloud/Select", [](State &state) {
+  std::vector<e3d::pointcloud::Point> points(1000000);
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> dist(-50.0f, 50.0f);
+  for (auto &p : points)
+    p.position = Eigen::Vector3f(dist(rng), dist(rng), 0.1f * dist(rng));
+  e3d::JobSystem jobs;
+  auto octree = e3d::pointcloud::Octree::Build(points, &jobs);
+
+  e3d::pointcloud::Selector selector;
+  selector.point_budget = 300000;
+  Eigen::Matrix4f view = e3d::helper::LookAt(Eigen::Vector3f(60.0f, 60.0f, 40.0f), Eigen::Vector3f::Zero(), Eigen::Vector3f::UnitZ());
+  Eigen::Matrix4f proj = e3d::helper::Perspective(45.0f * float(M_PI) / 180.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+  selector.SetCamera(view, proj, 720);
+
+  uint64_t selected_points = 0;
+  size_t nodes = 0;
+  for (auto _ : state) {
+    nodes = selector.Select(octree->nodes(), &selected_points).size();
+    DoNotOptimize(nodes);
+  }
+  state.SetCounter("tree_nodes", double(octree->nodes().size()));
+  state.SetCounter("nodes", double(nodes));
+  state.SetCounter("points", double(selected_points));
+});
+
+// 立即模式线段写入：每条线段一次 32 字节写入，对应 LineBatcher 每帧写入常驻映射缓冲的开销
+E3D_BENCHMARK("lines/Write1M", [](State &state) {
+  constexpr uint32_t kSegments = 1u << 20;
+  std::vector<e3d::lines::Segment> buffer(kSegments);
+  e3d::lines::LineList lines;
+  for (auto _ : state) {
+    lines.Reset(buffer.data(), kSegments);
+    for (uint32_t i = 0; i < kSegments; ++i) {
+      float x = float(i & 1023), y = float(i >> 10);
+      lines.Line(Eigen::Vector3f(x, y, 0.0f), Eigen::Vector3f(x + 1.0f, y, 0.0f), 0xFF8000FF);
+    }
+    DoNotOptimize(lines.Finish());
+  }
+  state.SetCounter("segments", kSegments);
+});
+
+// 软件遮挡剔除：街道高度的相机看向 8x8 栋建筑（立方体遮挡物），测试散布在建筑之间的 4096 个小物体。
+// 计时包含光栅化遮挡物和测试全部包围盒，即每帧的 CPU 开销
+E3D_BENCHMARK("occlusion/City4096", [](State &state) {
+  const std::vector<Eigen::Vector3f> cube = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}, {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}};
+  const std::vector<uint16_t> cube_indices = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+  std::vector<Eigen::Matrix4f> buildings;
+  for (int i = 0; i < 64; ++i) {
+    Eigen::Affine3f model = Eigen::Translation3f(float(i % 8) * 12.0f + 4.0f, float(i / 8) * 12.0f - 48.0f, 0.0f) * Eigen::Scaling(8.0f, 8.0f, 20.0f);
+    buildings.push_back(model.matrix());
+  }
+  std::vector<e3d::occlusion::Box> boxes;
+  for (int i = 0; i < 4096; ++i) {
+    Eigen::Vector3f p(float(i % 64) * 1.5f + 2.0f, float(i / 64) * 1.5f - 48.0f, 0.0f);
+    boxes.push_back({p, p + Eigen::Vector3f(0.5f, 0.5f, 1.0f)});
+  }
+
+  e3d::JobSystem jobs;
+  e3d::occlusion::OcclusionCuller culler(&jobs);
+  Eigen::Matrix4f view = e3d::helper::LookAt(Eigen::Vector3f(-2.0f, 0.0f, 1.7f), Eigen::Vector3f(10.0f, 0.0f, 1.7f), Eigen::Vector3f::UnitZ());
+  Eigen::Matrix4f proj = e3d::helper::PerspectiveReverseZ(60.0f * float(M_PI) / 180.0f, 2.0f, 0.1f);
+  std::vector<e3d::occlusion::Result> results;
+  double raster_ms = 0.0, test_ms = 0.0;
+  for (auto _ : state) {
+    culler.Begin(proj * view);
+    for (const auto &model : buildings)
+      culler.AddOccluder(cube_indices, cube.size(), [&](uint32_t i) { return cube[i]; }, model);
+    culler.Rasterize();
+    culler.Test(boxes, results);
+    raster_ms += culler.stats().raster_ms;
+    test_ms += culler.stats().test_ms;
+    DoNotOptimize(results.data());
+  }
+  double iterations = double(std::max<uint64_t>(state.iterations(), 1));
+  state.SetCounter("objects", double(boxes.size()));
+  state.SetCounter("occluder_triangles", double(culler.stats().occluder_triangles));
+  state.SetCounter("culled_ratio", culler.stats().culled_ratio());
+  state.SetCounter("occluded", double(culler.stats().occluded));
+  state.SetCounter("raster_ms", raster_ms / iterations);
+  state.SetCounter("test_ms", test_ms / iterations);
+});
+
+// 精灵批处理：每帧添加 50 万个精灵（16 种纹理、4 层，随机顺序），按 (层, 纹理) 排序后写入实例缓冲
+E3D_BENCHMARK("sprites/Build500k", [](State &state) {
+  constexpr uint32_t kSprites = 500000;
+  struct Source {
+    Eigen::Vector2f position;
+    uint32_t texture;
+    uint8_t layer;
+  };
+  std::vector<Source> sources(kSprites);
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> dist(0.0f, 1920.0f);
+  for (auto &s : sources)
+    s = {Eigen::Vector2f(dist(rng), dist(rng)), uint32_t(rng() % 16), uint8_t(rng() % 4)};
+
+  std::vector<e3d::sprites::Instance> buffer(kSprites);
+  e3d::sprites::SpriteList sprites;
+  sprites.Reserve(kSprites);
+  e3d::sprites::UvRect uv{0.0f, 0.0f, 0.25f, 0.25f};
+  size_t batches = 0;
+  for (auto _ : state) {
+    sprites.Clear();
+    for (const auto &s : sources)
+      sprites.Add(s.position, Eigen::Vector2f(8.0f, 8.0f), 0.1f, 0xFFFFFFFF, uv, s.texture, s.layer);
+    batches = sprites.Build(buffer.data(), kSprites).size();
+    DoNotOptimize(buffer.data());
+  }
+  state.SetCounter("sprites", kSprites);
+  state.SetCounter("batches", double(batches));
+  if (state.elapsed_ns() > 0.0)
+    state.SetCounter("sprites_per_ms", double(kSprites) * double(state.iterations()) / (state.elapsed_ns() * 1e-6));
+});
+
+// BVH：100 万个随机分布的小包围盒（类似大场景的实例），构建一次后各基准共用
+struct BvhScene {
+  static constexpr uint32_t kPrimitives = 1000000;
+  std::vector<e3d::bvh::Aabb> boxes;
+  e3d::JobSystem jobs;
+  e3d::bvh::Bvh bvh;
+
+  static BvhScene &Get() {
+    static BvhScene scene;
+    return scene;
+  }
+
+ private:
+  BvhScene() {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> position(0.0f, 1000.0f), size(0.5f, 2.0f);
+    boxes.reserve(kPrimitives);
+    for (uint32_t i = 0; i < kPrimitives; ++i) {
+      Eigen::Vector3f p(position(rng), position(rng), position(rng));
+      boxes.emplace_back(p, p + Eigen::Vector3f(size(rng), size(rng), size(rng)));
+    }
+    bvh.Build(boxes, &jobs);
+  }
+};
+
+E3D_BENCHMARK("bvh/Build1M", [](State &state) {
+  auto &scene = BvhScene::Get();
+  e3d::bvh::Bvh bvh;
+  for (auto _ : state) {
+    bvh.Build(scene.boxes, &scene.jobs);
+    DoNotOptimize(bvh.nodes().data());
+  }
+  state.SetCounter("primitives", double(scene.boxes.size()));
+  state.SetCounter("nodes", double(bvh.nodes().size()));
+});
+
+// 每帧移动 1% 的图元后 Refit，只重新计算从这些图元到根的节点
+E3D_BENCHMARK("bvh/Refit1M", [](State &state) {
+  auto &scene = BvhScene::Get();
+  constexpr uint32_t kMoved = 10000;
+  std::mt19937 rng(12);
+  std::vector<uint32_t> moved(kMoved);
+  for (auto &m : moved)
+    m = rng() % BvhScene::kPrimitives;
+  float offset = 0.0f;
+  for (auto _ : state) {
+    offset = offset == 0.0f ? 0.25f : 0.0f;
+    for (uint32_t m : moved) {
+      const auto &box = scene.boxes[m];
+      Eigen::Vector3f shift = Eigen::Vector3f::Constant(offset);
+      scene.bvh.Update(m, {box.min + shift, box.max + shift});
+    }
+    scene.bvh.Refit();
+  }
+  for (uint32_t m : moved)
+    scene.bvh.Update(m, scene.boxes[m]);
+  scene.bvh.Refit();
+  state.SetCounter("moved", kMoved);
+});
+
+// 随机方向的射线求最近交点（与包围盒求交），对应每次拾取的开销
+E3D_BENCHMARK("bvh/Raycast1M", [](State &state) {
+  auto &scene = BvhScene::Get();
+  constexpr uint32_t kRays = 4096;
+  std::mt19937 rng(13);
+  std::uniform_real_distribution<float> position(0.0f, 1000.0f), direction(-1.0f, 1.0f);
+  std::vector<e3d::bvh::Ray> rays(kRays);
+  for (auto &ray : rays)
+    ray = {Eigen::Vector3f(position(rng), position(rng), position(rng)), Eigen::Vector3f(direction(rng), direction(rng), direction(rng)).normalized()};
+  uint32_t hits = 0;
+  for (auto _ : state) {
+    hits = 0;
+    for (const auto &ray : rays)
+      hits += scene.bvh.Raycast(ray) ? 1 : 0;
+    DoNotOptimize(hits);
+  }
+  state.SetCounter("rays", kRays);
+  state.SetCounter("hit_ratio", double(hits) / kRays);
+  if (state.elapsed_ns() > 0.0)
+    state.SetCounter("rays_per_ms", double(kRays) * double(state.iterations()) / (state.elapsed_ns() * 1e-6));
+});
+
+// 相机在场景中央、远处不剔除的视锥查询
+E3D_BENCHMARK("bvh/Frustum1M", [](State &state) {
+  auto &scene = BvhScene::Get();
+  Eigen::Matrix4f view = e3d::helper::LookAt(Eigen::Vector3f(500.0f, 500.0f, 500.0f), Eigen::Vector3f(1000.0f, 600.0f, 500.0f), Eigen::Vector3f::UnitZ());
+  Eigen::Matrix4f proj = e3d::helper::PerspectiveReverseZ(60.0f * float(M_PI) / 180.0f, 16.0f / 9.0f, 0.1f);
+  auto frustum = e3d::bvh::Frustum::FromViewProj(proj * view);
+  size_t visible = 0;
+  for (auto _ : state) {
+    visible = 0;
+    scene.bvh.QueryFrustum(frustum, [&](uint32_t) { ++visible; });
+    DoNotOptimize(visible);
+  }
+  state.SetCounter("visible", double(visible));
+});
+
+// 1024 个 20 单位见方的区域查询，如物理宽阶段或范围触发器
+E3D_BENCHMARK("bvh/QueryAabb1M", [](State &state) {
+  auto &scene = BvhScene::Get();
+  constexpr uint32_t kQueries = 1024;
+  std::mt19937 rng(14);
+  std::uniform_real_distribution<float> position(0.0f, 980.0f);
+  std::vector<e3d::bvh::Aabb> queries(kQueries);
+  for (auto &q : queries) {
+    Eigen::Vector3f p(position(rng), position(rng), position(rng));
+    q = {p, p + Eigen::Vector3f::Constant(20.0f)};
+  }
+  size_t found = 0;
+  for (auto _ : state) {
+    found = 0;
+    for (const auto &q : queries)
+      scene.bvh.QueryAabb(q, [&](uint32_t) { ++found; });
+    DoNotOptimize(found);
+  }
+  state.SetCounter("queries", kQueries);
+  state.SetCounter("found_per_query", double(found) / kQueries);
+});
+
+}  // namespace
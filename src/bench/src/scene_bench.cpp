@@ -0,0 +1,131 @@
+// 宏基准：在无窗口的 Gpu 上渲染 N 帧合成场景，计时包含录制、提交和等待上一帧完成。
+// 没有可用 Vulkan 设备（或找不到着色器）时跳过而不是失败，可以在软件实现（lavapipe/SwiftShader）上运行。
+
+#include <cmath>
+#include <exception>
+
+#include "bench.hpp"
+#include "e3d/e3d.hpp"
+
+using e3d::bench::State;
+
+namespace {
+
+struct SceneConfig {
+  uint32_t instances;
+  bool depth_prepass;
+  bool hud = false;  // 打开 ImGui HUD，测量 UI 自身的开销
+};
+
+// side x side 的网格铺满相机前方的区域，实例越多缩得越小，保证全部在视野内
+void BuildGrid(e3d::SceneRenderer *scene, uint32_t instances) {
+  scene->ClearInstances();
+  uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(float(instances))));
+  float spacing = 2.0f / float(side);
+  for (uint32_t i = 0; i < instances; ++i) {
+    float x = (float(i % side) + 0.5f) * spacing - 1.0f;
+    float y = (float(i / side) + 0.5f) * spacing - 1.0f;
+    Eigen::Affine3f model = Eigen::Translation3f(x, y, 0.0f) * Eigen::Scaling(spacing * 0.8f);
+    scene->AddInstance(model.matrix());
+  }
+}
+
+void RenderScene(State &state, const SceneConfig &config) {
+  try {
+    e3d::Gpu::HeadlessOptions options;
+    options.prefer_cpu_device = true;
+    e3d::Engine engine(options);
+
+    auto scene = engine.scene();
+    scene->pipelines->WaitIdle();  // 管线变体在后台编译，计时前全部就绪
+    scene->depth_prepass = config.depth_prepass;
+    engine.ui()->SetEnabled(config.hud);
+    BuildGrid(scene, config.instances);
+
+    // 预热：填满帧队列，完成纹理上传和管线首次使用
+    for (int i = 0; i < 8; ++i)
+      engine.Frame();
+
+    double gpu_ms = 0.0, ui_cpu_ms = 0.0, ui_gpu_ms = 0.0;
+    for (auto _ : state) {
+      engine.Frame();
+      gpu_ms += scene->gpu_frame_ms;
+      ui_cpu_ms += engine.ui()->cpu_ms();
+      ui_gpu_ms += engine.pass_timer()->pass_ms("ui");
+    }
+    engine.gpu()->graphics_timeline()->WaitIdle();
+
+    state.SetCounter("instances", config.instances);
+    double iterations = double(std::max<uint64_t>(state.iterations(), 1));
+    state.SetCounter("gpu_ms", gpu_ms / iterations);
+    if (config.hud) {
+      state.SetCounter("ui_cpu_ms", ui_cpu_ms / iterations);
+      state.SetCounter("ui_gpu_ms", ui_gpu_ms / iterations);
+    }
+    state.SetCounter("draw_calls", engine.counters().Average(e3d::counters::Counter::kDrawCalls));
+    state.SetCounter("triangles", engine.counters().Average(e3d::counters::Counter::kTriangles));
+  } catch (const std::exception &e) {
+    state.Skip(e.what());
+  }
+}
+
+// 确定性回放：固定步长时钟 + 脚本化相机环绕和场景变化，关闭动态分辨率，每次运行渲染相同的帧序列。
+// 记录逐帧 CPU/GPU 时间的百分位、超出 60 FPS 预算的卡顿帧数和平均帧率。
+void Playback(State &state) {
+  constexpr double kBudgetMs = 1000.0 / 60.0;
+  try {
+    e3d::Gpu::HeadlessOptions options;
+    options.prefer_cpu_device = true;
+    e3d::Engine engine(options);
+
+    auto scene = engine.scene();
+    scene->pipelines->WaitIdle();
+    scene->dynamic_resolution_enabled = false;
+    BuildGrid(scene, 64);
+
+    auto timeline = std::make_shared<e3d::Timeline>();
+    for (int i = 0; i <= 8; ++i) {
+      float angle = float(i) * float(M_PI) / 4.0f;
+      e3d::CameraPose pose;
+      pose.eye = Eigen::Vector3f(2.5f * std::cos(angle), 2.5f * std::sin(angle), 1.5f + 0.5f * std::sin(2.0f * angle));
+      timeline->AddCameraKey(double(i), pose);
+    }
+    timeline->At(2.0, [scene] { BuildGrid(scene, 1024); });
+    timeline->At(4.0, [scene] { scene->depth_prepass = false; });
+    timeline->At(6.0, [scene] { BuildGrid(scene, 4096); });
+
+    engine.SetClock(std::make_shared<e3d::FixedStepClock>(1.0 / 60.0));
+    engine.SetTimeline(timeline);
+
+    e3d::FrameStats stats;
+    engine.SetFrameStats(&stats);
+    for (auto _ : state)
+      engine.Frame();
+    engine.SetFrameStats(nullptr);
+    engine.gpu()->graphics_timeline()->WaitIdle();
+
+    auto summary = stats.Summarize(kBudgetMs);
+    state.SetCounter("cpu_p50_ms", summary.cpu.p50);
+    state.SetCounter("cpu_p95_ms", summary.cpu.p95);
+    state.SetCounter("cpu_p99_ms", summary.cpu.p99);
+    state.SetCounter("cpu_max_ms", summary.cpu.max);
+    state.SetCounter("gpu_p50_ms", summary.gpu.p50);
+    state.SetCounter("gpu_p95_ms", summary.gpu.p95);
+    state.SetCounter("gpu_p99_ms", summary.gpu.p99);
+    state.SetCounter("gpu_max_ms", summary.gpu.max);
+    state.SetCounter("frame_p99_ms", summary.frame.p99);
+    state.SetCounter("hitches", double(summary.hitches));
+    state.SetCounter("average_fps", summary.average_fps);
+  } catch (const std::exception &e) {
+    state.Skip(e.what());
+  }
+}
+
+E3D_MACRO_BENCHMARK("scene/Instances1", [](State &state) { RenderScene(state, {1, true}); });
+E3D_MACRO_BENCHMARK("scene/Instances256", [](State &state) { RenderScene(state, {256, true}); });
+E3D_MACRO_BENCHMARK("scene/Instances4096", [](State &state) { RenderScene(state, {4096, true}); });
+E3D_MACRO_BENCHMARK("scene/Instances4096NoPrepass", [](State &state) { RenderScene(state, {4096, false}); });
+E3D_MACRO_BENCHMARK("scene/Instances256Hud", [](State &state) { RenderScene(state, {256, true, true}); });
+E3D_MACRO_BENCHMARK("playback/Orbit", Playback);
+
+}  // namespace
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "timeline.hpp"
+
+namespace e3d {
+
+// 由一个队列写入、另一个队列读取的缓冲区域
+struct BufferHandoff {
+  VkBuffer buffer{};
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = VK_WHOLE_SIZE;
+  VkAccessFlags src_access = VK_ACCESS_SHADER_WRITE_BIT;
+  VkAccessFlags dst_access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+};
+
+// 由一个队列写入、另一个队列读取的图像，布局转换在转移的同时完成
+struct ImageHandoff {
+  VkImage image{};
+  VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+  VkImageLayout old_layout = VK_IMAGE_LAYOUT_GENERAL;
+  VkImageLayout new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  VkAccessFlags src_access = VK_ACCESS_SHADER_WRITE_BIT;
+  VkAccessFlags dst_access = VK_ACCESS_SHADER_READ_BIT;
+};
+
+// 队列族所有权转移。独占共享模式的资源跨队列族使用时，源队列录制释放屏障，目标队列录制参数相同的获取屏障，
+// 两次提交之间用信号量排序。源和目标是同一个队列族时只需要源队列上的一个普通屏障。
+struct QueueHandoff {
+  uint32_t src_family{};
+  uint32_t dst_family{};
+  VkPipelineStageFlags src_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  VkPipelineStageFlags dst_stage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+  std::vector<BufferHandoff> buffers;
+  std::vector<ImageHandoff> images;
+
+  bool empty() const { return buffers.empty() && images.empty(); }
+  bool same_family() const { return src_family == dst_family; }
+};
+
+namespace detail {
+
+// release 为 true 时生成源队列上的屏障，否则生成目标队列上的屏障
+inline void RecordHandoff(VkCommandBuffer command_buffer, const QueueHandoff &handoff, bool release) {
+  bool same = handoff.same_family();
+  uint32_t src_family = same ? VK_QUEUE_FAMILY_IGNORED : handoff.src_family;
+  uint32_t dst_family = same ? VK_QUEUE_FAMILY_IGNORED : handoff.dst_family;
+
+  std::vector<VkBufferMemoryBarrier> buffer_barriers;
+  for (const auto &b : handoff.buffers) {
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    // 释放屏障的目标访问和获取屏障的源访问会被忽略，按规范置 0
+    barrier.srcAccessMask = release ? b.src_access : 0;
+    barrier.dstAccessMask = release && !same ? 0 : b.dst_access;
+    barrier.srcQueueFamilyIndex = src_family;
+    barrier.dstQueueFamilyIndex = dst_family;
+    barrier.buffer = b.buffer;
+    barrier.offset = b.offset;
+    barrier.size = b.size;
+    buffer_barriers.push_back(barrier);
+  }
+
+  std::vector<VkImageMemoryBarrier> image_barriers;
+  for (const auto &i : handoff.images) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = release ? i.src_access : 0;
+    barrier.dstAccessMask = release && !same ? 0 : i.dst_access;
+    barrier.oldLayout = i.old_layout;
+    barrier.newLayout = i.new_layout;
+    barrier.srcQueueFamilyIndex = src_family;
+    barrier.dstQueueFamilyIndex = dst_family;
+    barrier.image = i.image;
+    barrier.subresourceRange = i.range;
+    image_barriers.push_back(barrier);
+  }
+
+  VkPipelineStageFlags src_stage = release ? handoff.src_stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  VkPipelineStageFlags dst_stage = release && !same ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : handoff.dst_stage;
+  vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, nullptr, static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+                       static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+}
+
+}  // namespace detail
+
+// 在源队列的命令末尾录制
+inline void RecordRelease(VkCommandBuffer command_buffer, const QueueHandoff &handoff) {
+  if (!handoff.empty())
+    detail::RecordHandoff(command_buffer, handoff, true);
+}
+
+// 在目标队列的命令开头录制；同一队列族时释放屏障已经完成同步，这里什么也不做
+inline void RecordAcquire(VkCommandBuffer command_buffer, const QueueHandoff &handoff) {
+  if (!handoff.empty() && !handoff.same_family())
+    detail::RecordHandoff(command_buffer, handoff, false);
+}
+
+// 按时间线回收的命令缓冲池，用于不跟随帧节奏的提交（异步计算、传输）。
+// 命令缓冲在其提交的时间线值完成后才会被重用。命令池需要外部同步，只能在一个线程中使用。
+class CommandBufferPool {
+ public:
+  CommandBufferPool(VkDevice device, QueueTimeline *timeline) : device_(device), timeline_(timeline) {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = timeline_->family_index();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &pool_) != VK_SUCCESS)
+      throw std::runtime_error("failed to create command pool for " + timeline_->name());
+  }
+
+  // 调用前需保证提交的命令都已执行完毕
+  ~CommandBufferPool() { vkDestroyCommandPool(device_, pool_, nullptr); }
+
+  CommandBufferPool(const CommandBufferPool &) = delete;
+  CommandBufferPool &operator=(const CommandBufferPool &) = delete;
+
+  QueueTimeline *timeline() const { return timeline_; }
+
+  // 取一个空闲的命令缓冲并开始录制
+  VkCommandBuffer Begin() {
+    uint64_t completed = timeline_->Completed();
+    for (size_t i = 0; i < in_flight_.size();) {
+      if (in_flight_[i].second <= completed) {
+        free_.push_back(in_flight_[i].first);
+        in_flight_[i] = in_flight_.back();
+        in_flight_.pop_back();
+      } else {
+        ++i;
+      }
+    }
+
+    VkCommandBuffer command_buffer{};
+    if (free_.empty()) {
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.commandPool = pool_;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocInfo.commandBufferCount = 1;
+      if (vkAllocateCommandBuffers(device_, &allocInfo, &command_buffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate command buffer for " + timeline_->name());
+    } else {
+      command_buffer = free_.back();
+      free_.pop_back();
+      vkResetCommandBuffer(command_buffer, 0);
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(command_buffer, &beginInfo) != VK_SUCCESS)
+      throw std::runtime_error("vkBeginCommandBuffer failed on " + timeline_->name());
+    return command_buffer;
+  }
+
+  // 结束录制并提交，submission 中的 command_buffers 会被替换为 command_buffer
+  SyncPoint Submit(VkCommandBuffer command_buffer, Submission submission) {
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
+      throw std::runtime_error("vkEndCommandBuffer failed on " + timeline_->name());
+    submission.command_buffers = {command_buffer};
+    auto point = timeline_->Submit(submission);
+    in_flight_.push_back({command_buffer, point.value});
+    return point;
+  }
+
+ private:
+  VkDevice device_;
+  QueueTimeline *timeline_;
+  VkCommandPool pool_{};
+  std::vector<std::pair<VkCommandBuffer, uint64_t>> in_flight_;
+  std::vector<VkCommandBuffer> free_;
+};
+
+}  // namespace e3d
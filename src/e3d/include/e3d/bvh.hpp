@@ -0,0 +1,635 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "job_system.hpp"
+#include "simd.hpp"
+#include "trace.hpp"
+
+namespace e3d::bvh {
+
+constexpr uint32_t kNone = ~0u;
+
+struct Aabb {
+  Eigen::Vector3f min{Eigen::Vector3f::Constant(INFINITY)};
+  Eigen::Vector3f max{Eigen::Vector3f::Constant(-INFINITY)};
+
+  Aabb() = default;
+  Aabb(const Eigen::Vector3f &min, const Eigen::Vector3f &max) : min(min), max(max) {}
+
+  void Grow(const Eigen::Vector3f &p) {
+    min = min.cwiseMin(p);
+    max = max.cwiseMax(p);
+  }
+  void Grow(const Aabb &o) {
+    min = min.cwiseMin(o.min);
+    max = max.cwiseMax(o.max);
+  }
+  bool Empty() const { return (min.array() > max.array()).any(); }
+  Eigen::Vector3f Center() const { return (min + max) * 0.5f; }
+  float SurfaceArea() const {
+    if (Empty())
+      return 0.0f;
+    Eigen::Vector3f e = max - min;
+    return 2.0f * (e.x() * e.y() + e.y() * e.z() + e.z() * e.x());
+  }
+  bool Overlaps(const Aabb &o) const { return (min.array() <= o.max.array()).all() && (max.array() >= o.min.array()).all(); }
+};
+
+struct Ray {
+  Eigen::Vector3f origin;
+  Eigen::Vector3f direction;  // 不要求单位长度，t 以 direction 的长度为单位
+  float t_max{INFINITY};
+};
+
+struct Hit {
+  uint32_t primitive{kNone};
+  float t{INFINITY};
+
+  explicit operator bool() const { return primitive != kNone; }
+};
+
+// 射线与包围盒的最近交点参数，不相交时返回 INFINITY；起点在盒内时返回 0
+inline float IntersectAabb(const Ray &ray, const Aabb &box) {
+  float t_near = 0.0f, t_far = ray.t_max;
+  for (int axis = 0; axis < 3; ++axis) {
+    float inv = 1.0f / ray.direction[axis];
+    float t0 = (box.min[axis] - ray.origin[axis]) * inv;
+    float t1 = (box.max[axis] - ray.origin[axis]) * inv;
+    if (t0 > t1)
+      std::swap(t0, t1);
+    t_near = std::max(t_near, t0);
+    t_far = std::min(t_far, t1);
+  }
+  return t_near <= t_far ? t_near : INFINITY;
+}
+
+// 视锥的平面，法线指向内侧：n·p + d >= 0 在内部
+struct Frustum {
+  std::array<Eigen::Vector4f, 5> planes;
+
+  // 只用四个侧面和 w > 0：不依赖深度范围约定（OpenGL、Vulkan、反向 Z、无穷远平面都适用），远处不剔除
+  static Frustum FromViewProj(const Eigen::Matrix4f &view_proj) {
+    Frustum f;
+    Eigen::Vector4f r0 = view_proj.row(0), r1 = view_proj.row(1), r3 = view_proj.row(3);
+    f.planes = {r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3};
+    return f;
+  }
+
+  bool Intersects(const Aabb &box) const {
+    for (const auto &p : planes) {
+      Eigen::Vector3f v((p.x() >= 0.0f ? box.max : box.min).x(), (p.y() >= 0.0f ? box.max : box.min).y(), (p.z() >= 0.0f ? box.max : box.min).z());
+      if (p.head<3>().dot(v) + p.w() < 0.0f)
+        return false;
+    }
+    return true;
+  }
+};
+
+// 四叉 BVH。构建时先用分箱 SAH（沿中心跨度最大的轴）建二叉树，再把每个节点与孙节点合并成最多四个子节点，
+// 子节点包围盒按分量分开存放，遍历时一次用 4 路 SIMD 测试一个节点的全部子节点。
+// 构建：顶层几次划分在调用线程上做，分箱统计用 JobSystem 并行；划分出足够多的子树后，各子树在工作线程上独立构建。
+// 图元包围盒变化后用 Update 标记，Refit 只重新计算受影响的节点；拓扑不变，变化很大时应重新 Build。
+class Bvh {
+ public:
+  static constexpr uint32_t kMaxLeafSize = 4;
+  static constexpr uint32_t kBins = 16;
+
+  // 节点序号总是大于父节点（先序），Refit 倒序扫描即可保证子节点先于父节点
+  struct alignas(16) Node {
+    float min_x[4], min_y[4], min_z[4];
+    float max_x[4], max_y[4], max_z[4];
+    uint32_t child[4];  // 内部节点的序号，或叶子在 primitives() 中的起点
+    uint32_t count[4];  // 叶子的图元数，0 表示内部节点
+    uint32_t valid;     // 非空槽位的位掩码
+    uint32_t parent;
+  };
+
+  void Build(const std::vector<Aabb> &boxes) { Build(boxes, nullptr); }
+  void Build(const std::vector<Aabb> &boxes, JobSystem *jobs) {
+    E3D_TRACE_SCOPE("Bvh::Build");
+    boxes_ = boxes;
+    nodes_.clear();
+    leaf_node_.assign(boxes_.size(), kNone);
+    dirty_.clear();
+    order_.resize(boxes_.size());
+    for (uint32_t i = 0; i < order_.size(); ++i)
+      order_[i] = i;
+    if (boxes_.empty())
+      return;
+
+    centers_.resize(boxes_.size());
+    ForRange(jobs, boxes_.size(), [this](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        centers_[i] = boxes_[i].Center();
+    });
+
+    // 二叉树最多 2N-1 个节点，预先分配，各线程用原子计数领取节点
+    build_nodes_.resize(boxes_.size() * 2);
+    build_node_count_ = 1;
+    BuildTopLevel(jobs);
+
+    nodes_.reserve(build_node_count_ / 2 + 1);
+    Collapse(0, kNone);
+    dirty_.assign(nodes_.size(), 0);
+    build_nodes_.clear();
+    build_nodes_.shrink_to_fit();
+    centers_.clear();
+    centers_.shrink_to_fit();
+  }
+
+  size_t size() const { return boxes_.size(); }
+  const std::vector<Node> &nodes() const { return nodes_; }
+  const std::vector<uint32_t> &primitives() const { return order_; }  // 叶子引用的图元序号
+  const Aabb &box(uint32_t primitive) const { return boxes_[primitive]; }
+
+  Aabb bounds() const {
+    Aabb b;
+    if (!nodes_.empty())
+      for (int slot = 0; slot < 4; ++slot)
+        if (nodes_[0].valid & (1u << slot))
+          b.Grow(SlotBounds(nodes_[0], slot));
+    return b;
+  }
+
+  // 修改一个图元的包围盒，在下一次 Refit 时生效
+  void Update(uint32_t primitive, const Aabb &box) {
+    boxes_[primitive] = box;
+    dirty_[leaf_node_[primitive]] = 1;
+    has_dirty_ = true;
+  }
+
+  // 自底向上重新计算被 Update 影响的节点
+  void Refit() {
+    if (!has_dirty_)
+      return;
+    E3D_TRACE_SCOPE("Bvh::Refit");
+    for (size_t n = nodes_.size(); n-- > 0;) {
+      if (!dirty_[n])
+        continue;
+      dirty_[n] = 0;
+      Node &node = nodes_[n];
+      for (int slot = 0; slot < 4; ++slot) {
+        if (!(node.valid & (1u << slot)))
+          continue;
+        Aabb b;
+        if (node.count[slot] > 0) {
+          for (uint32_t i = 0; i < node.count[slot]; ++i)
+            b.Grow(boxes_[order_[node.child[slot] + i]]);
+        } else {
+          const Node &child = nodes_[node.child[slot]];
+          for (int s = 0; s < 4; ++s)
+            if (child.valid & (1u << s))
+              b.Grow(SlotBounds(child, s));
+        }
+        SetSlot(node, slot, b);
+      }
+      if (node.parent != kNone)
+        dirty_[node.parent] = 1;
+    }
+    has_dirty_ = false;
+  }
+
+  // 最近的交点。intersect(primitive, ray) 返回交点参数，不相交时返回 INFINITY；ray.t_max 随已找到的最近交点缩小
+  template <typename IntersectFn>
+  Hit Raycast(const Ray &ray, IntersectFn &&intersect) const {
+    using simd::Float4;
+    Hit hit;
+    if (nodes_.empty())
+      return hit;
+
+    Ray current = ray;
+    // 方向分量为 0 时用极小值代替，避免 0 * 无穷大得到 NaN
+    auto inverse = [](float d) { return 1.0f / (std::abs(d) > 1e-30f ? d : std::copysign(1e-30f, d)); };
+    Float4 ox = Float4::Broadcast(ray.origin.x()), oy = Float4::Broadcast(ray.origin.y()), oz = Float4::Broadcast(ray.origin.z());
+    Float4 ix = Float4::Broadcast(inverse(ray.direction.x())), iy = Float4::Broadcast(inverse(ray.direction.y())),
+           iz = Float4::Broadcast(inverse(ray.direction.z()));
+    Float4 zero = Float4::Broadcast(0.0f);
+
+    struct Entry {
+      uint32_t node;
+      float t;
+    };
+    Entry stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = {0, 0.0f};
+    while (sp > 0) {
+      Entry entry = stack[--sp];
+      if (entry.t > current.t_max)
+        continue;
+      const Node &node = nodes_[entry.node];
+      Float4 tx0 = (Float4::Load(node.min_x) - ox) * ix, tx1 = (Float4::Load(node.max_x) - ox) * ix;
+      Float4 ty0 = (Float4::Load(node.min_y) - oy) * iy, ty1 = (Float4::Load(node.max_y) - oy) * iy;
+      Float4 tz0 = (Float4::Load(node.min_z) - oz) * iz, tz1 = (Float4::Load(node.max_z) - oz) * iz;
+      Float4 t_near = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Max(Min(tz0, tz1), zero));
+      Float4 t_far = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Min(Max(tz0, tz1), Float4::Broadcast(current.t_max)));
+      uint32_t mask = (t_near <= t_far).Bits() & node.valid;
+      if (!mask)
+        continue;
+
+      // 命中的子节点按进入距离从近到远处理：叶子立即测试，内部节点从远到近压栈，最近的先出栈
+      alignas(16) float near_t[4];
+      t_near.Store(near_t);
+      int order[4], n = 0;
+      for (int slot = 0; slot < 4; ++slot)
+        if (mask & (1u << slot)) {
+          int j = n++;
+          for (; j > 0 && near_t[order[j - 1]] > near_t[slot]; --j)
+            order[j] = order[j - 1];
+          order[j] = slot;
+        }
+      for (int k = 0; k < n; ++k) {
+        int slot = order[k];
+        if (node.count[slot] == 0 || near_t[slot] > current.t_max)
+          continue;
+        for (uint32_t i = 0; i < node.count[slot]; ++i) {
+          uint32_t primitive = order_[node.child[slot] + i];
+          float t = intersect(primitive, current);
+          if (t <= current.t_max && t < hit.t) {
+            hit = {primitive, t};
+            current.t_max = t;
+          }
+        }
+      }
+      for (int k = n; k-- > 0;) {
+        int slot = order[k];
+        if (node.count[slot] == 0 && near_t[slot] <= current.t_max)
+          stack[sp++] = {node.child[slot], near_t[slot]};
+      }
+    }
+    return hit;
+  }
+
+  // 与图元包围盒的最近交点
+  Hit Raycast(const Ray &ray) const {
+    return Raycast(ray, [this](uint32_t primitive, const Ray &r) { return IntersectAabb(r, boxes_[primitive]); });
+  }
+
+  // 对包围盒与 box 相交的每个图元调用 fn(primitive)
+  template <typename Fn>
+  void QueryAabb(const Aabb &box, Fn &&fn) const {
+    using simd::Float4;
+    if (nodes_.empty())
+      return;
+    Float4 qmin_x = Float4::Broadcast(box.min.x()), qmin_y = Float4::Broadcast(box.min.y()), qmin_z = Float4::Broadcast(box.min.z());
+    Float4 qmax_x = Float4::Broadcast(box.max.x()), qmax_y = Float4::Broadcast(box.max.y()), qmax_z = Float4::Broadcast(box.max.z());
+
+    uint32_t stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+      const Node &node = nodes_[stack[--sp]];
+      auto overlap = (Float4::Load(node.min_x) <= qmax_x) & (Float4::Load(node.max_x) >= qmin_x) & (Float4::Load(node.min_y) <= qmax_y) &
+                     (Float4::Load(node.max_y) >= qmin_y) & (Float4::Load(node.min_z) <= qmax_z) & (Float4::Load(node.max_z) >= qmin_z);
+      uint32_t mask = overlap.Bits() & node.valid;
+      for (int slot = 0; slot < 4; ++slot) {
+        if (!(mask & (1u << slot)))
+          continue;
+        if (node.count[slot] == 0) {
+          stack[sp++] = node.child[slot];
+          continue;
+        }
+        for (uint32_t i = 0; i < node.count[slot]; ++i) {
+          uint32_t primitive = order_[node.child[slot] + i];
+          if (boxes_[primitive].Overlaps(box))
+            fn(primitive);
+        }
+      }
+    }
+  }
+
+  // 对包围盒与视锥相交的每个图元调用 fn(primitive)。完全在视锥内的子树不再逐个测试
+  template <typename Fn>
+  void QueryFrustum(const Frustum &frustum, Fn &&fn) const {
+    using simd::Float4;
+    using simd::Mask4;
+    if (nodes_.empty())
+      return;
+
+    struct Entry {
+      uint32_t node;
+      bool inside;
+    };
+    Entry stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = {0, false};
+    while (sp > 0) {
+      Entry entry = stack[--sp];
+      const Node &node = nodes_[entry.node];
+      uint32_t intersect = node.valid, inside = node.valid;
+      if (!entry.inside) {
+        Float4 min_x = Float4::Load(node.min_x), min_y = Float4::Load(node.min_y), min_z = Float4::Load(node.min_z);
+        Float4 max_x = Float4::Load(node.max_x), max_y = Float4::Load(node.max_y), max_z = Float4::Load(node.max_z);
+        Float4 zero = Float4::Broadcast(0.0f);
+        for (const auto &p : frustum.planes) {
+          // 沿法线最远的角点在平面外侧则整盒在外，最近的角点在内侧则整盒在内
+          Float4 nx = Float4::Broadcast(p.x()), ny = Float4::Broadcast(p.y()), nz = Float4::Broadcast(p.z()), d = Float4::Broadcast(p.w());
+          bool px = p.x() >= 0.0f, py = p.y() >= 0.0f, pz = p.z() >= 0.0f;
+          Float4 far_d = nx * (px ? max_x : min_x) + ny * (py ? max_y : min_y) + nz * (pz ? max_z : min_z) + d;
+          Float4 near_d = nx * (px ? min_x : max_x) + ny * (py ? min_y : max_y) + nz * (pz ? min_z : max_z) + d;
+          intersect &= (far_d >= zero).Bits();
+          inside &= (near_d >= zero).Bits();
+        }
+      }
+      for (int slot = 0; slot < 4; ++slot) {
+        if (!(intersect & (1u << slot)))
+          continue;
+        bool slot_inside = inside & (1u << slot);
+        if (node.count[slot] == 0) {
+          stack[sp++] = {node.child[slot], slot_inside};
+          continue;
+        }
+        for (uint32_t i = 0; i < node.count[slot]; ++i) {
+          uint32_t primitive = order_[node.child[slot] + i];
+          if (slot_inside || frustum.Intersects(boxes_[primitive]))
+            fn(primitive);
+        }
+      }
+    }
+  }
+
+ private:
+  // 四叉树每层最多压入 3 个兄弟节点，64 层足以覆盖任何实际的深度
+  static constexpr int kStackSize = 256;
+  // 大于该图元数的节点在调用线程上划分（分箱并行），其余作为子树交给工作线程
+  static constexpr uint32_t kParallelLeafThreshold = 8192;
+
+  struct BuildNode {
+    Aabb bounds;
+    uint32_t first;
+    uint32_t count;
+    uint32_t left{kNone};  // 右子节点紧跟在左子节点之后
+  };
+
+  struct Bin {
+    Aabb bounds;
+    uint32_t count{};
+  };
+
+  struct Split {
+    int axis{-1};
+    uint32_t bin{};  // 中心落在 [0, bin) 的图元进入左侧
+    float cost{INFINITY};
+  };
+
+  // 一个区间的统计：图元包围盒、中心的包围盒，以及沿中心跨度最大的轴的分箱。axis 为 -1 表示中心全部重合
+  struct RangeStats {
+    Aabb bounds;
+    Aabb centers;
+    int axis{-1};
+    Bin bins[kBins];
+  };
+
+  template <typename Fn>
+  static void ForRange(JobSystem *jobs, size_t count, Fn &&fn) {
+    if (jobs)
+      jobs->ParallelFor(count, 4096, fn);
+    else
+      fn(0, count);
+  }
+
+  static void SetSlot(Node &node, int slot, const Aabb &b) {
+    node.min_x[slot] = b.min.x();
+    node.min_y[slot] = b.min.y();
+    node.min_z[slot] = b.min.z();
+    node.max_x[slot] = b.max.x();
+    node.max_y[slot] = b.max.y();
+    node.max_z[slot] = b.max.z();
+  }
+
+  static Aabb SlotBounds(const Node &node, int slot) {
+    return {{node.min_x[slot], node.min_y[slot], node.min_z[slot]}, {node.max_x[slot], node.max_y[slot], node.max_z[slot]}};
+  }
+
+  uint32_t BinIndex(float center, float min, float scale) const {
+    return std::min(kBins - 1, uint32_t(std::max(0.0f, (center - min) * scale)));
+  }
+
+  // 在 [first, first + count) 上统计包围盒和中心包围盒，再按中心分箱。jobs 非空时两遍都并行，各块统计完再合并
+  void Analyze(uint32_t first, uint32_t count, JobSystem *jobs, RangeStats &stats) const {
+    std::mutex mutex;
+    stats.bounds = stats.centers = Aabb{};
+    ForRange(jobs, count, [&](size_t begin, size_t end) {
+      Aabb bounds, centers;
+      for (size_t i = first + begin; i < first + end; ++i) {
+        bounds.Grow(boxes_[order_[i]]);
+        centers.Grow(centers_[order_[i]]);
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      stats.bounds.Grow(bounds);
+      stats.centers.Grow(centers);
+    });
+
+    for (auto &bin : stats.bins)
+      bin = Bin{};
+    Eigen::Vector3f extent = stats.centers.max - stats.centers.min;
+    extent.maxCoeff(&stats.axis);
+    if (!(extent[stats.axis] > 0.0f)) {
+      stats.axis = -1;
+      return;
+    }
+    int axis = stats.axis;
+    float min = stats.centers.min[axis], scale = float(kBins) / extent[axis];
+    ForRange(jobs, count, [&](size_t begin, size_t end) {
+      Bin bins[kBins];
+      for (size_t i = first + begin; i < first + end; ++i) {
+        uint32_t primitive = order_[i];
+        Bin &bin = bins[BinIndex(centers_[primitive][axis], min, scale)];
+        bin.bounds.Grow(boxes_[primitive]);
+        bin.count++;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      for (uint32_t b = 0; b < kBins; ++b) {
+        stats.bins[b].bounds.Grow(bins[b].bounds);
+        stats.bins[b].count += bins[b].count;
+      }
+    });
+  }
+
+  // SAH 代价：遍历代价 1，每个图元的相交代价 1，按面积归一化
+  static Split FindSplit(const RangeStats &stats) {
+    Split best;
+    if (stats.axis < 0)
+      return best;
+    float parent_area = std::max(stats.bounds.SurfaceArea(), 1e-20f);
+    float right_cost[kBins];
+    uint32_t right_count[kBins];
+    Aabb right;
+    uint32_t count = 0;
+    for (uint32_t b = kBins - 1; b > 0; --b) {
+      right.Grow(stats.bins[b].bounds);
+      count += stats.bins[b].count;
+      right_count[b] = count;
+      right_cost[b] = right.SurfaceArea() * float(count);
+    }
+    Aabb left;
+    uint32_t left_count = 0;
+    for (uint32_t b = 1; b < kBins; ++b) {
+      left.Grow(stats.bins[b - 1].bounds);
+      left_count += stats.bins[b - 1].count;
+      if (left_count == 0 || right_count[b] == 0)
+        continue;
+      float cost = 1.0f + (left.SurfaceArea() * float(left_count) + right_cost[b]) / parent_area;
+      if (cost < best.cost)
+        best = {stats.axis, b, cost};
+    }
+    return best;
+  }
+
+  // 按划分重排 order_，返回左侧的图元数。没有有效划分（中心重合）时按序号对半分
+  uint32_t Partition(uint32_t first, uint32_t count, const RangeStats &stats, const Split &split) {
+    if (split.axis < 0)
+      return count / 2;
+    int axis = split.axis;
+    float min = stats.centers.min[axis];
+    float scale = float(kBins) / (stats.centers.max[axis] - stats.centers.min[axis]);
+    auto middle = std::partition(order_.begin() + first, order_.begin() + first + count,
+                                 [&](uint32_t primitive) { return BinIndex(centers_[primitive][axis], min, scale) < split.bin; });
+    uint32_t left = uint32_t(middle - (order_.begin() + first));
+    return (left == 0 || left == count) ? count / 2 : left;
+  }
+
+  // 划分一个节点：成为叶子时返回 false，否则分配两个子节点并返回 true
+  bool SplitNode(uint32_t index, JobSystem *jobs) {
+    BuildNode &node = build_nodes_[index];
+    // 不超过 kMaxLeafSize 个图元直接作为叶子，省去分箱
+    if (node.count <= kMaxLeafSize) {
+      node.bounds = Aabb{};
+      for (uint32_t i = node.first; i < node.first + node.count; ++i)
+        node.bounds.Grow(boxes_[order_[i]]);
+      return false;
+    }
+    RangeStats stats;
+    Analyze(node.first, node.count, jobs, stats);
+    node.bounds = stats.bounds;
+    Split split = FindSplit(stats);
+
+    uint32_t left_count = Partition(node.first, node.count, stats, split);
+    uint32_t left = build_node_count_.fetch_add(2);
+    build_nodes_[left] = {Aabb{}, node.first, left_count};
+    build_nodes_[left + 1] = {Aabb{}, node.first + left_count, node.count - left_count};
+    node.left = left;
+    return true;
+  }
+
+  void BuildSubtree(uint32_t index) {
+    if (SplitNode(index, nullptr)) {
+      uint32_t left = build_nodes_[index].left;
+      BuildSubtree(left);
+      BuildSubtree(left + 1);
+    }
+  }
+
+  // 大节点在调用线程上划分；剩下的子树按大小从大到小排序，各线程从共享计数中领取
+  void BuildTopLevel(JobSystem *jobs) {
+    build_nodes_[0] = {Aabb{}, 0, uint32_t(boxes_.size())};
+    std::vector<uint32_t> pending = {0}, subtrees;
+    while (!pending.empty()) {
+      uint32_t index = pending.back();
+      pending.pop_back();
+      if (!jobs || build_nodes_[index].count <= kParallelLeafThreshold) {
+        subtrees.push_back(index);
+        continue;
+      }
+      if (SplitNode(index, jobs)) {
+        pending.push_back(build_nodes_[index].left);
+        pending.push_back(build_nodes_[index].left + 1);
+      }
+    }
+    std::sort(subtrees.begin(), subtrees.end(), [this](uint32_t a, uint32_t b) { return build_nodes_[a].count > build_nodes_[b].count; });
+    std::atomic<size_t> next{0};
+    auto worker = [&](size_t, size_t) {
+      for (size_t i = next++; i < subtrees.size(); i = next++)
+        BuildSubtree(subtrees[i]);
+    };
+    if (jobs)
+      jobs->ParallelFor(jobs->thread_count() + 1, 1, worker);
+    else
+      worker(0, 1);
+  }
+
+  // 把二叉节点及其孙节点合并成一个四叉节点：反复展开面积最大的内部子节点，直到有四个子节点
+  uint32_t Collapse(uint32_t build_index, uint32_t parent) {
+    uint32_t index = uint32_t(nodes_.size());
+    nodes_.emplace_back();
+
+    uint32_t children[4];
+    int n = 0;
+    const BuildNode &root = build_nodes_[build_index];
+    if (root.left == kNone) {
+      children[n++] = build_index;  // 整棵树只有一个叶子
+    } else {
+      children[n++] = root.left;
+      children[n++] = root.left + 1;
+    }
+    while (n < 4) {
+      int best = -1;
+      float best_area = -1.0f;
+      for (int i = 0; i < n; ++i) {
+        const BuildNode &c = build_nodes_[children[i]];
+        if (c.left != kNone && c.bounds.SurfaceArea() > best_area) {
+          best = i;
+          best_area = c.bounds.SurfaceArea();
+        }
+      }
+      if (best < 0)
+        break;
+      uint32_t left = build_nodes_[children[best]].left;
+      children[best] = left;
+      children[n++] = left + 1;
+    }
+
+    Node node{};
+    node.parent = parent;
+    for (int slot = 0; slot < 4; ++slot) {
+      if (slot >= n) {
+        SetSlot(node, slot, Aabb{});
+        node.child[slot] = kNone;
+        continue;
+      }
+      const BuildNode &c = build_nodes_[children[slot]];
+      SetSlot(node, slot, c.bounds);
+      node.valid |= 1u << slot;
+      if (c.left == kNone) {
+        node.child[slot] = c.first;
+        node.count[slot] = c.count;
+        for (uint32_t i = 0; i < c.count; ++i)
+          leaf_node_[order_[c.first + i]] = index;
+      }
+    }
+    // 先写入本节点再递归，递归中 nodes_ 可能重新分配
+    nodes_[index] = node;
+    for (int slot = 0; slot < n; ++slot) {
+      const BuildNode &c = build_nodes_[children[slot]];
+      if (c.left != kNone) {
+        uint32_t child = Collapse(children[slot], index);
+        nodes_[index].child[slot] = child;
+      }
+    }
+    return index;
+  }
+
+  std::vector<Aabb> boxes_;
+  std::vector<uint32_t> order_;
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> leaf_node_;  // 每个图元所在的叶子节点
+  std::vector<uint8_t> dirty_;
+  bool has_dirty_{};
+
+  // 只在 Build 期间使用
+  std::vector<Eigen::Vector3f> centers_;
+  std::vector<BuildNode> build_nodes_;
+  std::atomic<uint32_t> build_node_count_{};
+};
+
+}  // namespace e3d::bvh
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <vector>
+
+namespace e3d::counters {
+
+enum class Counter : uint32_t {
+  kDrawCalls,
+  kPipelineBinds,
+  kDescriptorBinds,
+  kTriangles,
+  kUploadBytes,           // 通过暂存缓冲上传的字节数
+  kDeviceBytesAllocated,  // vkAllocateMemory 分配的字节数
+  kObjectsCreated,        // 经 DeletionQueue 记录的 Vulkan 对象
+  kObjectsDestroyed,
+  kHostAllocations,  // 需要在一个编译单元中使用 E3D_COUNT_HOST_ALLOCATIONS()
+  kCount,
+};
+
+inline const char *Name(Counter counter) {
+  static const char *names[] = {"draw_calls",           "pipeline_binds",  "descriptor_binds",  "triangles",       "upload_bytes",
+                                "device_bytes_allocated", "objects_created", "objects_destroyed", "host_allocations"};
+  return names[size_t(counter)];
+}
+
+// 一帧内各计数器的增量
+struct FrameCounters {
+  uint64_t frame{};
+  std::array<int64_t, size_t(Counter::kCount)> values{};
+
+  int64_t operator[](Counter counter) const { return values[size_t(counter)]; }
+};
+
+// 主机分配在 operator new 中计数，不能经过线程注册（注册本身会分配），单独用一个全局原子计数
+inline std::atomic<int64_t> &HostAllocations() {
+  static std::atomic<int64_t> count{0};
+  return count;
+}
+
+// 每个线程一组单写者计数：只有所属线程写入，不需要原子读改写；汇总时与上次快照求差得到本帧增量
+struct ThreadCounters {
+  std::array<std::atomic<int64_t>, size_t(Counter::kCount)> totals{};
+};
+
+class Registry {
+ public:
+  static Registry &Get() {
+    static Registry registry;
+    return registry;
+  }
+
+  ThreadCounters &Local() {
+    thread_local std::shared_ptr<ThreadCounters> counters = Register();
+    return *counters;
+  }
+
+  // 帧结束时由主线程调用：汇总所有线程的增量，写入滚动历史
+  FrameCounters EndFrame() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FrameCounters frame;
+    frame.frame = frame_++;
+    for (auto &thread : threads_) {
+      for (size_t i = 0; i < size_t(Counter::kCount); ++i) {
+        int64_t total = thread.counters->totals[i].load(std::memory_order_relaxed);
+        frame.values[i] += total - thread.snapshot[i];
+        thread.snapshot[i] = total;
+      }
+    }
+    int64_t host_allocations = HostAllocations().load(std::memory_order_relaxed);
+    frame.values[size_t(Counter::kHostAllocations)] += host_allocations - host_allocations_snapshot_;
+    host_allocations_snapshot_ = host_allocations;
+    history_.push_back(frame);
+    while (history_.size() > history_size_)
+      history_.pop_front();
+    return frame;
+  }
+
+  void SetHistorySize(size_t frames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    history_size_ = std::max<size_t>(frames, 1);
+    while (history_.size() > history_size_)
+      history_.pop_front();
+  }
+
+  FrameCounters Last() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return history_.empty() ? FrameCounters{} : history_.back();
+  }
+
+  // 最近的若干帧，从旧到新
+  std::vector<FrameCounters> History() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {history_.begin(), history_.end()};
+  }
+
+  // 历史窗口内的平均值和最大值
+  double Average(Counter counter) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (history_.empty())
+      return 0.0;
+    double sum = 0.0;
+    for (const auto &frame : history_)
+      sum += double(frame[counter]);
+    return sum / double(history_.size());
+  }
+
+  int64_t Max(Counter counter) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t result = 0;
+    for (const auto &frame : history_)
+      result = std::max(result, frame[counter]);
+    return result;
+  }
+
+  void Report(std::ostream &os) const {
+    auto last = Last();
+    os << "frame " << last.frame << ":";
+    for (size_t i = 0; i < size_t(Counter::kCount); ++i)
+      os << " " << Name(Counter(i)) << "=" << last.values[i] << " (avg " << Average(Counter(i)) << ")";
+    os << "\n";
+  }
+
+ private:
+  struct Thread {
+    std::shared_ptr<ThreadCounters> counters;
+    std::array<int64_t, size_t(Counter::kCount)> snapshot{};
+  };
+
+  std::shared_ptr<ThreadCounters> Register() {
+    auto counters = std::make_shared<ThreadCounters>();
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_.push_back({counters, {}});
+    return counters;
+  }
+
+  mutable std::mutex mutex_;
+  std::vector<Thread> threads_;
+  std::deque<FrameCounters> history_;
+  size_t history_size_{240};
+  uint64_t frame_{};
+  int64_t host_allocations_snapshot_{};
+};
+
+// 热路径：只读写本线程的计数
+inline void Add(Counter counter, int64_t value = 1) {
+  auto &total = Registry::Get().Local().totals[size_t(counter)];
+  total.store(total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// 计数主机堆分配。全局 operator new 不能定义在头文件中，
+// 需要统计时在应用的某一个 .cpp 中写一次 E3D_COUNT_HOST_ALLOCATIONS()。
+inline void *CountedAllocate(std::size_t size) {
+  HostAllocations().fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+}  // namespace e3d::counters
+
+#define E3D_COUNT_HOST_ALLOCATIONS()                                                               \
+  void *operator new(std::size_t size) { return ::e3d::counters::CountedAllocate(size); }          \
+  void *operator new[](std::size_t size) { return ::e3d::counters::CountedAllocate(size); }        \
+  void operator delete(void *p) noexcept { std::free(p); }                                         \
+  void operator delete[](void *p) noexcept { std::free(p); }                                       \
+  void operator delete(void *p, std::size_t) noexcept { std::free(p); }                            \
+  void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include "counters.hpp"
+
+namespace e3d {
+
+enum class VulkanObject : uint32_t {
+  kBuffer,
+  kImage,
+  kImageView,
+  kDeviceMemory,
+  kSampler,
+  kFramebuffer,
+  kRenderPass,
+  kPipeline,
+  kPipelineLayout,
+  kQueryPool,
+  kCount,
+};
+
+template <typename Handle>
+struct VulkanObjectTraits;
+
+#define E3D_VULKAN_OBJECT(Handle, Kind, DestroyFn)                                              \
+  template <>                                                                                   \
+  struct VulkanObjectTraits<Handle> {                                                           \
+    static constexpr VulkanObject kind = VulkanObject::Kind;                                    \
+    static void Destroy(VkDevice device, Handle handle) { DestroyFn(device, handle, nullptr); } \
+  };
+
+E3D_VULKAN_OBJECT(VkBuffer, kBuffer, vkDestroyBuffer)
+E3D_VULKAN_OBJECT(VkImage, kImage, vkDestroyImage)
+E3D_VULKAN_OBJECT(VkImageView, kImageView, vkDestroyImageView)
+E3D_VULKAN_OBJECT(VkDeviceMemory, kDeviceMemory, vkFreeMemory)
+E3D_VULKAN_OBJECT(VkSampler, kSampler, vkDestroySampler)
+E3D_VULKAN_OBJECT(VkFramebuffer, kFramebuffer, vkDestroyFramebuffer)
+E3D_VULKAN_OBJECT(VkRenderPass, kRenderPass, vkDestroyRenderPass)
+E3D_VULKAN_OBJECT(VkPipeline, kPipeline, vkDestroyPipeline)
+E3D_VULKAN_OBJECT(VkPipelineLayout, kPipelineLayout, vkDestroyPipelineLayout)
+E3D_VULKAN_OBJECT(VkQueryPool, kQueryPool, vkDestroyQueryPool)
+
+#undef E3D_VULKAN_OBJECT
+
+// 延迟销毁队列：Release 的对象由下一次 Commit 标记上那次提交的时间线值，等到该值对应的 GPU 工作
+// 确认完成后才真正销毁，因此替换资源既不需要 vkDeviceWaitIdle 也不会泄漏。
+// 同时统计每类对象的存活数量，用于调试时检查泄漏。
+class DeletionQueue {
+ public:
+  explicit DeletionQueue(VkDevice device) : device_(device) {}
+
+  ~DeletionQueue() { Flush(); }
+
+  DeletionQueue(const DeletionQueue &) = delete;
+  DeletionQueue &operator=(const DeletionQueue &) = delete;
+
+  // 记录一个新创建的对象
+  template <typename Handle>
+  Handle Track(Handle handle) {
+    if (handle != VK_NULL_HANDLE) {
+      live_[size_t(VulkanObjectTraits<Handle>::kind)]++;
+      counters::Add(counters::Counter::kObjectsCreated);
+    }
+    return handle;
+  }
+
+  // 对象在正在录制的帧之后不再使用，等该帧提交并完成后销毁
+  template <typename Handle>
+  void Release(Handle handle) {
+    if (handle == VK_NULL_HANDLE)
+      return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back({kUncommitted, [this, handle] { Destroy(handle); }});
+  }
+
+  // 确定 GPU 不再使用时立即销毁
+  template <typename Handle>
+  void Destroy(Handle handle) {
+    if (handle == VK_NULL_HANDLE)
+      return;
+    if constexpr (std::is_same_v<Handle, VkDeviceMemory>) {
+      if (on_free_memory_)
+        on_free_memory_(handle);
+    }
+    VulkanObjectTraits<Handle>::Destroy(device_, handle);
+    live_[size_t(VulkanObjectTraits<Handle>::kind)]--;
+    counters::Add(counters::Counter::kObjectsDestroyed);
+  }
+
+  // 释放设备内存时通知，用于显存统计
+  void SetFreeMemoryCallback(std::function<void(VkDeviceMemory)> callback) { on_free_memory_ = std::move(callback); }
+
+  // 帧提交后调用：此前 Release 的对象都在时间线达到 value 后销毁
+  void Commit(uint64_t value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &entry : pending_)
+      if (entry.value == kUncommitted)
+        entry.value = value;
+  }
+
+  // 时间线已达到 completed，销毁标记值不超过它的对象
+  void Collect(uint64_t completed) {
+    std::vector<Entry> ready;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = std::partition(pending_.begin(), pending_.end(), [&](const Entry &e) { return e.value > completed; });
+      ready.assign(std::make_move_iterator(it), std::make_move_iterator(pending_.end()));
+      pending_.erase(it, pending_.end());
+    }
+    for (auto &entry : ready)
+      entry.destroy();
+  }
+
+  // 销毁全部待删除对象，调用前需保证设备空闲
+  void Flush() { Collect(UINT64_MAX); }
+
+  size_t pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.size();
+  }
+
+  int64_t live(VulkanObject kind) const { return live_[size_t(kind)]; }
+
+  void Report(std::ostream &os) const {
+    static const char *names[] = {"buffer",      "image",       "image view", "device memory",   "sampler",
+                                  "framebuffer", "render pass", "pipeline",   "pipeline layout", "query pool"};
+    os << "live vulkan objects:";
+    for (size_t i = 0; i < size_t(VulkanObject::kCount); ++i)
+      if (live_[i] != 0)
+        os << " " << names[i] << "=" << live_[i];
+    os << ", pending deletion=" << pending() << "\n";
+  }
+
+ private:
+  static constexpr uint64_t kUncommitted = UINT64_MAX;
+
+  struct Entry {
+    uint64_t value;
+    std::function<void()> destroy;
+  };
+
+  VkDevice device_;
+  mutable std::mutex mutex_;
+  std::vector<Entry> pending_;
+  std::function<void(VkDeviceMemory)> on_free_memory_;
+  std::array<std::atomic<int64_t>, size_t(VulkanObject::kCount)> live_{};
+};
+
+}  // namespace e3d
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace e3d {
+
+// 描述符集布局缓存：绑定完全相同的布局只创建一次。
+class DescriptorLayoutCache {
+ public:
+  explicit DescriptorLayoutCache(VkDevice device) : device_(device) {}
+
+  ~DescriptorLayoutCache() {
+    for (auto &[key, layout] : layouts_)
+      vkDestroyDescriptorSetLayout(device_, layout, nullptr);
+  }
+
+  DescriptorLayoutCache(const DescriptorLayoutCache &) = delete;
+  DescriptorLayoutCache &operator=(const DescriptorLayoutCache &) = delete;
+
+  VkDescriptorSetLayout Get(std::vector<VkDescriptorSetLayoutBinding> bindings, VkDescriptorSetLayoutCreateFlags flags = 0) {
+    // 按 binding 排序，使声明顺序不同的相同布局命中同一项
+    std::sort(bindings.begin(), bindings.end(), [](const auto &l, const auto &r) { return l.binding < r.binding; });
+
+    Key key{flags, bindings};
+    auto it = layouts_.find(key);
+    if (it != layouts_.end())
+      return it->second;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.flags = flags;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    VkDescriptorSetLayout layout{};
+    if (vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    layouts_.emplace(std::move(key), layout);
+    return layout;
+  }
+
+  size_t size() const { return layouts_.size(); }
+
+ private:
+  struct Key {
+    VkDescriptorSetLayoutCreateFlags flags;
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+    bool operator==(const Key &o) const {
+      if (flags != o.flags || bindings.size() != o.bindings.size())
+        return false;
+      for (size_t i = 0; i < bindings.size(); ++i) {
+        const auto &a = bindings[i];
+        const auto &b = o.bindings[i];
+        // 不可变采样器按指针比较
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags ||
+            a.pImmutableSamplers != b.pImmutableSamplers)
+          return false;
+      }
+      return true;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      size_t h = std::hash<uint32_t>()(key.flags);
+      for (const auto &b : key.bindings) {
+        size_t packed = size_t(b.binding) | size_t(b.descriptorType) << 8 | size_t(b.descriptorCount) << 16 | size_t(b.stageFlags) << 24;
+        h ^= std::hash<size_t>()(packed) + 0x9e3779b9 + (h << 6) + (h >> 2);
+      }
+      return h;
+    }
+  };
+
+  VkDevice device_;
+  std::unordered_map<Key, VkDescriptorSetLayout, KeyHash> layouts_;
+};
+
+// 可增长的描述符分配器：维护一组描述符池，当前池耗尽 (VK_ERROR_OUT_OF_POOL_MEMORY) 时
+// 按几何级数创建更大的新池。Reset 通过 vkResetDescriptorPool 一次性回收所有描述符集。
+class DescriptorAllocator {
+ public:
+  // 每个描述符集平均需要的各类描述符数量
+  struct PoolRatio {
+    VkDescriptorType type;
+    float ratio;
+  };
+
+  static std::vector<PoolRatio> DefaultRatios() {
+    return {{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f}};
+  }
+
+  DescriptorAllocator(VkDevice device, uint32_t initial_sets = 64, std::vector<PoolRatio> ratios = DefaultRatios(), float growth = 1.5f,
+                      uint32_t max_sets_per_pool = 4096)
+      : device_(device), ratios_(std::move(ratios)), growth_(growth), max_sets_per_pool_(max_sets_per_pool), sets_per_pool_(initial_sets) {}
+
+  ~DescriptorAllocator() {
+    for (auto pool : ready_pools_)
+      vkDestroyDescriptorPool(device_, pool, nullptr);
+    for (auto pool : full_pools_)
+      vkDestroyDescriptorPool(device_, pool, nullptr);
+  }
+
+  DescriptorAllocator(const DescriptorAllocator &) = delete;
+  DescriptorAllocator &operator=(const DescriptorAllocator &) = delete;
+  DescriptorAllocator(DescriptorAllocator &&o) noexcept { *this = std::move(o); }
+  DescriptorAllocator &operator=(DescriptorAllocator &&o) noexcept {
+    std::swap(device_, o.device_);
+    std::swap(ratios_, o.ratios_);
+    std::swap(growth_, o.growth_);
+    std::swap(max_sets_per_pool_, o.max_sets_per_pool_);
+    std::swap(sets_per_pool_, o.sets_per_pool_);
+    std::swap(ready_pools_, o.ready_pools_);
+    std::swap(full_pools_, o.full_pools_);
+    return *this;
+  }
+
+  VkDescriptorSet Allocate(VkDescriptorSetLayout layout) {
+    VkDescriptorPool pool = GetPool();
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet descriptor_set{};
+    VkResult err = vkAllocateDescriptorSets(device_, &allocInfo, &descriptor_set);
+    if (err == VK_ERROR_OUT_OF_POOL_MEMORY || err == VK_ERROR_FRAGMENTED_POOL) {
+      // 当前池已满，换一个更大的池重试
+      full_pools_.push_back(pool);
+      ready_pools_.pop_back();
+      allocInfo.descriptorPool = GetPool();
+      err = vkAllocateDescriptorSets(device_, &allocInfo, &descriptor_set);
+    }
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate descriptor sets!");
+
+    return descriptor_set;
+  }
+
+  // 回收所有描述符集，池本身保留以便复用
+  void Reset() {
+    for (auto pool : ready_pools_)
+      vkResetDescriptorPool(device_, pool, 0);
+    for (auto pool : full_pools_) {
+      vkResetDescriptorPool(device_, pool, 0);
+      ready_pools_.push_back(pool);
+    }
+    full_pools_.clear();
+  }
+
+  size_t pool_count() const { return ready_pools_.size() + full_pools_.size(); }
+
+ private:
+  VkDescriptorPool GetPool() {
+    if (!ready_pools_.empty())
+      return ready_pools_.back();
+
+    VkDescriptorPool pool = CreatePool(sets_per_pool_);
+    sets_per_pool_ = std::min(max_sets_per_pool_, static_cast<uint32_t>(sets_per_pool_ * growth_));
+    ready_pools_.push_back(pool);
+    return pool;
+  }
+
+  VkDescriptorPool CreatePool(uint32_t set_count) {
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto &ratio : ratios_)
+      poolSizes.push_back({ratio.type, std::max(1u, static_cast<uint32_t>(ratio.ratio * set_count))});
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = set_count;
+
+    VkDescriptorPool pool{};
+    if (vkCreateDescriptorPool(device_, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create descriptor pool!");
+    }
+    return pool;
+  }
+
+  VkDevice device_{};
+  std::vector<PoolRatio> ratios_;
+  float growth_{};
+  uint32_t max_sets_per_pool_{};
+  uint32_t sets_per_pool_{};
+  std::vector<VkDescriptorPool> ready_pools_;  // 还有空间的池，最后一个是当前池
+  std::vector<VkDescriptorPool> full_pools_;
+};
+
+// 每帧一组瞬态描述符池，帧开始时（该帧上一次的 GPU 工作已完成）整体重置。
+class FrameDescriptorAllocator {
+ public:
+  FrameDescriptorAllocator(VkDevice device, uint32_t frame_count, uint32_t initial_sets = 64) {
+    for (uint32_t i = 0; i < frame_count; ++i)
+      frames_.emplace_back(device, initial_sets);
+  }
+
+  void BeginFrame(uint32_t frame_index) {
+    current_ = frame_index % frames_.size();
+    frames_[current_].Reset();
+  }
+
+  VkDescriptorSet Allocate(VkDescriptorSetLayout layout) { return frames_[current_].Allocate(layout); }
+
+ private:
+  std::vector<DescriptorAllocator> frames_;
+  size_t current_{};
+};
+
+}  // namespace e3d
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace e3d {
+
+// 动态分辨率控制器：根据测得的 GPU 帧时间调整渲染缩放比例，使帧时间维持在预算内。
+// 像素开销与 scale^2 成正比，所以按 sqrt(目标/实际) 调整，降分辨率快、升分辨率慢以避免来回振荡。
+class DynamicResolution {
+ public:
+  struct Options {
+    float min_scale = 0.5f;
+    float max_scale = 1.0f;
+    float target_frame_ms = 16.0f;  // GPU 帧时间预算
+    float headroom = 0.9f;          // 实际瞄准 target_frame_ms * headroom，为抖动留余量
+    float smoothing = 0.2f;         // 帧时间指数平滑系数
+    float deadband = 0.05f;         // 相对误差在此范围内不调整
+    float max_step_down = 0.1f;     // 每次更新最多降低的比例
+    float max_step_up = 0.02f;      // 每次更新最多提高的比例
+    uint32_t alignment = 8;         // 渲染尺寸对齐到的像素数，不超过输出尺寸
+  };
+
+  DynamicResolution() : DynamicResolution(Options{}) {}
+  explicit DynamicResolution(Options options) : options_(options), scale_(options.max_scale) {}
+
+  const Options &options() const { return options_; }
+  float scale() const { return scale_; }
+  float filtered_frame_ms() const { return filtered_ms_; }
+
+  void SetTargetFrameMs(float ms) { options_.target_frame_ms = ms; }
+  void SetScale(float scale) { scale_ = std::clamp(scale, options_.min_scale, options_.max_scale); }
+
+  // 输入最近一帧的 GPU 时间（毫秒），返回新的缩放比例
+  float Update(float gpu_frame_ms) {
+    if (gpu_frame_ms <= 0.0f)
+      return scale_;
+
+    filtered_ms_ = filtered_ms_ == 0.0f ? gpu_frame_ms : filtered_ms_ + options_.smoothing * (gpu_frame_ms - filtered_ms_);
+
+    float ratio = options_.target_frame_ms * options_.headroom / filtered_ms_;
+    if (std::abs(ratio - 1.0f) < options_.deadband)
+      return scale_;
+
+    float step = scale_ * std::sqrt(ratio) - scale_;
+    step = std::clamp(step, -options_.max_step_down, options_.max_step_up);
+    scale_ = std::clamp(scale_ + step, options_.min_scale, options_.max_scale);
+    return scale_;
+  }
+
+  // 渲染目标按 max_scale 分配一次，之后只通过视口/裁剪矩形使用其中一部分
+  std::pair<uint32_t, uint32_t> MaxSize(uint32_t width, uint32_t height) const { return Size(width, height, options_.max_scale); }
+
+  std::pair<uint32_t, uint32_t> RenderSize(uint32_t width, uint32_t height) const {
+    auto [max_width, max_height] = MaxSize(width, height);
+    auto [w, h] = Size(width, height, scale_);
+    return {std::min(w, max_width), std::min(h, max_height)};
+  }
+
+ private:
+  std::pair<uint32_t, uint32_t> Size(uint32_t width, uint32_t height, float scale) const {
+    auto align = [&](uint32_t extent) {
+      uint32_t a = std::max(options_.alignment, 1u);
+      uint32_t n = std::max(static_cast<uint32_t>(std::ceil(extent * scale / a)) * a, a);
+      // 向上对齐后可能超过输出尺寸（例如 1366 对齐到 1368），渲染目标不能比要 blit 到的输出更大
+      uint32_t limit = static_cast<uint32_t>(std::ceil(extent * std::max(scale, 1.0f)));
+      return std::min(n, std::max(limit, 1u));
+    };
+    return {align(width), align(height)};
+  }
+
+  Options options_;
+  float scale_;
+  float filtered_ms_{};
+};
+
+}  // namespace e3d
@@ -10,21 +10,51 @@
 
 #include <Eigen/Core>
 #include <Eigen/Dense>
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <iostream>
+#include <list>
+#include <mutex>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "async_queue.hpp"
+#include "bvh.hpp"
+#include "deletion_queue.hpp"
+#include "counters.hpp"
+#include "descriptor_allocator.hpp"
+#include "dynamic_resolution.hpp"
+#include "job_system.hpp"
+#include "ktx2.hpp"
+#include "lines.hpp"
+#include "memory_budget.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplify.hpp"
+#include "occlusion.hpp"
+#include "pass_timer.hpp"
+#include "pipeline_registry.hpp"
+#include "playback.hpp"
+#include "point_cloud.hpp"
+#include "render_graph.hpp"
+#include "simd.hpp"
+#include "sprites.hpp"
+#include "timeline.hpp"
+#include "trace.hpp"
+
 namespace e3d {
 
 namespace helper {
@@ -49,7 +79,7 @@ inline static std::vector<char> ReadFile(const std::string &filename) {
 }
 
 // 从着色器代码创建一个 Vulkan 着色器模块
-VkShaderModule CreateShaderModule(VkDevice device, const std::vector<char> &code) {
+inline static VkShaderModule CreateShaderModule(VkDevice device, const std::vector<char> &code) {
   VkShaderModuleCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
   createInfo.codeSize = code.size();
@@ -160,8 +190,38 @@ inline static Eigen::Matrix4f Perspective(float fov, float aspectRatio, float zN
   return proj;
 }
 
+// 反向 Z、远平面在无穷远的透视投影：近平面深度为 1，无穷远处趋于 0。
+// 配合浮点深度缓冲、清除值 0 和 GREATER 比较使用，深度精度在远处分布更均匀。
+inline static Eigen::Matrix4f PerspectiveReverseZ(float fov, float aspectRatio, float zNear) {
+  float tanHalfFov = tan(fov / 2.0f);
+
+  Eigen::Matrix4f proj = Eigen::Matrix4f::Zero();
+  proj(0, 0) = 1.0f / (aspectRatio * tanHalfFov);
+  proj(1, 1) = 1.0f / tanHalfFov;
+  proj(2, 3) = zNear;
+  proj(3, 2) = -1.0f;
+
+  return proj;
+}
+
+// 屏幕像素 (x, y) 对应的世界空间射线（起点为相机位置，单位方向）。通过 inverse(proj * view) 反投影，
+// 与投影的具体约定（翻转的 y、反向 Z、无穷远平面）无关
+inline static std::pair<Eigen::Vector3f, Eigen::Vector3f> ScreenRay(float x, float y, uint32_t width, uint32_t height,
+                                                                    const Eigen::Matrix4f &view, const Eigen::Matrix4f &proj) {
+  Eigen::Matrix4f inverse = (proj * view).inverse();
+  Eigen::Vector4f ndc(2.0f * x / float(width) - 1.0f, 2.0f * y / float(height) - 1.0f, 0.5f, 1.0f);
+  Eigen::Vector4f world = inverse * ndc;
+  Eigen::Vector3f eye = view.inverse().block<3, 1>(0, 3);
+  Eigen::Vector3f direction = (world.head<3>() / world.w() - eye).normalized();
+  // 相机看向 view 第三行的反方向
+  Eigen::Vector3f forward = -view.block<1, 3>(2, 0).transpose();
+  if (direction.dot(forward) < 0.0f)
+    direction = -direction;
+  return {eye, direction};
+}
+
 // 将 32 位整数颜色值转换为 4 个浮点数表示的 RGBA 颜色。
-std::array<float, 4> ColorU32ToF32(uint32_t color) {
+inline static std::array<float, 4> ColorU32ToF32(uint32_t color) {
   std::array<float, 4> rgba;
   rgba[0] = ((color >> 24) & 0xFF) / 255.0f;  // 红通道
   rgba[1] = ((color >> 16) & 0xFF) / 255.0f;  // 绿通道
@@ -170,6 +230,74 @@ std::array<float, 4> ColorU32ToF32(uint32_t color) {
   return rgba;
 }
 
+// 纹理格式的块信息：块宽高（非压缩格式为 1x1）和每块字节数。
+struct FormatBlock {
+  uint32_t width;
+  uint32_t height;
+  uint32_t bytes;
+};
+
+inline static FormatBlock GetFormatBlock(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8_UNORM:
+      return {1, 1, 1};
+    case VK_FORMAT_R8G8_UNORM:
+      return {1, 1, 2};
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+      return {1, 1, 4};
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+      return {1, 1, 8};
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+      return {4, 4, 8};
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+      return {4, 4, 16};
+    default:
+      throw std::runtime_error("unsupported texture format " + std::to_string(format));
+  }
+}
+
+// 计算某级 mip 的字节数
+inline static VkDeviceSize MipBytes(VkFormat format, uint32_t width, uint32_t height, uint32_t level) {
+  auto block = GetFormatBlock(format);
+  uint32_t w = std::max(1u, width >> level);
+  uint32_t h = std::max(1u, height >> level);
+  return VkDeviceSize((w + block.width - 1) / block.width) * ((h + block.height - 1) / block.height) * block.bytes;
+}
+
+// 单个图像的布局转换和内存屏障。
+inline static void ImageBarrier(VkCommandBuffer cmd, VkImage image, VkImageAspectFlags aspect, uint32_t base_mip, uint32_t levels, VkImageLayout old_layout,
+                                VkImageLayout new_layout, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage,
+                                VkAccessFlags dst_access) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = old_layout;
+  barrier.newLayout = new_layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {aspect, base_mip, levels, 0, 1};
+  barrier.srcAccessMask = src_access;
+  barrier.dstAccessMask = dst_access;
+  vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
 }  // namespace helper
 
 // 两个成员变量：顶点位置和颜色
@@ -199,12 +327,17 @@ struct Vertex {
 };
 
 // 用于存储统一变量数据，包含三个4x4矩阵：模型矩阵、试图矩阵、投影矩阵
+// 每帧更新一次的 UBO，只放视图和投影矩阵
 struct Uniform {
-  alignas(16) Eigen::Matrix4f model;
   alignas(16) Eigen::Matrix4f view;
   alignas(16) Eigen::Matrix4f proj;
 };
 
+// 每次绘制通过 push constant 传入的数据，与 base.vert 中的 PushConstants 对应
+struct DrawConstants {
+  alignas(16) Eigen::Matrix4f model;
+};
+
 // 存储顶点数据，每个顶点包含位置和颜色。
 const std::vector<Vertex> vertices = {{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
                                       {{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
@@ -221,16 +354,40 @@ struct Frame {
   VkCommandBuffer command_buffer;  // 命令缓冲区，用于记录绘制命令。
 };
 
-// 虚基类，表示渲染管道
+// 渲染管道的基类。管线布局和管线都由 PipelineRegistry 按描述去重并持有，管线在工作线程上编译，
+// 编译完成之前 pipeline() 返回 VK_NULL_HANDLE，调用方跳过绘制或换用后备管线。
 class Pipeline {
  public:
   virtual ~Pipeline() {}
+
+  VkPipelineLayout pipeline_layout{};
+
+  VkPipeline pipeline() const { return registry_->Get(handle_); }
+  PipelineRegistry::Handle handle() const { return handle_; }
+  const PipelineDesc &desc() const { return desc_; }
+
+ protected:
+  explicit Pipeline(std::shared_ptr<PipelineRegistry> registry) : registry_(registry) {}
+
+  void Request(PipelineDesc desc, VkRenderPass render_pass, const RenderPassKey &render_pass_key) {
+    desc.layout = pipeline_layout;
+    desc.render_pass = render_pass;
+    desc.render_pass_key = render_pass_key;
+    desc_ = desc;
+    handle_ = registry_->Request(desc_);
+  }
+
+  std::shared_ptr<PipelineRegistry> registry_;
+  PipelineRegistry::Handle handle_{PipelineRegistry::kInvalid};
+  PipelineDesc desc_;
 };
 
 // 虚基类，表示渲染器
 class Renderer {
  public:
   virtual ~Renderer() {}
+  // 向渲染图声明本帧的通道，backbuffer 是当前交换链图像
+  virtual void AddPasses(RenderGraph &graph, RenderGraph::Resource backbuffer, uint32_t image_index) = 0;
   virtual void Render(VkCommandBuffer command_buffer, uint32_t image_index) = 0;
 };
 
@@ -262,6 +419,11 @@ class Window {
     vulkan_extensions = std::move(extensions);
   }
 
+  ~Window() {
+    SDL_DestroyWindow(sdl_window);
+    SDL_Quit();
+  }
+
   VkSurfaceKHR CreateVulkanSurface(VkInstance instance) {
     VkSurfaceKHR surface;
     if (SDL_Vulkan_CreateSurface(sdl_window, instance, &surface) == 0) {
@@ -295,7 +457,16 @@ struct GpuContext {
   VkQueue graphics_queue{};             // 图形队列，用于执行绘图命令。
   uint32_t present_family_index;        // 呈现队列族的索引，用于提交呈现命令。
   VkQueue present_queue{};              // 呈现队列，用于执行呈现命令。
+  uint32_t compute_family_index;        // 异步计算队列族，没有独立的计算队列族时与图形队列族相同。
+  VkQueue compute_queue{};              // 异步计算队列，与图形队列族相同时就是图形队列。
+  uint32_t transfer_family_index;       // 传输队列族，没有独立的传输队列族时与图形队列族相同。
+  VkQueue transfer_queue{};             // 传输队列，与图形队列族相同时就是图形队列。
   VkPresentModeKHR present_mode{};      // 呈现模式，定义了交换链如何处理图像显示。
+  VkPhysicalDeviceFeatures enabled_features{};  // 创建逻辑设备时启用的特性，例如纹理压缩格式。
+  float timestamp_period{};                     // 时间戳计数每增加 1 对应的纳秒数，为 0 表示图形队列不支持时间戳。
+  bool calibrated_timestamps{};                 // 是否启用了 VK_EXT_calibrated_timestamps
+  VkTimeDomainEXT host_time_domain{};           // 与 trace::Now() 对应的主机时间域
+  bool memory_budget{};                         // 是否启用了 VK_EXT_memory_budget
 
   VkSwapchainKHR swapchain{};                      // 交换链，管理用于呈现的图像队列。
   VkFormat swapchain_image_format{};               // 交换链图像格式，定义交换链图像的颜色格式。
@@ -306,7 +477,7 @@ struct GpuContext {
   VkCommandPool command_pool{};                  // 命令池，用于分配命令缓冲区。
   std::vector<VkCommandBuffer> command_buffers;  // 命令缓冲区列表，用于记录和提交绘图命令。
 
-  VkFence in_flight_fence;                // 用于同步的栅栏，确保GPU完成当前帧的渲染。
+  // 二进制信号量只用于交换链，其余同步都通过队列时间线
   VkSemaphore image_available_semaphore;  // 信号量，表示图像已可用并且可以开始渲染。
   VkSemaphore render_finished_semaphore;  // 信号量，表示渲染已完成并且可以进行呈现。
 };
@@ -322,12 +493,89 @@ class Gpu {
 
   bool swapchain_rebuild{false};
 
+ public:
+  // 无窗口模式：不创建表面和交换链，渲染到普通的设备本地图像，用于基准测试和 CI
+  struct HeadlessOptions {
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    uint32_t image_count = 2;
+    bool prefer_cpu_device = false;  // 优先选择软件实现（例如 lavapipe / SwiftShader）
+  };
+
+ private:
+  bool headless_{false};
+  HeadlessOptions headless_options_;
+  std::vector<VkDeviceMemory> headless_memory_;
+
   std::shared_ptr<GpuContext> context_;
+  std::shared_ptr<QueueTimeline> graphics_timeline_;
+  std::shared_ptr<QueueTimeline> compute_timeline_;   // 与图形队列族相同时就是 graphics_timeline_
+  std::shared_ptr<QueueTimeline> transfer_timeline_;  // 同上
+  std::unique_ptr<CommandBufferPool> compute_commands_;
+  std::unique_ptr<CommandBufferPool> transfer_commands_;
+  std::shared_ptr<DeletionQueue> deletion_queue_;
+  uint64_t frame_{};       // 已提交的帧数
+  SyncPoint frame_sync_{};  // 最近一帧提交完成时的时间线值
+  double wait_ms_{};        // 最近一帧开始时等待上一帧和交换链图像的时间
+
+  // 异步提交留给下一帧图形提交的等待和所有权获取
+  std::mutex next_frame_mutex_;
+  std::vector<Submission::Wait> next_frame_waits_;
+  std::vector<QueueHandoff> next_frame_acquires_;
+
+  std::shared_ptr<MemoryBudget> memory_budget_;
+
+  // GPU 时间戳到跟踪时钟的换算：最近一次校准时同一时刻的两个读数
+  PFN_vkGetCalibratedTimestampsEXT get_calibrated_timestamps_{};
+  uint64_t calibration_gpu_ticks_{};
+  int64_t calibration_cpu_ns_{};
+  bool calibrated_{false};
 
  public:
-  Gpu(Window *_window) : window(_window) {
+  Gpu(Window *_window) : window(_window) { Init(); }
+
+  explicit Gpu(const HeadlessOptions &options) : headless_(true), headless_options_(options) { Init(); }
+
+  // 调用前其它模块需已释放它们的对象，剩余的待删除对象在销毁设备前清空
+  ~Gpu() {
+    auto device = context_->device;
+    vkDeviceWaitIdle(device);
+    deletion_queue_->Flush();
+
+    compute_commands_.reset();
+    transfer_commands_.reset();
+    compute_timeline_.reset();
+    transfer_timeline_.reset();
+    graphics_timeline_.reset();
+    vkDestroySemaphore(device, context_->render_finished_semaphore, nullptr);
+    vkDestroySemaphore(device, context_->image_available_semaphore, nullptr);
+    vkDestroyCommandPool(device, context_->command_pool, nullptr);
+    if (headless_) {
+      for (size_t i = 0; i < context_->swapchain_images.size(); ++i) {
+        deletion_queue_->Destroy(context_->swapchain_image_views[i]);
+        deletion_queue_->Destroy(context_->swapchain_images[i]);
+        deletion_queue_->Destroy(headless_memory_[i]);
+      }
+    } else {
+      for (auto view : context_->swapchain_image_views)
+        vkDestroyImageView(device, view, nullptr);
+      vkDestroySwapchainKHR(device, context_->swapchain, nullptr);
+    }
+    vkDestroyDevice(device, nullptr);
+    if (context_->surface)
+      vkDestroySurfaceKHR(context_->instance, context_->surface, nullptr);
+    vkDestroyInstance(context_->instance, allocator);
+  }
+
+  bool headless() const { return headless_; }
+
+  // 渲染结束时交换链图像（无窗口模式下的目标图像）应处的布局
+  VkImageLayout present_layout() const { return headless_ ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
+
+ private:
+  void Init() {
     context_ = std::make_shared<GpuContext>();
-    context_->extent = {800, 600};
+    context_->extent = headless_ ? VkExtent2D{headless_options_.width, headless_options_.height} : VkExtent2D{800, 600};
 
 #ifdef WITH_VOLK
     volkInitialize();
@@ -336,10 +584,23 @@ class Gpu {
 #else
     CreateInstance();
 #endif
-    CreateSurface();
+    if (!headless_)
+      CreateSurface();
     PickPhysicalDevice();
     CreateDevice();
-    CreateSwapChain();
+    graphics_timeline_ = std::make_shared<QueueTimeline>(context_->device, context_->graphics_queue, context_->graphics_family_index, "graphics");
+    trace::SetTrackName(trace::kGpuTrack, "GPU graphics queue");
+    CreateAsyncQueues();
+    deletion_queue_ = std::make_shared<DeletionQueue>(context_->device);
+    memory_budget_ = std::make_shared<MemoryBudget>(context_->physical_device, context_->memory_budget);
+    deletion_queue_->SetFreeMemoryCallback([budget = std::weak_ptr<MemoryBudget>(memory_budget_)](VkDeviceMemory memory) {
+      if (auto b = budget.lock())
+        b->OnFree(memory);
+    });
+    if (headless_)
+      CreateHeadlessImages();
+    else
+      CreateSwapChain();
     CreateSyncObjects();
 
     context_->command_pool = CreateCommandPool();
@@ -350,20 +611,90 @@ class Gpu {
     }
   }
 
+ public:
   uint32_t width() { return context_->extent.width; }
   uint32_t height() { return context_->extent.height; };
   VkFormat image_format() { return context_->swapchain_image_format; }
   uint32_t image_count() { return context_->swapchain_image_count; }
 
   std::shared_ptr<GpuContext> context() { return context_; }
+  std::shared_ptr<DeletionQueue> deletion_queue() { return deletion_queue_; }
+  std::shared_ptr<MemoryBudget> memory_budget() { return memory_budget_; }
+  std::shared_ptr<QueueTimeline> graphics_timeline() { return graphics_timeline_; }
+  std::shared_ptr<QueueTimeline> compute_timeline() { return compute_timeline_; }
+  std::shared_ptr<QueueTimeline> transfer_timeline() { return transfer_timeline_; }
+  bool has_async_compute() const { return compute_timeline_ != graphics_timeline_; }
+  bool has_async_transfer() const { return transfer_timeline_ != graphics_timeline_; }
+  uint64_t frame() const { return frame_; }
+  SyncPoint frame_sync() const { return frame_sync_; }
+  double wait_ms() const { return wait_ms_; }
+
+  // 重新读取一对 GPU/主机时间戳。GPU 与 CPU 时钟会缓慢漂移，采集期间定期调用。
+  void CalibrateTimestamps() {
+    if (!context_->calibrated_timestamps)
+      return;
+
+    VkCalibratedTimestampInfoEXT infos[2]{};
+    infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    infos[1].timeDomain = context_->host_time_domain;
+    uint64_t timestamps[2]{};
+    uint64_t max_deviation{};
+    VkResult err = get_calibrated_timestamps_(context_->device, 2, infos, timestamps, &max_deviation);
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("vkGetCalibratedTimestampsEXT failed " + helper::ToStr(err));
+
+    calibration_gpu_ticks_ = timestamps[0];
+    if (context_->host_time_domain == VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT)
+      calibration_cpu_ns_ = int64_t(double(timestamps[1]) * 1e9 / double(SDL_GetPerformanceFrequency()));
+    else
+      calibration_cpu_ns_ = int64_t(timestamps[1]);  // CLOCK_MONOTONIC，单位已经是纳秒
+    calibrated_ = true;
+  }
+
+  // 把图形队列的时间戳换算到 trace::Now() 的时间轴；没有校准数据时返回 false
+  bool GpuTicksToTraceNs(uint64_t ticks, int64_t &ns) const {
+    if (!calibrated_)
+      return false;
+    ns = calibration_cpu_ns_ + int64_t(double(int64_t(ticks - calibration_gpu_ticks_)) * context_->timestamp_period);
+    return true;
+  }
+
+  // 异步队列上的一次提交。record 录制命令；handoff 中的资源由本次提交写入、下一帧的图形命令读取，
+  // 引擎负责所有权转移（释放屏障录制在本次提交末尾，获取屏障录制在下一帧图形命令开头），
+  // 并让下一帧的图形提交在 handoff.dst_stage 等待本次提交，此前的阶段与本次提交并行执行。
+  struct AsyncSubmission {
+    std::function<void(VkCommandBuffer)> record;
+    std::vector<Submission::Wait> waits;  // 额外的依赖，例如 frame_sync() 表示等待上一帧图形命令的结果
+    QueueHandoff handoff;                 // 队列族由引擎填写
+    bool next_frame_waits = true;         // false 时只返回同步点，由调用方自行安排等待
+  };
+
+  // 在计算队列上提交，例如剔除、粒子模拟、后处理。没有独立计算队列时提交到图形队列，行为相同。
+  SyncPoint SubmitCompute(AsyncSubmission submission) { return SubmitAsync(*compute_commands_, std::move(submission)); }
+
+  // 在传输队列上提交，适合与渲染并行的大块拷贝
+  SyncPoint SubmitTransfer(AsyncSubmission submission) {
+    if (submission.handoff.src_stage == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+      submission.handoff.src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    return SubmitAsync(*transfer_commands_, std::move(submission));
+  }
 
-  VkCommandPool CreateCommandPool() {
-    auto graphics_family_index = context_->graphics_family_index;
+  // 让下一帧的图形提交在 stage 等待 point，用于调用方自己安排的跨队列依赖
+  void WaitInNextFrame(SyncPoint point, VkPipelineStageFlags stage) {
+    std::lock_guard<std::mutex> lock(next_frame_mutex_);
+    next_frame_waits_.push_back({point, stage});
+  }
+
+  VkCommandPool CreateCommandPool() { return CreateCommandPool(context_->graphics_family_index); }
+
+  VkCommandPool CreateCommandPool(uint32_t family_index) {
     auto device = context_->device;
 
     VkCommandPoolCreateInfo pool_info = {};
     pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    pool_info.queueFamilyIndex = graphics_family_index;
+    pool_info.queueFamilyIndex = family_index;
     pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
     VkCommandPool command_pool{};
@@ -392,17 +723,36 @@ class Gpu {
     return command_buffer;
   }
 
-  VkFramebuffer CreateFramebuffer(VkRenderPass render_pass, uint32_t image_index) {
+  // 使用自定义附件的帧缓冲，例如离屏渲染目标
+  VkFramebuffer CreateFramebuffer(VkRenderPass render_pass, const std::vector<VkImageView> &attachments, uint32_t width, uint32_t height) {
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = render_pass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = width;
+    framebufferInfo.height = height;
+    framebufferInfo.layers = 1;
+    VkFramebuffer framebuffer{};
+    if (vkCreateFramebuffer(context_->device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+      throw std::runtime_error("failed to create framebuffer!");
+
+    return deletion_queue_->Track(framebuffer);
+  }
+
+  // 交换链图像作为 0 号附件，extra_attachments（例如深度）依次排在后面
+  VkFramebuffer CreateFramebuffer(VkRenderPass render_pass, uint32_t image_index, const std::vector<VkImageView> &extra_attachments = {}) {
     auto device = context_->device;
     auto extent = context_->extent;
     auto image_View = context_->swapchain_image_views[image_index];
 
-    VkImageView attachments[] = {image_View};
+    std::vector<VkImageView> attachments = {image_View};
+    attachments.insert(attachments.end(), extra_attachments.begin(), extra_attachments.end());
     VkFramebufferCreateInfo framebufferInfo{};
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     framebufferInfo.renderPass = render_pass;
-    framebufferInfo.attachmentCount = 1;
-    framebufferInfo.pAttachments = attachments;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
     framebufferInfo.width = extent.width;
     framebufferInfo.height = extent.height;
     framebufferInfo.layers = 1;
@@ -410,36 +760,48 @@ class Gpu {
     if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
       throw std::runtime_error("failed to create framebuffer!");
 
-    return framebuffer;
+    return deletion_queue_->Track(framebuffer);
   }
 
   void Render(std::function<void(VkCommandBuffer, uint32_t)> &&render_func) {
-    const auto &instance = context_->instance;
+    E3D_TRACE_SCOPE("Gpu::Render");
     const auto &device = context_->device;
     const auto &swapchain = context_->swapchain;
     const auto &graphics_queue = context_->graphics_queue;
     const auto &present_queue = context_->present_queue;
-    const auto &in_flight_fence = context_->in_flight_fence;
     const auto &image_available_semaphore = context_->image_available_semaphore;
     const auto &render_finished_semaphore = context_->render_finished_semaphore;
-    const auto &command_pool = context_->command_pool;
 
-    // 等待CPU同步
-    VkResult err = vkWaitForFences(device, 1, &in_flight_fence, VK_TRUE, UINT64_MAX);
-    if (err != VK_SUCCESS)
-      throw std::runtime_error("vkWaitForFences failed " + helper::ToStr(err));
-    err = vkResetFences(device, 1, &in_flight_fence);
-    if (err != VK_SUCCESS)
-      throw std::runtime_error("vkResetFences failed " + helper::ToStr(err));
+    // 等待上一帧完成（同时只有一帧在途），销毁时间线上已完成的提交所释放的对象
+    auto wait_start = std::chrono::steady_clock::now();
+    {
+      E3D_TRACE_SCOPE("wait previous frame");
+      graphics_timeline_->Wait(frame_sync_.value);
+    }
+    wait_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wait_start).count();
+    deletion_queue_->Collect(graphics_timeline_->Completed());
+    memory_budget_->Update();
 
-    // 请求帧
+    // 跟踪采集期间约每秒重新校准一次
+    if (trace::Enabled() && (!calibrated_ || frame_ % 60 == 0))
+      CalibrateTimestamps();
+
+    // 请求帧；无窗口模式轮流使用目标图像
     uint32_t image_index{};
-    err = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, image_available_semaphore, VK_NULL_HANDLE, &image_index);
-    if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR) {
-      swapchain_rebuild = true;
-      return;
-    } else if (err != VK_SUCCESS) {
-      throw std::runtime_error("vkAcquireNextImageKHR failed " + helper::ToStr(err));
+    VkResult err = VK_SUCCESS;
+    if (headless_) {
+      image_index = static_cast<uint32_t>(frame_ % context_->swapchain_image_count);
+    } else {
+      E3D_TRACE_SCOPE("acquire");
+      auto acquire_start = std::chrono::steady_clock::now();
+      err = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, image_available_semaphore, VK_NULL_HANDLE, &image_index);
+      wait_ms_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - acquire_start).count();
+      if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR) {
+        swapchain_rebuild = true;
+        return;
+      } else if (err != VK_SUCCESS) {
+        throw std::runtime_error("vkAcquireNextImageKHR failed " + helper::ToStr(err));
+      }
     }
 
     const auto &command_buffer = context_->command_buffers[image_index];
@@ -451,6 +813,17 @@ class Gpu {
     if (err != VK_SUCCESS)
       throw std::runtime_error("vkBeginCommandBuffer failed " + helper::ToStr(err));
 
+    // 取走异步提交留给本帧的等待，并在任何图形命令之前获取它们转移过来的资源
+    std::vector<Submission::Wait> async_waits;
+    std::vector<QueueHandoff> acquires;
+    {
+      std::lock_guard<std::mutex> lock(next_frame_mutex_);
+      async_waits.swap(next_frame_waits_);
+      acquires.swap(next_frame_acquires_);
+    }
+    for (const auto &handoff : acquires)
+      RecordAcquire(command_buffer, handoff);
+
     // 录制指令
     if (render_func)
       render_func(command_buffer, image_index);
@@ -460,32 +833,27 @@ class Gpu {
     if (err != VK_SUCCESS)
       throw std::runtime_error("vkEndCommandBuffer failed " + helper::ToStr(err));
 
-    // 提交渲染
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkSemaphore waitSemaphores[] = {image_available_semaphore};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &command_buffer;
-
-    VkSemaphore signalSemaphores[] = {render_finished_semaphore};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    if (vkQueueSubmit(graphics_queue, 1, &submitInfo, in_flight_fence) != VK_SUCCESS) {
-      throw std::runtime_error("failed to submit draw command buffer!");
+    // 提交渲染：等待交换链图像可用，完成后推进图形时间线并通知呈现
+    Submission submission;
+    submission.command_buffers = {command_buffer};
+    submission.waits = std::move(async_waits);
+    if (!headless_) {
+      submission.binary_waits = {{image_available_semaphore, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}};
+      submission.binary_signals = {render_finished_semaphore};
     }
+    frame_sync_ = graphics_timeline_->Submit(submission);
+    frame_++;
+
+    // 本帧录制期间释放的对象在本帧完成后销毁
+    deletion_queue_->Commit(frame_sync_.value);
+    if (headless_)
+      return;
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &render_finished_semaphore;
 
     VkSwapchainKHR swapChains[] = {swapchain};
     presentInfo.swapchainCount = 1;
@@ -493,10 +861,15 @@ class Gpu {
 
     presentInfo.pImageIndices = &image_index;
 
-    vkQueuePresentKHR(present_queue, &presentInfo);
+    if (present_queue == graphics_queue)
+      graphics_timeline_->Present(presentInfo);
+    else
+      vkQueuePresentKHR(present_queue, &presentInfo);
   }
 
-  void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
+  void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory,
+                    MemoryCategory category = MemoryCategory::kOther) {
+    E3D_TRACE_SCOPE("Gpu::CreateBuffer");
     const auto &device = context_->device;
 
     VkBufferCreateInfo bufferInfo{};
@@ -511,23 +884,87 @@ class Gpu {
 
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+    bufferMemory = AllocateMemory(memRequirements, properties, category);
+
+    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    deletion_queue_->Track(buffer);
+    deletion_queue_->Track(bufferMemory);
+  }
+
+  void CreateImage(uint32_t width, uint32_t height, uint32_t mip_levels, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
+                   VkImage &image, VkDeviceMemory &imageMemory, MemoryCategory category = MemoryCategory::kOther) {
+    const auto &device = context_->device;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {width, height, 1};
+    imageInfo.mipLevels = mip_levels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+    imageMemory = AllocateMemory(memRequirements, properties, category);
+
+    vkBindImageMemory(device, image, imageMemory, 0);
+    deletion_queue_->Track(image);
+    deletion_queue_->Track(imageMemory);
+  }
 
+  // 分配设备内存并计入显存预算。超过硬预算时给出警告，是否分配仍由驱动决定；
+  // 流送系统应在软预算处就开始逐出，正常情况下不会走到这里。
+  VkDeviceMemory AllocateMemory(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, MemoryCategory category) {
     VkMemoryAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, properties);
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-      throw std::runtime_error("failed to allocate buffer memory!");
-    }
+    if (memory_budget_->ExceedsHardLimit(allocInfo.memoryTypeIndex, requirements.size))
+      std::cerr << "memory budget: " << Name(category) << " allocation of " << requirements.size << " bytes exceeds the hard budget of heap "
+                << memory_budget_->HeapOfType(allocInfo.memoryTypeIndex) << std::endl;
 
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    VkDeviceMemory memory{};
+    VkResult err = vkAllocateMemory(context_->device, &allocInfo, nullptr, &memory);
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("vkAllocateMemory failed for " + std::string(Name(category)) + " " + helper::ToStr(err));
+    counters::Add(counters::Counter::kDeviceBytesAllocated, int64_t(requirements.size));
+    memory_budget_->OnAllocate(memory, allocInfo.memoryTypeIndex, requirements.size, category);
+    return memory;
+  }
+
+  VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect, uint32_t mip_levels) {
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange.aspectMask = aspect;
+    view_info.subresourceRange.baseMipLevel = 0;
+    view_info.subresourceRange.levelCount = mip_levels;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+
+    VkImageView image_view{};
+    VkResult err = vkCreateImageView(context_->device, &view_info, nullptr, &image_view);
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("Failed to create image view");
+
+    return deletion_queue_->Track(image_view);
   }
 
   void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
     auto &device = context_->device;
     auto &commandPool = context_->command_pool;
-    auto &graphicsQueue = context_->graphics_queue;
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -547,16 +984,15 @@ class Gpu {
     VkBufferCopy copyRegion{};
     copyRegion.size = size;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+    counters::Add(counters::Counter::kUploadBytes, int64_t(size));
 
     vkEndCommandBuffer(commandBuffer);
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+    // 只等待这次拷贝对应的时间线值，而不是整个队列空闲
+    Submission submission;
+    submission.command_buffers = {commandBuffer};
+    auto point = graphics_timeline_->Submit(submission);
+    graphics_timeline_->Wait(point.value);
 
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
   }
@@ -584,7 +1020,9 @@ class Gpu {
     vkEnumerateInstanceLayerProperties(&layer_count, available_layers.data());
 
     // 选择需要的层和扩展
-    std::vector<char *> extensions{"VK_KHR_surface", "VK_KHR_win32_surface"};
+    std::vector<const char *> extensions;
+    if (!headless_)
+      extensions = {"VK_KHR_surface", "VK_KHR_win32_surface"};
     std::vector<const char *> layers;
     // 添加调试扩展
     if (enable_debug_report) {
@@ -602,9 +1040,16 @@ class Gpu {
     if (helper::IsExtensionAvailable(available_extensions, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
       extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 
-    // 创建实例
+    // 创建实例，时间线信号量需要 Vulkan 1.2
+    VkApplicationInfo app_info = {};
+    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_info.pApplicationName = "e3d";
+    app_info.pEngineName = "e3d";
+    app_info.apiVersion = VK_API_VERSION_1_2;
+
     VkInstanceCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    create_info.pApplicationInfo = &app_info;
     create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     create_info.ppEnabledExtensionNames = extensions.data();
     create_info.enabledLayerCount = static_cast<uint32_t>(layers.size());
@@ -651,12 +1096,14 @@ class Gpu {
     if (err != VK_SUCCESS)
       throw std::runtime_error("vkEnumeratePhysicalDevices failed " + helper::ToStr(err));
 
-    // perferring discrete gpu
+    // perferring discrete gpu，无窗口模式可以要求软件实现以便在没有 GPU 的机器上运行
+    VkPhysicalDeviceType preferred_type =
+        headless_ && headless_options_.prefer_cpu_device ? VK_PHYSICAL_DEVICE_TYPE_CPU : VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
     VkPhysicalDevice physical_device{};
     for (VkPhysicalDevice &device : gpus) {
       VkPhysicalDeviceProperties properties;
       vkGetPhysicalDeviceProperties(device, &properties);
-      if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+      if (properties.deviceType == preferred_type) {
         physical_device = device;
       }
     }
@@ -670,12 +1117,51 @@ class Gpu {
     auto surface = context_->surface;
     auto physical_device = context_->physical_device;
 
-    const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    std::vector<const char *> deviceExtensions;
+    if (!headless_)
+      deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+    // 可选：GPU 时间戳与主机时钟校准，用于把 GPU 区间放进 CPU 跟踪的时间轴
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extensionCount, availableExtensions.data());
+    bool calibrated_timestamps = false;
+
+    // 可选：驱动报告的各堆预算和用量，没有时退回引擎自己的统计
+    if (helper::IsExtensionAvailable(availableExtensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+      deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+      context_->memory_budget = true;
+    }
+    if (helper::IsExtensionAvailable(availableExtensions, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+#ifdef _WIN32
+      VkTimeDomainEXT host_time_domain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+      VkTimeDomainEXT host_time_domain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+      auto get_time_domains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+          vkGetInstanceProcAddr(context_->instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+      std::vector<VkTimeDomainEXT> domains;
+      if (get_time_domains) {
+        uint32_t domainCount = 0;
+        get_time_domains(physical_device, &domainCount, nullptr);
+        domains.resize(domainCount);
+        get_time_domains(physical_device, &domainCount, domains.data());
+      }
+      auto has_domain = [&](VkTimeDomainEXT domain) { return std::find(domains.begin(), domains.end(), domain) != domains.end(); };
+      if (has_domain(VK_TIME_DOMAIN_DEVICE_EXT) && has_domain(host_time_domain)) {
+        deviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+        context_->host_time_domain = host_time_domain;
+        calibrated_timestamps = true;
+      }
+    }
 
-    auto [graphics_family_index, present_family_index] = FindQueueFamilies(physical_device, surface);
+    auto families = FindQueueFamilies(physical_device, surface);
+    auto graphics_family_index = families.graphics;
+    auto present_family_index = families.present;
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {graphics_family_index, present_family_index};
+    std::set<uint32_t> uniqueQueueFamilies = {graphics_family_index, present_family_index, families.compute, families.transfer};
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -687,10 +1173,36 @@ class Gpu {
       queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // 启用设备支持的块压缩纹理格式
+    VkPhysicalDeviceFeatures supportedFeatures{};
+    vkGetPhysicalDeviceFeatures(physical_device, &supportedFeatures);
     VkPhysicalDeviceFeatures deviceFeatures{};
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+    deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    deviceFeatures.largePoints = supportedFeatures.largePoints;  // 点云的点大小
+
+    // 所有队列同步都基于时间线信号量
+    VkPhysicalDeviceProperties deviceProperties{};
+    vkGetPhysicalDeviceProperties(physical_device, &deviceProperties);
+    VkPhysicalDeviceVulkan12Features supported12{};
+    supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supported2{};
+    supported2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported2.pNext = &supported12;
+    if (deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+      vkGetPhysicalDeviceFeatures2(physical_device, &supported2);
+    if (!supported12.timelineSemaphore)
+      throw std::runtime_error("timeline semaphores (Vulkan 1.2) are not supported by " + std::string(deviceProperties.deviceName));
+
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.timelineSemaphore = VK_TRUE;
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &features12;
 
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -711,11 +1223,29 @@ class Gpu {
     VkQueue present_queue{};
     vkGetDeviceQueue(device, present_family_index, 0, &present_queue);
 
+    VkQueue compute_queue{};
+    vkGetDeviceQueue(device, families.compute, 0, &compute_queue);
+
+    VkQueue transfer_queue{};
+    vkGetDeviceQueue(device, families.transfer, 0, &transfer_queue);
+
     context_->device = device;
+    context_->enabled_features = deviceFeatures;
+
+    if (deviceProperties.limits.timestampComputeAndGraphics)
+      context_->timestamp_period = deviceProperties.limits.timestampPeriod;
+    if (calibrated_timestamps && context_->timestamp_period != 0.0f) {
+      get_calibrated_timestamps_ = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT"));
+      context_->calibrated_timestamps = get_calibrated_timestamps_ != nullptr;
+    }
     context_->graphics_family_index = graphics_family_index;
     context_->present_family_index = present_family_index;
     context_->graphics_queue = graphics_queue;
     context_->present_queue = present_queue;
+    context_->compute_family_index = families.compute;
+    context_->compute_queue = compute_queue;
+    context_->transfer_family_index = families.transfer;
+    context_->transfer_queue = transfer_queue;
   }
 
   void CreateSwapChain() {
@@ -803,7 +1333,7 @@ class Gpu {
       swapchain_info.imageColorSpace = surface_format.colorSpace;
       swapchain_info.imageExtent = extent;
       swapchain_info.imageArrayLayers = 1;
-      swapchain_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+      swapchain_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;  // 场景从中间目标 blit 上来
       swapchain_info.preTransform = pre_transform;
       swapchain_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
       swapchain_info.presentMode = present_mode;
@@ -858,21 +1388,31 @@ class Gpu {
     context_->swapchain_image_views = std::move(swapchain_image_views);
   }
 
+  // 无窗口模式下代替交换链的目标图像，格式与常见的交换链格式一致
+  void CreateHeadlessImages() {
+    auto count = std::max(headless_options_.image_count, 1u);
+    context_->swapchain_image_format = VK_FORMAT_B8G8R8A8_UNORM;
+    context_->surface_format = {VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    context_->swapchain_image_count = count;
+    for (uint32_t i = 0; i < count; ++i) {
+      VkImage image{};
+      VkDeviceMemory memory{};
+      CreateImage(context_->extent.width, context_->extent.height, 1, context_->swapchain_image_format,
+                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  image, memory, MemoryCategory::kRenderTargets);
+      context_->swapchain_images.push_back(image);
+      context_->swapchain_image_views.push_back(CreateImageView(image, context_->swapchain_image_format, VK_IMAGE_ASPECT_COLOR_BIT, 1));
+      headless_memory_.push_back(memory);
+    }
+  }
+
   void CreateSyncObjects() {
     auto device = context_->device;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    VkFence in_flight_fence;
-    auto err = vkCreateFence(device, &fenceInfo, nullptr, &in_flight_fence);
-    if (err != VK_SUCCESS)
-      throw std::runtime_error("Failed to create fence");
-
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     VkSemaphore image_available_semaphore;
-    err = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &image_available_semaphore);
+    auto err = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &image_available_semaphore);
     if (err != VK_SUCCESS)
       throw std::runtime_error("Failed to create semaphore");
     VkSemaphore render_finished_semaphore;
@@ -880,15 +1420,59 @@ class Gpu {
     if (err != VK_SUCCESS)
       throw std::runtime_error("Failed to create semaphore");
 
-    context_->in_flight_fence = in_flight_fence;
     context_->image_available_semaphore = image_available_semaphore;
     context_->render_finished_semaphore = render_finished_semaphore;
   }
 
  private:
-  std::pair<uint32_t, uint32_t> FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) {
-    uint32_t graphicsFamily{UINT32_MAX};
-    uint32_t presentFamily{UINT32_MAX};
+  // 独立的队列族各自创建时间线；与图形队列族相同时共用图形队列和它的时间线，同一个 VkQueue 只能有一把锁
+  void CreateAsyncQueues() {
+    auto make_timeline = [&](uint32_t family_index, VkQueue queue, const char *name) {
+      if (family_index == context_->graphics_family_index)
+        return graphics_timeline_;
+      return std::make_shared<QueueTimeline>(context_->device, queue, family_index, name);
+    };
+    compute_timeline_ = make_timeline(context_->compute_family_index, context_->compute_queue, "compute");
+    transfer_timeline_ = make_timeline(context_->transfer_family_index, context_->transfer_queue, "transfer");
+    compute_commands_ = std::make_unique<CommandBufferPool>(context_->device, compute_timeline_.get());
+    transfer_commands_ = std::make_unique<CommandBufferPool>(context_->device, transfer_timeline_.get());
+  }
+
+  SyncPoint SubmitAsync(CommandBufferPool &commands, AsyncSubmission submission) {
+    E3D_TRACE_SCOPE("Gpu::SubmitAsync");
+    auto &handoff = submission.handoff;
+    handoff.src_family = commands.timeline()->family_index();
+    handoff.dst_family = context_->graphics_family_index;
+
+    VkCommandBuffer command_buffer = commands.Begin();
+    if (submission.record)
+      submission.record(command_buffer);
+    RecordRelease(command_buffer, handoff);
+
+    Submission async;
+    async.waits = std::move(submission.waits);
+    auto point = commands.Submit(command_buffer, std::move(async));
+
+    if (submission.next_frame_waits || !handoff.empty()) {
+      std::lock_guard<std::mutex> lock(next_frame_mutex_);
+      next_frame_waits_.push_back({point, handoff.dst_stage});
+      if (!handoff.empty())
+        next_frame_acquires_.push_back(std::move(handoff));
+    }
+    return point;
+  }
+
+  struct QueueFamilyIndices {
+    uint32_t graphics{UINT32_MAX};
+    uint32_t present{UINT32_MAX};
+    uint32_t compute{UINT32_MAX};
+    uint32_t transfer{UINT32_MAX};
+  };
+
+  // 计算队列族优先选择不带图形能力的（独立的异步计算引擎），传输队列族优先选择只有传输能力的（DMA 引擎），
+  // 都没有时退回图形队列族，调用方不需要区分。
+  QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) {
+    QueueFamilyIndices indices;
 
     uint32_t queueFamilyCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
@@ -896,27 +1480,36 @@ class Gpu {
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-    int i = 0;
-    for (const auto &queueFamily : queueFamilies) {
-      if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-        graphicsFamily = i;
+    for (uint32_t i = 0; i < queueFamilyCount; ++i) {
+      auto flags = queueFamilies[i].queueFlags;
+      if ((flags & VK_QUEUE_GRAPHICS_BIT) && indices.graphics == UINT32_MAX) {
+        indices.graphics = i;
       }
 
       VkBool32 presentSupport = false;
-      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+      if (surface != VK_NULL_HANDLE)
+        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+      else
+        presentSupport = indices.graphics == i;  // 无窗口模式不呈现，与图形队列共用
 
-      if (presentSupport) {
-        presentFamily = i;
+      if (presentSupport && indices.present == UINT32_MAX) {
+        indices.present = i;
       }
 
-      if (graphicsFamily != UINT32_MAX && presentFamily != UINT32_MAX) {
-        break;
+      if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && indices.compute == UINT32_MAX) {
+        indices.compute = i;
       }
 
-      i++;
+      if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && indices.transfer == UINT32_MAX) {
+        indices.transfer = i;
+      }
     }
 
-    return {graphicsFamily, presentFamily};
+    if (indices.compute == UINT32_MAX)
+      indices.compute = indices.graphics;
+    if (indices.transfer == UINT32_MAX)
+      indices.transfer = indices.graphics;
+    return indices;
   }
 
   uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
@@ -935,309 +1528,1914 @@ class Gpu {
   }
 };
 
-class PointsPipeline : public Pipeline {};
-
-class LinesPipeline : public Pipeline {};
+// 点云绘制时每个节点推送的常量，与 points.vert 中的 PushConstants 对应
+struct PointConstants {
+  alignas(16) Eigen::Matrix4f view_proj;
+  alignas(16) Eigen::Vector4f node;  // xyz 为节点包围盒最小角，w 为边长
+  float point_size;
+};
 
-class TrianglesPipeline : public Pipeline {
+// 点云管线：顶点为 pointcloud::PackedPoint（量化位置 + RGBA8 颜色），不使用描述符，所有参数通过 push constant 传入
+class PointsPipeline : public Pipeline {
  public:
-  VkPipelineLayout pipeline_layout;
-  VkPipeline pipeline;
+  struct Options {
+    bool depth_write = true;
+    VkCompareOp depth_compare = VK_COMPARE_OP_GREATER_OR_EQUAL;  // 反向 Z
+  };
+
+  PointsPipeline(std::shared_ptr<PipelineRegistry> registry, VkRenderPass render_pass, const RenderPassKey &render_pass_key)
+      : PointsPipeline(registry, render_pass, render_pass_key, Options{}) {}
+
+  PointsPipeline(std::shared_ptr<PipelineRegistry> registry, VkRenderPass render_pass, const RenderPassKey &render_pass_key, const Options &options)
+      : Pipeline(registry) {
+    pipeline_layout = registry_->Layout({}, {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PointConstants)}});
+
+    PipelineDesc desc;
+    desc.vertex_shader = "points.vert.spv";
+    desc.fragment_shader = "points.frag.spv";
+    desc.bindings = {{0, sizeof(pointcloud::PackedPoint), VK_VERTEX_INPUT_RATE_VERTEX}};
+    desc.attributes = {{0, 0, VK_FORMAT_R16G16B16A16_UNORM, static_cast<uint32_t>(offsetof(pointcloud::PackedPoint, x))},
+                       {1, 0, VK_FORMAT_R8G8B8A8_UNORM, static_cast<uint32_t>(offsetof(pointcloud::PackedPoint, color))}};
+    desc.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    desc.cull_mode = VK_CULL_MODE_NONE;
+    desc.depth_write = options.depth_write;
+    desc.depth_compare = options.depth_compare;
+    Request(desc, render_pass, render_pass_key);
+  }
+};
 
-  TrianglesPipeline(VkDevice device, VkRenderPass render_pass, VkDescriptorSetLayout descriptor_set_layout) {
-    auto vertShaderCode = helper::ReadFile("base.vert.spv");
-    auto fragShaderCode = helper::ReadFile("base.frag.spv");
+// 线段绘制的推送常量，与 lines.vert / lines_thick.vert 中的 PushConstants 对应
+struct LineConstants {
+  alignas(16) Eigen::Matrix4f view_proj;
+  alignas(16) Eigen::Vector4f params;  // xy 为视口尺寸，z 为线宽（像素）
+};
 
-    VkShaderModule vertShaderModule = helper::CreateShaderModule(device, vertShaderCode);
-    VkShaderModule fragShaderModule = helper::CreateShaderModule(device, fragShaderCode);
+// 线段管线，顶点为 lines::Vertex。细线用硬件 LINE_LIST；粗线把每条线段作为一个实例，在顶点着色器中扩展成屏幕空间四边形。
+// 两种管线读同一个缓冲，不使用描述符。
+class LinesPipeline : public Pipeline {
+ public:
+  struct Options {
+    bool thick = false;
+    bool depth_test = true;  // 只测试不写深度，线段不遮挡其它物体
+  };
+
+  LinesPipeline(std::shared_ptr<PipelineRegistry> registry, VkRenderPass render_pass, const RenderPassKey &render_pass_key)
+      : LinesPipeline(registry, render_pass, render_pass_key, Options{}) {}
+
+  LinesPipeline(std::shared_ptr<PipelineRegistry> registry, VkRenderPass render_pass, const RenderPassKey &render_pass_key, const Options &options)
+      : Pipeline(registry) {
+    pipeline_layout = registry_->Layout({}, {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(LineConstants)}});
+
+    PipelineDesc desc;
+    desc.vertex_shader = options.thick ? "lines_thick.vert.spv" : "lines.vert.spv";
+    desc.fragment_shader = "lines.frag.spv";
+    if (options.thick) {
+      uint32_t b = static_cast<uint32_t>(offsetof(lines::Segment, b));
+      uint32_t color = static_cast<uint32_t>(offsetof(lines::Vertex, color));
+      desc.bindings = {{0, sizeof(lines::Segment), VK_VERTEX_INPUT_RATE_INSTANCE}};
+      desc.attributes = {{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0},
+                         {1, 0, VK_FORMAT_R8G8B8A8_UNORM, color},
+                         {2, 0, VK_FORMAT_R32G32B32_SFLOAT, b},
+                         {3, 0, VK_FORMAT_R8G8B8A8_UNORM, b + color}};
+      desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    } else {
+      desc.bindings = {{0, sizeof(lines::Vertex), VK_VERTEX_INPUT_RATE_VERTEX}};
+      desc.attributes = {{0, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(lines::Vertex, x))},
+                         {1, 0, VK_FORMAT_R8G8B8A8_UNORM, static_cast<uint32_t>(offsetof(lines::Vertex, color))}};
+      desc.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    }
+    desc.cull_mode = VK_CULL_MODE_NONE;
+    desc.depth_test = options.depth_test;
+    desc.depth_write = false;
+    desc.blend = BlendMode::kAlpha;  // 颜色带 alpha
+    Request(desc, render_pass, render_pass_key);
+  }
+};
 
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
+// 精灵绘制的推送常量，与 sprites.vert 中的 PushConstants 对应
+struct SpriteConstants {
+  alignas(16) Eigen::Matrix4f transform;  // 精灵坐标到裁剪空间
+};
 
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
+// 精灵管线：每个精灵一个实例（sprites::Instance），在顶点着色器中展开成带旋转的四边形。
+// 描述符集 0 只有一个组合图像采样器，按纹理切换；不测试深度，按 alpha 混合，按提交顺序覆盖。
+class SpritesPipeline : public Pipeline {
+ public:
+  SpritesPipeline(std::shared_ptr<PipelineRegistry> registry, VkRenderPass render_pass, const RenderPassKey &render_pass_key,
+                  VkDescriptorSetLayout descriptor_set_layout)
+      : Pipeline(registry) {
+    pipeline_layout = registry_->Layout({descriptor_set_layout}, {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(SpriteConstants)}});
+
+    PipelineDesc desc;
+    desc.vertex_shader = "sprites.vert.spv";
+    desc.fragment_shader = "sprites.frag.spv";
+    desc.bindings = {{0, sizeof(sprites::Instance), VK_VERTEX_INPUT_RATE_INSTANCE}};
+    desc.attributes = {{0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(sprites::Instance, x))},
+                       {1, 0, VK_FORMAT_R32_SFLOAT, static_cast<uint32_t>(offsetof(sprites::Instance, rotation))},
+                       {2, 0, VK_FORMAT_R8G8B8A8_UNORM, static_cast<uint32_t>(offsetof(sprites::Instance, color))},
+                       {3, 0, VK_FORMAT_R16G16B16A16_UNORM, static_cast<uint32_t>(offsetof(sprites::Instance, uv))}};
+    desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc.cull_mode = VK_CULL_MODE_NONE;
+    desc.depth_test = false;
+    desc.depth_write = false;
+    desc.blend = BlendMode::kAlpha;
+    Request(desc, render_pass, render_pass_key);
+  }
+};
 
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+// 网格着色器的功能位。第 i 位对应网格着色器中 constant_id i 的特化常量，
+// 每种组合是一个独立的管线变体，着色器里的分支在创建管线时被驱动消除
+struct MeshFeatures {
+  enum : uint32_t {
+    kVertexColor = 1u << 0,  // 使用顶点颜色，否则使用统一的颜色
+  };
+  static constexpr uint32_t kCount = 1;
+  static constexpr uint32_t kDefault = kVertexColor;
+
+  static constexpr std::array<uint32_t, kCount> Specialization(uint32_t features) { return FeatureSpecialization<kCount>(features); }
+  static constexpr std::array<uint32_t, (1u << kCount)> Variants() { return FeatureVariants<kCount>(); }
+};
 
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+class TrianglesPipeline : public Pipeline {
+ public:
+  // 深度状态。depth_only 时不带片元着色器、不写颜色，用于深度预通道；此时功能位不影响结果，统一按 0 处理以便去重。
+  struct Options {
+    bool depth_only = false;
+    bool depth_write = true;
+    VkCompareOp depth_compare = VK_COMPARE_OP_GREATER_OR_EQUAL;  // 反向 Z
+    uint32_t features = MeshFeatures::kDefault;
+  };
+
+  TrianglesPipeline(std::shared_ptr<PipelineRegistry> registry, VkRenderPass render_pass, const RenderPassKey &render_pass_key,
+                    VkDescriptorSetLayout descriptor_set_layout)
+      : TrianglesPipeline(registry, render_pass, render_pass_key, descriptor_set_layout, Options{}) {}
+
+  TrianglesPipeline(std::shared_ptr<PipelineRegistry> registry, VkRenderPass render_pass, const RenderPassKey &render_pass_key,
+                    VkDescriptorSetLayout descriptor_set_layout, const Options &options)
+      : Pipeline(registry) {
+    pipeline_layout = registry_->Layout({descriptor_set_layout}, {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants)}});
 
     auto [bindingDescription, attributeDescriptions] = Vertex::GetBindingDescription();
+    PipelineDesc desc;
+    desc.vertex_shader = "base.vert.spv";
+    desc.fragment_shader = options.depth_only ? "" : "base.frag.spv";
+    auto specialization = MeshFeatures::Specialization(options.depth_only ? 0 : options.features);
+    desc.specialization.assign(specialization.begin(), specialization.end());
+    desc.bindings = {bindingDescription};
+    desc.attributes.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+    desc.depth_write = options.depth_write;
+    desc.depth_compare = options.depth_compare;
+    desc.color_write = !options.depth_only;
+    Request(desc, render_pass, render_pass_key);
+  }
+};
 
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-    VkPipelineViewportStateCreateInfo viewportState{};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.scissorCount = 1;
-
-    VkPipelineRasterizationStateCreateInfo rasterizer{};
-    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-
-    VkPipelineMultisampleStateCreateInfo multisampling{};
-    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-
-    VkPipelineColorBlendStateCreateInfo colorBlending{};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-    colorBlending.blendConstants[0] = 0.0f;
-    colorBlending.blendConstants[1] = 0.0f;
-    colorBlending.blendConstants[2] = 0.0f;
-    colorBlending.blendConstants[3] = 0.0f;
-
-    std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-    VkPipelineDynamicStateCreateInfo dynamicState{};
-    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-    dynamicState.pDynamicStates = dynamicStates.data();
-
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptor_set_layout;
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipeline_layout) != VK_SUCCESS) {
-      throw std::runtime_error("failed to create pipeline layout!");
-    }
-
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = &dynamicState;
-    pipelineInfo.layout = pipeline_layout;
-    pipelineInfo.renderPass = render_pass;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
-      throw std::runtime_error("failed to create graphics pipeline!");
-    }
-
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
-  }
-
-  ~TrianglesPipeline() {}
+// 纹理像素数据来源。LoadMip 在后台线程中调用，实现需要线程安全，返回紧密排列的 mip 数据。
+// stored_mip_levels 小于 mip_levels 时，其余 mip 由 GPU 用 blit 生成。
+class TextureSource {
+ public:
+  virtual ~TextureSource() {}
+  virtual VkFormat format() const = 0;
+  virtual uint32_t width() const = 0;
+  virtual uint32_t height() const = 0;
+  virtual uint32_t mip_levels() const = 0;
+  virtual uint32_t stored_mip_levels() const { return mip_levels(); }
+  virtual std::vector<uint8_t> LoadMip(uint32_t level) = 0;
+
+  static uint32_t FullMipCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while ((std::max(width, height) >> levels) > 0)
+      levels++;
+    return levels;
+  }
 };
 
-class SceneRenderer : public Renderer {
-  std::shared_ptr<Gpu> gpu_;
+// 内存中的 RGBA8 图像。默认只提供第 0 级，mip 链在 GPU 上生成；
+// 选择 CPU 生成时，首次加载在后台线程用 box filter 生成完整 mip 链，可以参与流送。
+class ImageTextureSource : public TextureSource {
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t mip_levels_;
+  bool gpu_mips_;
+  std::vector<std::vector<uint8_t>> mips_;
+  std::once_flag mips_generated_;
 
  public:
-  VkDevice device{};
-  uint32_t width{};
-  uint32_t height{};
-  VkFormat image_format{};
-  uint32_t image_count{};
+  ImageTextureSource(uint32_t width, uint32_t height, std::vector<uint8_t> rgba, bool gpu_mips = true)
+      : width_(width), height_(height), gpu_mips_(gpu_mips) {
+    mip_levels_ = FullMipCount(width_, height_);
+    mips_.resize(mip_levels_);
+    mips_[0] = std::move(rgba);
+  }
 
-  VkRenderPass render_pass{};
-  std::vector<VkFramebuffer> framebuffers;
+  VkFormat format() const override { return VK_FORMAT_R8G8B8A8_UNORM; }
+  uint32_t width() const override { return width_; }
+  uint32_t height() const override { return height_; }
+  uint32_t mip_levels() const override { return mip_levels_; }
+  uint32_t stored_mip_levels() const override { return gpu_mips_ ? 1 : mip_levels_; }
+
+  std::vector<uint8_t> LoadMip(uint32_t level) override {
+    if (gpu_mips_)
+      return mips_[0];
+
+    std::call_once(mips_generated_, [this] {
+      for (uint32_t l = 1; l < mip_levels_; ++l) {
+        uint32_t sw = std::max(1u, width_ >> (l - 1)), sh = std::max(1u, height_ >> (l - 1));
+        uint32_t dw = std::max(1u, width_ >> l), dh = std::max(1u, height_ >> l);
+        const auto &src = mips_[l - 1];
+        auto &dst = mips_[l];
+        dst.resize(size_t(dw) * dh * 4);
+        for (uint32_t y = 0; y < dh; ++y) {
+          for (uint32_t x = 0; x < dw; ++x) {
+            uint32_t x0 = std::min(x * 2, sw - 1), x1 = std::min(x * 2 + 1, sw - 1);
+            uint32_t y0 = std::min(y * 2, sh - 1), y1 = std::min(y * 2 + 1, sh - 1);
+            for (uint32_t c = 0; c < 4; ++c) {
+              uint32_t sum = src[(size_t(y0) * sw + x0) * 4 + c] + src[(size_t(y0) * sw + x1) * 4 + c] + src[(size_t(y1) * sw + x0) * 4 + c] +
+                             src[(size_t(y1) * sw + x1) * 4 + c];
+              dst[(size_t(y) * dw + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+          }
+        }
+      }
+    });
+    return mips_[level];
+  }
+};
 
-  // ubo
-  VkDescriptorPool descriptor_pool{};
-  VkDescriptorSetLayout descriptor_set_layout{};
-  std::vector<VkBuffer> uniformBuffers;
-  std::vector<VkDeviceMemory> uniformBuffersMemory;
-  std::vector<void *> uniformBuffersMapped;
-  std::vector<VkDescriptorSet> descriptor_sets;
+// KTX2 纹理：在工作线程中解开超压缩并转码为设备支持的最佳块压缩格式，不支持时回退到 RGBA8。
+// 只有一级的未压缩图像由 GPU 生成 mip 链。
+class Ktx2TextureSource : public TextureSource {
+  std::shared_ptr<const ktx2::File> file_;
+  ktx2::TranscodeTarget target_;
+  std::unique_ptr<ktx2::Transcoder> transcoder_;
+  uint32_t mip_levels_;
 
-  // pipelines
-  std::shared_ptr<TrianglesPipeline> triangles_pipeline;
+ public:
+  Ktx2TextureSource(const std::string &filename, std::shared_ptr<GpuContext> context) {
+    file_ = std::make_shared<const ktx2::File>(ktx2::Load(filename));
+    target_ = ktx2::SelectTarget(context->physical_device, context->enabled_features, *file_);
+    transcoder_ = std::make_unique<ktx2::Transcoder>(file_, target_);
+
+    auto block = helper::GetFormatBlock(target_.format);
+    bool can_blit = block.width == 1 && file_->levels == 1;
+    mip_levels_ = can_blit ? FullMipCount(file_->width, file_->height) : file_->levels;
+  }
 
-  // vertice
-  VkBuffer vertexBuffer{};
-  VkDeviceMemory vertexBufferMemory{};
-  VkBuffer indexBuffer{};
-  VkDeviceMemory indexBufferMemory{};
+  VkFormat format() const override { return target_.format; }
+  uint32_t width() const override { return file_->width; }
+  uint32_t height() const override { return file_->height; }
+  uint32_t mip_levels() const override { return mip_levels_; }
+  uint32_t stored_mip_levels() const override { return file_->levels; }
+  std::vector<uint8_t> LoadMip(uint32_t level) override { return transcoder_->TranscodeLevel(level); }
+};
 
-  SceneRenderer(std::shared_ptr<Gpu> gpu) : gpu_(gpu) {
-    device = gpu_->context()->device;
-    width = gpu_->width();
-    height = gpu_->height();
-    image_format = gpu_->image_format();
-    image_count = gpu_->image_count();
+using TextureHandle = uint32_t;
+constexpr TextureHandle kInvalidTexture = ~0u;
 
-    CreateRenderPass();
-    for (int i = 0; i < image_count; i++)
-      framebuffers.push_back(gpu_->CreateFramebuffer(render_pass, i));
+// 纹理流送：尾部小 mip 常驻，高精度 mip 按屏幕需求在后台线程加载，GPU 端用异步拷贝换入，
+// 在显存预算内按 LRU 淘汰。所有提交都只轮询图形队列的时间线，不会阻塞帧循环。
+//
+// 纹理每次驻留级别变化都会换一张新的 VkImage（只包含驻留的 mip），旧图像中已有的 mip 通过
+// vkCmdCopyImage 在 GPU 上拷贝过去，因此 view 会变化，使用者应在 generation 变化时更新描述符。
+class TextureStreamer {
+ public:
+  struct Options {
+    VkDeviceSize budget_bytes{256ull << 20};  // 流送纹理的显存预算
+    uint32_t resident_tail_size{64};          // 边长不超过该值的 mip 常驻
+    uint32_t max_uploads_in_flight{4};        // 同时进行的上传数，限制每帧的拷贝量
+  };
+
+  TextureStreamer(std::shared_ptr<Gpu> gpu, std::shared_ptr<JobSystem> jobs, Options options) : gpu_(gpu), jobs_(jobs), options_(options) {
+    device_ = gpu_->context()->device;
+    command_pool_ = gpu_->CreateCommandPool();
+    deletion_queue_ = gpu_->deletion_queue();
+    budget_bytes_ = options_.budget_bytes;
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(device_, &samplerInfo, nullptr, &sampler_) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create texture sampler!");
+    }
+    deletion_queue_->Track(sampler_);
+  }
 
-    // Uniform
-    CreateDescriptorPool();
-    CreateDescriptorSetLayout();
-    CreateUniformBuffers();
-    CreateDescriptorSets();
+  ~TextureStreamer() {
+    for (auto &job : jobs_in_flight_)
+      job.future.wait();
+    gpu_->graphics_timeline()->WaitIdle();
+    for (auto &upload : uploads_)
+      FreeUpload(upload);
+    for (auto &texture : textures_)
+      DestroyImage(texture.image, texture.memory, texture.view);
+    deletion_queue_->Destroy(sampler_);
+    vkDestroyCommandPool(device_, command_pool_, nullptr);
+  }
 
-    // Pipelines
-    triangles_pipeline = std::make_shared<TrianglesPipeline>(device, render_pass, descriptor_set_layout);
+  // 注册纹理并开始异步加载常驻的尾部 mip
+  TextureHandle CreateTexture(std::shared_ptr<TextureSource> source) {
+    Texture texture{};
+    texture.source = source;
+    texture.format = source->format();
+    texture.width = source->width();
+    texture.height = source->height();
+    texture.mip_count = source->mip_levels();
+    texture.generated_mip = source->stored_mip_levels();
+    if (texture.generated_mip < texture.mip_count && !SupportsBlit(texture.format))
+      texture.mip_count = texture.generated_mip;  // 无法在 GPU 上生成，只使用已有的 mip
+
+    texture.tail_mip = texture.mip_count - 1;
+    while (texture.tail_mip > 0 && std::max(texture.width >> (texture.tail_mip - 1), texture.height >> (texture.tail_mip - 1)) <= options_.resident_tail_size)
+      texture.tail_mip--;
+    // 需要 GPU 生成 mip 的纹理由第 0 级推导出全部 mip，整体常驻不参与流送
+    if (texture.generated_mip < texture.mip_count)
+      texture.tail_mip = 0;
+    texture.resident_mip = texture.mip_count;
+    texture.requested_mip = texture.tail_mip;
+
+    TextureHandle handle = static_cast<TextureHandle>(textures_.size());
+    textures_.push_back(std::move(texture));
+    lru_.push_front(handle);
+    textures_[handle].lru = lru_.begin();
+    return handle;
+  }
 
-    CreateVertexBuffer();
-    CreateIndexBuffer();
+  // 根据纹理在屏幕上覆盖的像素尺寸计算需要的 mip，同一帧多次调用取最精细的一级
+  void RequestResidency(TextureHandle handle, float screen_pixels) {
+    auto &texture = textures_[handle];
+    float texels = static_cast<float>(std::max(texture.width, texture.height));
+    uint32_t mip = screen_pixels <= 0.0f ? texture.tail_mip : static_cast<uint32_t>(std::max(0.0f, std::floor(std::log2(texels / screen_pixels))));
+    RequestMip(handle, std::min(mip, texture.tail_mip));
   }
 
-  ~SceneRenderer() {}
+  void RequestMip(TextureHandle handle, uint32_t mip) {
+    auto &texture = textures_[handle];
+    if (texture.last_used_frame != frame_) {
+      texture.requested_mip = mip;
+      texture.last_used_frame = frame_;
+      lru_.splice(lru_.begin(), lru_, texture.lru);
+    } else {
+      texture.requested_mip = std::min(texture.requested_mip, mip);
+    }
+  }
 
-  virtual void Render(VkCommandBuffer command_buffer, uint32_t image_index) override {
-    const auto &framebuffer = framebuffers[image_index];
-    const auto &descriptor_set = descriptor_sets[image_index];  // ubo
+  // 每帧调用一次：回收完成的上传，提交已加载的数据，按预算调度新的加载
+  void Update(uint64_t frame) {
+    frame_ = frame;
+    CompleteUploads();
+    UpdateBudget();
+    SubmitLoadedMips();
+    ScheduleLoads();
+  }
 
-    auto color = helper::ColorU32ToF32(0xF3F5FAFF);
-    VkClearValue clearColor{};
+  bool IsReady(TextureHandle handle) const { return textures_[handle].view != VK_NULL_HANDLE; }
+  uint32_t generation(TextureHandle handle) const { return textures_[handle].generation; }
+  uint32_t resident_mip(TextureHandle handle) const { return textures_[handle].resident_mip; }
+  VkSampler sampler() const { return sampler_; }
+  VkDeviceSize allocated_bytes() const { return allocated_bytes_; }
+  VkDeviceSize committed_bytes() const { return committed_bytes_; }
+  VkDeviceSize budget_bytes() const { return budget_bytes_; }
+
+  VkDescriptorImageInfo DescriptorInfo(TextureHandle handle) const {
+    VkDescriptorImageInfo info{};
+    info.sampler = sampler_;
+    info.imageView = textures_[handle].view;
+    info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    return info;
+  }
 
-    UpdateUniformBuffer(image_index);
+ private:
+  struct Texture {
+    std::shared_ptr<TextureSource> source;
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+    uint32_t tail_mip;       // 常驻尾部的第一级
+    uint32_t generated_mip;  // 从这一级开始的 mip 由 GPU blit 生成
+    uint32_t resident_mip;   // 当前驻留的最精细一级，等于 mip_count 表示尚未驻留
+    uint32_t requested_mip;  // 需求的最精细一级
+    bool busy;               // 正在加载或上传
+    uint32_t failures;       // 连续加载失败的次数
+    uint64_t retry_frame;    // 加载失败后，到这一帧才重新调度
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkDeviceSize bytes;
+    VkDeviceSize committed;  // 所有进行中的操作完成后的大小，用于预算
+    uint64_t last_used_frame;
+    uint32_t generation;
+    std::list<TextureHandle>::iterator lru;
+  };
+
+  struct LoadJob {
+    TextureHandle handle;
+    std::future<void> future;
+  };
+
+  struct LoadedMips {
+    TextureHandle handle;
+    uint32_t first_mip;
+    std::vector<std::vector<uint8_t>> mips;
+  };
+
+  struct Upload {
+    TextureHandle handle;
+    uint32_t first_mip;
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkDeviceSize bytes;
+    VkBuffer staging;
+    VkDeviceMemory staging_memory;
+    VkCommandBuffer command_buffer;
+    uint64_t sync_value;  // 图形时间线达到该值时上传完成
+  };
+
+  VkDeviceSize ImageBytes(const Texture &texture, uint32_t first_mip) const {
+    VkDeviceSize bytes = 0;
+    for (uint32_t level = first_mip; level < texture.mip_count; ++level)
+      bytes += helper::MipBytes(texture.format, texture.width, texture.height, level);
+    return bytes;
+  }
 
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = render_pass;
-    renderPassInfo.framebuffer = framebuffer;
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = {width, height};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+  // 实际预算取配置值与设备本地堆软预算余量中较小者：其它模块或其它进程占用显存时流送随之收缩，
+  // 超出后立即降级最久未使用的纹理，而不是等到驱动开始换页
+  void UpdateBudget() {
+    VkDeviceSize available = gpu_->memory_budget()->DeviceLocalAvailable();
+    budget_bytes_ = available == VK_WHOLE_SIZE ? options_.budget_bytes : std::min(options_.budget_bytes, committed_bytes_ + available);
+    if (committed_bytes_ > budget_bytes_)
+      MakeRoom(0, kInvalidTexture);
+  }
 
-    vkCmdBeginRenderPass(command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    {
-      VkViewport viewport{};
-      viewport.x = 0.0f;
-      viewport.y = 0.0f;
-      viewport.width = (float)width;
-      viewport.height = (float)height;
-      viewport.minDepth = 0.0f;
-      viewport.maxDepth = 1.0f;
-      vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+  void CompleteUploads() {
+    for (size_t i = 0; i < uploads_.size();) {
+      auto &upload = uploads_[i];
+      if (!gpu_->graphics_timeline()->IsComplete(upload.sync_value)) {
+        ++i;
+        continue;
+      }
 
-      VkRect2D scissor{};
-      scissor.offset = {0, 0};
-      scissor.extent = {width, height};
-      vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+      auto &texture = textures_[upload.handle];
+      // 旧图像可能还被在途帧引用，交给删除队列在当前帧完成后销毁
+      deletion_queue_->Release(texture.view);
+      deletion_queue_->Release(texture.image);
+      deletion_queue_->Release(texture.memory);
+      allocated_bytes_ -= texture.bytes;
+
+      texture.image = upload.image;
+      texture.memory = upload.memory;
+      texture.view = upload.view;
+      texture.bytes = upload.bytes;
+      texture.resident_mip = upload.first_mip;
+      texture.busy = false;
+      texture.failures = 0;
+      texture.generation++;
+
+      upload.image = VK_NULL_HANDLE;
+      upload.memory = VK_NULL_HANDLE;
+      upload.view = VK_NULL_HANDLE;
+      FreeUpload(upload);
+      uploads_.erase(uploads_.begin() + i);
+    }
+  }
+
+  void SubmitLoadedMips() {
+    // 回收完成的加载任务；LoadMip 抛出的异常在这里取回，撤销那次加载
+    for (size_t i = 0; i < jobs_in_flight_.size();) {
+      auto &job = jobs_in_flight_[i];
+      if (job.future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        ++i;
+        continue;
+      }
+      try {
+        job.future.get();
+      } catch (const std::exception &e) {
+        FailLoad(job.handle, e.what());
+      }
+      jobs_in_flight_.erase(jobs_in_flight_.begin() + i);
+    }
 
-      Draw(command_buffer, triangles_pipeline->pipeline, descriptor_set, vertexBuffer, indexBuffer, 0, indices.size());
+    std::vector<LoadedMips> loaded;
+    {
+      std::lock_guard<std::mutex> lock(loaded_mutex_);
+      loaded.swap(loaded_);
     }
-    vkCmdEndRenderPass(command_buffer);
+    for (auto &mips : loaded)
+      StartUpload(mips.handle, mips.first_mip, mips.mips);
   }
 
- private:
-  void CreateUniformBuffers() {
-    VkDeviceSize bufferSize = sizeof(Uniform);
+  // 加载失败：释放预算和加载名额，保持当前驻留级别，按失败次数指数退避后重试
+  void FailLoad(TextureHandle handle, const char *error) {
+    auto &texture = textures_[handle];
+    std::cerr << "texture streamer: failed to load mips of texture " << handle << ": " << error << "\n";
+    VkDeviceSize resident = ImageBytes(texture, texture.resident_mip);
+    committed_bytes_ -= texture.committed - resident;
+    texture.committed = resident;
+    texture.busy = false;
+    texture.retry_frame = frame_ + (kRetryFrames << std::min(texture.failures, 6u));
+    texture.failures++;
+    loads_in_flight_--;
+  }
 
-    uniformBuffers.resize(image_count);
-    uniformBuffersMemory.resize(image_count);
-    uniformBuffersMapped.resize(image_count);
+  void ScheduleLoads() {
+    std::vector<TextureHandle> candidates;
+    for (TextureHandle handle = 0; handle < textures_.size(); ++handle) {
+      const auto &texture = textures_[handle];
+      if (!texture.busy && texture.requested_mip < texture.resident_mip && frame_ >= texture.retry_frame)
+        candidates.push_back(handle);
+    }
 
-    for (size_t i = 0; i < image_count; i++) {
-      gpu_->CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                         uniformBuffers[i], uniformBuffersMemory[i]);
+    // 尾部 mip 优先，其次是缺失级数最多的纹理
+    std::sort(candidates.begin(), candidates.end(), [this](TextureHandle l, TextureHandle r) {
+      const auto &a = textures_[l];
+      const auto &b = textures_[r];
+      bool a_tail = a.resident_mip == a.mip_count, b_tail = b.resident_mip == b.mip_count;
+      if (a_tail != b_tail)
+        return a_tail;
+      return (a.resident_mip - a.requested_mip) > (b.resident_mip - b.requested_mip);
+    });
+
+    for (TextureHandle handle : candidates) {
+      if (uploads_.size() + loads_in_flight_ >= options_.max_uploads_in_flight)
+        break;
 
-      vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+      auto &texture = textures_[handle];
+      VkDeviceSize target = ImageBytes(texture, texture.requested_mip);
+      VkDeviceSize growth = target - texture.committed;
+      bool is_tail = texture.resident_mip == texture.mip_count;
+      if (!is_tail && !MakeRoom(growth, handle))
+        continue;
+
+      texture.busy = true;
+      committed_bytes_ += growth;
+      texture.committed = target;
+      loads_in_flight_++;
+
+      uint32_t first_mip = texture.requested_mip;
+      uint32_t end_mip = std::min(texture.resident_mip, texture.generated_mip);
+      auto source = texture.source;
+      auto job = jobs_->Submit([this, handle, first_mip, end_mip, source] {
+        LoadedMips result{handle, first_mip, {}};
+        for (uint32_t level = first_mip; level < end_mip; ++level)
+          result.mips.push_back(source->LoadMip(level));
+
+        std::lock_guard<std::mutex> lock(loaded_mutex_);
+        loaded_.push_back(std::move(result));
+      });
+      jobs_in_flight_.push_back({handle, std::move(job)});
     }
   }
 
-  void UpdateUniformBuffer(uint32_t currentImage) {
-    static auto startTime = std::chrono::high_resolution_clock::now();
+  // 按 LRU 从最久未使用的纹理开始降级到常驻尾部，直到预算能容纳 bytes
+  bool MakeRoom(VkDeviceSize bytes, TextureHandle requester) {
+    for (auto it = lru_.rbegin(); committed_bytes_ + bytes > budget_bytes_ && it != lru_.rend(); ++it) {
+      TextureHandle handle = *it;
+      auto &texture = textures_[handle];
+      if (handle == requester || texture.busy || texture.last_used_frame == frame_ || texture.resident_mip >= texture.tail_mip)
+        continue;
+
+      VkDeviceSize target = ImageBytes(texture, texture.tail_mip);
+      committed_bytes_ -= texture.committed - target;
+      texture.committed = target;
+      texture.requested_mip = texture.tail_mip;
+      texture.busy = true;
+      StartUpload(handle, texture.tail_mip, {});
+    }
+    return committed_bytes_ + bytes <= budget_bytes_;
+  }
 
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+  // 创建只包含 [first_mip, mip_count) 的新图像：新加载的 mip 从暂存缓冲拷贝，已驻留的 mip 从旧图像拷贝
+  void StartUpload(TextureHandle handle, uint32_t first_mip, const std::vector<std::vector<uint8_t>> &loaded) {
+    auto &texture = textures_[handle];
+    if (!loaded.empty())
+      loads_in_flight_--;
+
+    Upload upload{};
+    upload.handle = handle;
+    upload.first_mip = first_mip;
+    upload.bytes = ImageBytes(texture, first_mip);
+
+    uint32_t levels = texture.mip_count - first_mip;
+    uint32_t width = std::max(1u, texture.width >> first_mip);
+    uint32_t height = std::max(1u, texture.height >> first_mip);
+    gpu_->CreateImage(width, height, levels, texture.format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, upload.image, upload.memory, MemoryCategory::kTextures);
+    upload.view = gpu_->CreateImageView(upload.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, levels);
+    allocated_bytes_ += upload.bytes;
+
+    VkDeviceSize staging_size = 0;
+    for (const auto &mip : loaded)
+      staging_size += mip.size();
+    if (staging_size > 0) {
+      gpu_->CreateBuffer(staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         upload.staging, upload.staging_memory, MemoryCategory::kStaging);
+      void *data;
+      vkMapMemory(device_, upload.staging_memory, 0, staging_size, 0, &data);
+      size_t offset = 0;
+      for (const auto &mip : loaded) {
+        memcpy(static_cast<uint8_t *>(data) + offset, mip.data(), mip.size());
+        offset += mip.size();
+      }
+      vkUnmapMemory(device_, upload.staging_memory);
+    }
 
-    // 使用 Eigen 创建和操作矩阵
+    upload.command_buffer = gpu_->CreateCommandBuffer(command_pool_);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(upload.command_buffer, &beginInfo);
+
+    const auto &cmd = upload.command_buffer;
+    Barrier(cmd, upload.image, 0, levels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    VkDeviceSize offset = 0;
+    for (uint32_t i = 0; i < loaded.size(); ++i) {
+      uint32_t level = first_mip + i;
+      VkBufferImageCopy region{};
+      region.bufferOffset = offset;
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.mipLevel = i;
+      region.imageSubresource.layerCount = 1;
+      region.imageExtent = {std::max(1u, texture.width >> level), std::max(1u, texture.height >> level), 1};
+      vkCmdCopyBufferToImage(cmd, upload.staging, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+      offset += loaded[i].size();
+    }
+    counters::Add(counters::Counter::kUploadBytes, int64_t(offset));
+
+    // 新图像中缺失的 mip 从上一级 blit 生成
+    uint32_t blit_begin = first_mip + static_cast<uint32_t>(loaded.size());
+    if (texture.image == VK_NULL_HANDLE && blit_begin < texture.mip_count && blit_begin > first_mip)
+      GenerateMips(cmd, upload.image, texture, first_mip, blit_begin);
+
+    // 已驻留的 mip 直接从旧图像拷贝。同一队列上的屏障同样约束之前提交的帧，因此旧图像的读取已完成
+    uint32_t copy_begin = std::max(first_mip + static_cast<uint32_t>(loaded.size()), texture.resident_mip);
+    if (texture.image != VK_NULL_HANDLE && copy_begin < texture.mip_count) {
+      uint32_t old_levels = texture.mip_count - texture.resident_mip;
+      Barrier(cmd, texture.image, 0, old_levels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+              VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+      for (uint32_t level = copy_begin; level < texture.mip_count; ++level) {
+        VkImageCopy region{};
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - texture.resident_mip, 0, 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - first_mip, 0, 1};
+        region.extent = {std::max(1u, texture.width >> level), std::max(1u, texture.height >> level), 1};
+        vkCmdCopyImage(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+      }
+      Barrier(cmd, texture.image, 0, old_levels, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
 
-    Eigen::Vector3f translate = Eigen::Vector3f(0.0f, 0.0f, 0.0f);
-    // Eigen::Vector3f scale = Eigen::Vector3f(1.0f, 1.0f, 1.0f);
-    Eigen::Matrix3f rotation = Eigen::AngleAxisf(time * 90.0f * M_PI / 180.0f, Eigen::Vector3f(0.0f, 0.0f, 1.0f)).toRotationMatrix();
-    Eigen::Isometry3f model = Eigen::Isometry3f::Identity();
-    model.translate(translate);
-    model.rotate(rotation);
+    Barrier(cmd, upload.image, 0, levels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    vkEndCommandBuffer(cmd);
 
-    Eigen::Matrix4f view = helper::LookAt(Eigen::Vector3f(2.0f, 2.0f, 2.0f), Eigen::Vector3f(0.0f, 0.0f, 0.0f), Eigen::Vector3f(0.0f, 0.0f, 1.0f));
-    Eigen::Matrix4f proj = helper::Perspective(45.0f * M_PI / 180.0f, static_cast<float>(width) / height, 0.1f, 10.0f);
-    proj(1, 1) *= -1;
+    Submission submission;
+    submission.command_buffers = {upload.command_buffer};
+    upload.sync_value = gpu_->graphics_timeline()->Submit(submission).value;
 
-    Uniform ubo{};
-    ubo.model = Eigen::Matrix4f::Identity();
-    ubo.view = Eigen::Matrix4f::Identity();
-    ubo.proj = Eigen::Matrix4f::Identity();
+    uploads_.push_back(upload);
+  }
 
-    // 假设 uniformBuffersMapped 是一个指向 UBO 内存的指针数组
-    memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+  bool SupportsBlit(VkFormat format) const {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(gpu_->context()->physical_device, format, &properties);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+  }
+
+  // 逐级 blit 生成 [blit_begin, mip_count)，结束时所有级别仍处于 TRANSFER_DST 布局
+  void GenerateMips(VkCommandBuffer cmd, VkImage image, const Texture &texture, uint32_t first_mip, uint32_t blit_begin) {
+    for (uint32_t level = blit_begin; level < texture.mip_count; ++level) {
+      uint32_t src = level - 1 - first_mip, dst = level - first_mip;
+      Barrier(cmd, image, src, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+      VkImageBlit blit{};
+      blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, src, 0, 1};
+      blit.srcOffsets[1] = {int32_t(std::max(1u, texture.width >> (level - 1))), int32_t(std::max(1u, texture.height >> (level - 1))), 1};
+      blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, dst, 0, 1};
+      blit.dstOffsets[1] = {int32_t(std::max(1u, texture.width >> level)), int32_t(std::max(1u, texture.height >> level)), 1};
+      vkCmdBlitImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+      Barrier(cmd, image, src, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+  }
+
+  static void Barrier(VkCommandBuffer cmd, VkImage image, uint32_t base_mip, uint32_t levels, VkImageLayout old_layout, VkImageLayout new_layout,
+                      VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    helper::ImageBarrier(cmd, image, VK_IMAGE_ASPECT_COLOR_BIT, base_mip, levels, old_layout, new_layout, src_stage, src_access, dst_stage, dst_access);
+  }
+
+  void FreeUpload(Upload &upload) {
+    deletion_queue_->Destroy(upload.staging);
+    deletion_queue_->Destroy(upload.staging_memory);
+    vkFreeCommandBuffers(device_, command_pool_, 1, &upload.command_buffer);
+    DestroyImage(upload.image, upload.memory, upload.view);
+  }
+
+  // 只用于 GPU 确定不再使用的图像：上传完成或失败、以及析构时
+  void DestroyImage(VkImage image, VkDeviceMemory memory, VkImageView view) {
+    deletion_queue_->Destroy(view);
+    deletion_queue_->Destroy(image);
+    deletion_queue_->Destroy(memory);
+  }
+
+  std::shared_ptr<Gpu> gpu_;
+  std::shared_ptr<JobSystem> jobs_;
+  Options options_;
+  VkDevice device_{};
+  VkCommandPool command_pool_{};
+  VkSampler sampler_{};
+  std::shared_ptr<DeletionQueue> deletion_queue_;
+
+  std::vector<Texture> textures_;
+  std::list<TextureHandle> lru_;  // 表头为最近使用
+  std::vector<Upload> uploads_;
+  uint32_t loads_in_flight_{};
+  uint64_t frame_{};
+
+  static constexpr uint64_t kRetryFrames = 60;  // 第一次加载失败后的重试间隔，之后每次翻倍
+
+  std::vector<LoadJob> jobs_in_flight_;
+  std::mutex loaded_mutex_;
+  std::vector<LoadedMips> loaded_;  // 后台线程加载完成的数据
+
+  VkDeviceSize allocated_bytes_{};
+  VkDeviceSize committed_bytes_{};
+  VkDeviceSize budget_bytes_{};  // 本帧实际生效的预算，见 UpdateBudget
+};
+
+// 点云流送：每帧按屏幕空间密度在点数预算内选择八叉树节点，缺失的节点在后台线程从磁盘读取，
+// 经传输队列拷贝到固定大小的 GPU 缓冲池。池中每个槽位放一个节点，满了以后淘汰最久未使用的节点。
+// 每帧绘制的点数和上传量都有上限，与点云总大小无关；尚未驻留的节点由已驻留的祖先节点（更稀疏的点）代替。
+class PointCloudStreamer {
+ public:
+  struct Options {
+    uint64_t point_budget{3000000};   // 每帧最多绘制的点数
+    uint32_t pool_nodes{256};         // GPU 缓冲池的槽位数，应能容纳一帧选中的节点
+    uint32_t max_loads_in_flight{8};  // 同时从磁盘读取的节点数
+    uint32_t max_uploads_in_flight{4};
+    float min_pixel_spacing{1.0f};  // 节点点间距投影小于该像素数时不再细化
+    float point_size{2.0f};         // 超过 1 需要设备支持 largePoints
+  };
+
+  PointCloudStreamer(std::shared_ptr<Gpu> gpu, std::shared_ptr<JobSystem> jobs, std::shared_ptr<pointcloud::Source> source,
+                     std::shared_ptr<PointsPipeline> pipeline, const Options &options)
+      : gpu_(gpu), jobs_(jobs), source_(source), pipeline_(pipeline), options_(options) {
+    device_ = gpu_->context()->device;
+    deletion_queue_ = gpu_->deletion_queue();
+    selector_.point_budget = options_.point_budget;
+    selector_.min_pixel_spacing = options_.min_pixel_spacing;
+
+    const auto &nodes = source_->nodes();
+    node_state_.assign(nodes.size(), NodeState::kNone);
+    node_slot_.assign(nodes.size(), -1);
+    node_failures_.assign(nodes.size(), 0);
+    node_retry_frame_.assign(nodes.size(), 0);
+    slots_.resize(options_.pool_nodes);
+
+    slot_bytes_ = VkDeviceSize(source_->max_points_per_node()) * sizeof(pointcloud::PackedPoint);
+    gpu_->CreateBuffer(slot_bytes_ * options_.pool_nodes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pool_buffer_, pool_memory_, MemoryCategory::kGeometry);
+
+    // 暂存缓冲常驻映射，每个进行中的上传占一段
+    gpu_->CreateBuffer(slot_bytes_ * options_.max_uploads_in_flight, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer_, staging_memory_,
+                       MemoryCategory::kStaging);
+    vkMapMemory(device_, staging_memory_, 0, VK_WHOLE_SIZE, 0, &staging_mapped_);
+    for (uint32_t i = 0; i < options_.max_uploads_in_flight; ++i)
+      free_staging_.push_back(i);
+  }
+
+  // 缓冲可能仍被在途的帧使用，交给删除队列
+  ~PointCloudStreamer() {
+    for (auto &job : jobs_in_flight_)
+      job.future.wait();
+    deletion_queue_->Release(pool_buffer_);
+    deletion_queue_->Release(pool_memory_);
+    deletion_queue_->Release(staging_buffer_);
+    deletion_queue_->Release(staging_memory_);
+  }
+
+  VkBuffer pool_buffer() const { return pool_buffer_; }
+  uint64_t selected_points() const { return selected_points_; }
+  uint64_t drawn_points() const { return drawn_points_; }
+  size_t resident_nodes() const { return resident_count_; }
+
+  // 每帧调用一次：回收完成的上传，选择节点，提交已读取的数据，按优先级调度新的读取
+  void Update(uint64_t frame, const Eigen::Matrix4f &view, const Eigen::Matrix4f &proj, uint32_t viewport_height) {
+    E3D_TRACE_SCOPE("PointCloudStreamer::Update");
+    frame_ = frame;
+    CompleteUploads();
+
+    selector_.SetCamera(view, proj, viewport_height);
+    selected_ = selector_.Select(source_->nodes(), &selected_points_);
+    for (uint32_t node : selected_)
+      if (node_slot_[node] >= 0)
+        slots_[node_slot_[node]].last_used_frame = frame_;
+
+    SubmitLoadedNodes();
+    ScheduleLoads();
+  }
+
+  // 在场景通道内绘制本帧选中且已驻留的节点，整个池只绑定一次
+  void Draw(VkCommandBuffer command_buffer, const Eigen::Matrix4f &view_proj) {
+    VkPipeline pipeline = pipeline_->pipeline();
+    drawn_points_ = 0;
+    if (!pipeline)
+      return;  // 管线仍在编译
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    counters::Add(counters::Counter::kPipelineBinds);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &pool_buffer_, &offset);
+
+    PointConstants constants{};
+    constants.view_proj = view_proj;
+    constants.point_size = options_.point_size;
+    uint32_t slot_points = source_->max_points_per_node();
+    const auto &nodes = source_->nodes();
+    for (uint32_t index : selected_) {
+      if (node_state_[index] != NodeState::kResident)
+        continue;
+      const auto &node = nodes[index];
+      constants.node = Eigen::Vector4f(node.min[0], node.min[1], node.min[2], node.size);
+      vkCmdPushConstants(command_buffer, pipeline_->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+      vkCmdDraw(command_buffer, node.point_count, 1, uint32_t(node_slot_[index]) * slot_points, 0);
+      counters::Add(counters::Counter::kDrawCalls);
+      drawn_points_ += node.point_count;
+    }
+  }
+
+ private:
+  enum class NodeState : uint8_t { kNone, kLoading, kUploading, kResident };
+
+  struct Slot {
+    int32_t node{-1};
+    uint64_t last_used_frame{};
+  };
+
+  struct LoadJob {
+    uint32_t node;
+    std::future<void> future;
+  };
+
+  struct LoadedNode {
+    uint32_t node;
+    std::vector<pointcloud::PackedPoint> points;
+  };
+
+  struct Upload {
+    uint32_t node;
+    uint32_t staging;
+    SyncPoint sync;
+  };
+
+  void CompleteUploads() {
+    for (size_t i = 0; i < uploads_.size();) {
+      auto &upload = uploads_[i];
+      if (!upload.sync.timeline->IsComplete(upload.sync.value)) {
+        ++i;
+        continue;
+      }
+      node_state_[upload.node] = NodeState::kResident;
+      node_failures_[upload.node] = 0;
+      resident_count_++;
+      free_staging_.push_back(upload.staging);
+      uploads_.erase(uploads_.begin() + i);
+    }
+  }
+
+  void SubmitLoadedNodes() {
+    // 回收完成的读取任务；LoadNode 抛出异常时节点回到未加载状态，指数退避后重新读取
+    for (size_t i = 0; i < jobs_in_flight_.size();) {
+      auto &job = jobs_in_flight_[i];
+      if (job.future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        ++i;
+        continue;
+      }
+      try {
+        job.future.get();
+      } catch (const std::exception &e) {
+        std::cerr << "point cloud: failed to load node " << job.node << ": " << e.what() << "\n";
+        node_state_[job.node] = NodeState::kNone;
+        node_retry_frame_[job.node] = frame_ + (kRetryFrames << std::min<uint32_t>(node_failures_[job.node], 6));
+        node_failures_[job.node] = uint8_t(std::min<uint32_t>(node_failures_[job.node] + 1u, 255u));
+      }
+      jobs_in_flight_.erase(jobs_in_flight_.begin() + i);
+    }
+    {
+      std::lock_guard<std::mutex> lock(loaded_mutex_);
+      for (auto &loaded : loaded_)
+        waiting_upload_.push_back(std::move(loaded));
+      loaded_.clear();
+    }
+
+    while (!waiting_upload_.empty() && !free_staging_.empty()) {
+      LoadedNode loaded = std::move(waiting_upload_.front());
+      waiting_upload_.pop_front();
+      int32_t slot = AllocateSlot();
+      if (slot < 0) {
+        node_state_[loaded.node] = NodeState::kNone;  // 池已被本帧的节点占满，丢弃，之后重新读取
+        continue;
+      }
+      StartUpload(loaded, slot);
+    }
+  }
+
+  void ScheduleLoads() {
+    for (uint32_t index : selected_) {
+      if (jobs_in_flight_.size() + waiting_upload_.size() >= options_.max_loads_in_flight)
+        break;
+      if (node_state_[index] != NodeState::kNone || frame_ < node_retry_frame_[index])
+        continue;
+
+      node_state_[index] = NodeState::kLoading;
+      auto source = source_;
+      auto job = jobs_->Submit([this, index, source] {
+        LoadedNode loaded{index, source->LoadNode(index)};
+        std::lock_guard<std::mutex> lock(loaded_mutex_);
+        loaded_.push_back(std::move(loaded));
+      });
+      jobs_in_flight_.push_back({index, std::move(job)});
+    }
+  }
+
+  // 空槽位优先，否则淘汰本帧没有使用的、最久未使用的节点
+  int32_t AllocateSlot() {
+    int32_t best = -1;
+    for (int32_t i = 0; i < int32_t(slots_.size()); ++i) {
+      const auto &slot = slots_[i];
+      if (slot.node < 0)
+        return i;
+      if (slot.last_used_frame == frame_ || node_state_[slot.node] != NodeState::kResident)
+        continue;
+      if (best < 0 || slot.last_used_frame < slots_[best].last_used_frame)
+        best = i;
+    }
+    if (best >= 0) {
+      int32_t evicted = slots_[best].node;
+      node_state_[evicted] = NodeState::kNone;
+      node_slot_[evicted] = -1;
+      resident_count_--;
+    }
+    return best;
+  }
+
+  // 在传输队列上把暂存数据拷贝进槽位。槽位的旧节点可能仍被在途帧读取，先等待最近提交的图形帧；
+  // 拷贝完成后由引擎把所有权转移回图形队列，下一帧在顶点输入阶段等待。
+  void StartUpload(const LoadedNode &loaded, int32_t slot) {
+    uint32_t staging = free_staging_.back();
+    free_staging_.pop_back();
+
+    VkDeviceSize bytes = loaded.points.size() * sizeof(pointcloud::PackedPoint);
+    VkDeviceSize src_offset = VkDeviceSize(staging) * slot_bytes_;
+    VkDeviceSize dst_offset = VkDeviceSize(slot) * slot_bytes_;
+    memcpy(static_cast<uint8_t *>(staging_mapped_) + src_offset, loaded.points.data(), size_t(bytes));
+
+    slots_[slot] = {int32_t(loaded.node), frame_};
+    node_slot_[loaded.node] = slot;
+    node_state_[loaded.node] = NodeState::kUploading;
+
+    Gpu::AsyncSubmission submission;
+    submission.record = [this, bytes, src_offset, dst_offset](VkCommandBuffer cmd) {
+      VkBufferCopy region{src_offset, dst_offset, bytes};
+      vkCmdCopyBuffer(cmd, staging_buffer_, pool_buffer_, 1, &region);
+    };
+    submission.waits = {{gpu_->frame_sync(), VK_PIPELINE_STAGE_TRANSFER_BIT}};
+    submission.handoff.dst_stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    submission.handoff.buffers = {{pool_buffer_, dst_offset, std::max<VkDeviceSize>(bytes, 1), VK_ACCESS_TRANSFER_WRITE_BIT,
+                                   VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT}};
+    counters::Add(counters::Counter::kUploadBytes, int64_t(bytes));
+
+    uploads_.push_back({loaded.node, staging, gpu_->SubmitTransfer(std::move(submission))});
+  }
+
+  std::shared_ptr<Gpu> gpu_;
+  std::shared_ptr<JobSystem> jobs_;
+  std::shared_ptr<pointcloud::Source> source_;
+  std::shared_ptr<PointsPipeline> pipeline_;
+  Options options_;
+  VkDevice device_{};
+  std::shared_ptr<DeletionQueue> deletion_queue_;
+  pointcloud::Selector selector_;
+
+  VkDeviceSize slot_bytes_{};
+  VkBuffer pool_buffer_{};
+  VkDeviceMemory pool_memory_{};
+  VkBuffer staging_buffer_{};
+  VkDeviceMemory staging_memory_{};
+  void *staging_mapped_{};
+  std::vector<uint32_t> free_staging_;
+
+  std::vector<NodeState> node_state_;
+  std::vector<int32_t> node_slot_;
+  std::vector<uint8_t> node_failures_;      // 连续读取失败的次数
+  std::vector<uint64_t> node_retry_frame_;  // 读取失败后，到这一帧才重新调度
+  std::vector<Slot> slots_;
+  size_t resident_count_{};
+  std::vector<Upload> uploads_;
+  uint64_t frame_{};
+
+  std::vector<uint32_t> selected_;  // 本帧选中的节点，粗的在前
+  uint64_t selected_points_{};
+  uint64_t drawn_points_{};
+
+  static constexpr uint64_t kRetryFrames = 60;  // 第一次读取失败后的重试间隔，之后每次翻倍
+
+  std::vector<LoadJob> jobs_in_flight_;
+  std::deque<LoadedNode> waiting_upload_;  // 已读取、等待暂存空间的节点
+  std::mutex loaded_mutex_;
+  std::vector<LoadedNode> loaded_;
+};
+
+// 立即模式线段绘制。调用方每帧通过 lines() 添加线段（Line/Polyline/Box/Frustum），直接写入常驻映射的顶点环形缓冲；
+// 环形缓冲分为若干段，每帧写一段，GPU 仍在读取的段不会被覆盖。每帧按线宽分批，同一线宽的线段只需一次绘制。
+// 本帧写不下的线段被丢弃，下一帧起容量翻倍。
+class LineBatcher {
+ public:
+  struct Options {
+    uint32_t max_segments{1u << 20};  // 每帧初始容量，不够时自动增长
+    uint32_t regions{3};              // 环形缓冲的段数，应不少于在途帧数加一
+  };
+
+  LineBatcher(std::shared_ptr<Gpu> gpu, std::shared_ptr<PipelineRegistry> pipelines, VkRenderPass render_pass, const RenderPassKey &render_pass_key)
+      : LineBatcher(gpu, pipelines, render_pass, render_pass_key, Options{}) {}
+  LineBatcher(std::shared_ptr<Gpu> gpu, std::shared_ptr<PipelineRegistry> pipelines, VkRenderPass render_pass, const RenderPassKey &render_pass_key,
+              const Options &options)
+      : gpu_(gpu), options_(options) {
+    device_ = gpu_->context()->device;
+    deletion_queue_ = gpu_->deletion_queue();
+    thin_pipeline_ = std::make_shared<LinesPipeline>(pipelines, render_pass, render_pass_key);
+    thick_pipeline_ = std::make_shared<LinesPipeline>(pipelines, render_pass, render_pass_key, LinesPipeline::Options{true});
+    CreateRing(options_.max_segments);
+  }
+
+  ~LineBatcher() { ReleaseRing(); }
+
+  // 当前帧的线段列表，在下一次 Flush 之前有效
+  lines::LineList &lines() { return lines_; }
+
+  VkBuffer buffer() const { return buffer_; }
+  VkBuffer draw_buffer() const { return draw_from_old_ ? old_buffer_ : buffer_; }  // 最近一次 Flush 的线段所在的缓冲
+  uint32_t drawn_segments() const { return drawn_segments_; }
+  uint64_t dropped_segments() const { return dropped_segments_; }
+
+  // 结束本帧的写入：记录要绘制的批次，之后的写入进入下一段。每帧在声明渲染通道时调用一次
+  void Flush() {
+    E3D_TRACE_SCOPE("LineBatcher::Flush");
+    draw_batches_ = lines_.Finish();
+    draw_base_ = region_ * capacity_;
+    drawn_segments_ = lines_.size();
+    dropped_segments_ = lines_.dropped();
+
+    // 上一次 Flush 的段已随上一帧提交，现在才知道它的时间线值
+    if (last_region_ >= 0)
+      region_sync_[last_region_] = gpu_->frame_sync();
+    last_region_ = int32_t(region_);
+
+    if (dropped_segments_ > 0) {
+      // 本帧要绘制的段仍在旧缓冲中，旧缓冲交给删除队列，在读完之后销毁
+      uint64_t needed = uint64_t(lines_.size()) + dropped_segments_;
+      uint64_t capacity = capacity_;
+      while (capacity < needed)
+        capacity *= 2;
+      ReleaseRing();
+      CreateRing(uint32_t(std::min<uint64_t>(capacity, UINT32_MAX / options_.regions)));
+      region_sync_[region_] = {};
+      last_region_ = -1;
+      draw_from_old_ = true;
+      return;
+    }
+    draw_from_old_ = false;
+    BeginRegion((region_ + 1) % options_.regions);
+  }
+
+  // 绘制最近一次 Flush 的线段，在场景通道中调用
+  void Draw(VkCommandBuffer command_buffer, const Eigen::Matrix4f &view_proj, uint32_t viewport_width, uint32_t viewport_height) {
+    if (draw_batches_.empty())
+      return;
+    VkBuffer buffer = draw_buffer();
+    VkDeviceSize offset = 0;
+
+    LineConstants constants{};
+    constants.view_proj = view_proj;
+    VkPipeline bound{};
+    for (const auto &batch : draw_batches_) {
+      bool thick = batch.width > 1.0f;
+      const auto &pipeline = thick ? thick_pipeline_ : thin_pipeline_;
+      VkPipeline handle = pipeline->pipeline();
+      if (!handle)
+        continue;  // 管线仍在编译，跳过这一批
+      if (bound != handle) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, handle);
+        counters::Add(counters::Counter::kPipelineBinds);
+        vkCmdBindVertexBuffers(command_buffer, 0, 1, &buffer, &offset);
+        bound = handle;
+      }
+      constants.params = Eigen::Vector4f(float(viewport_width), float(viewport_height), batch.width, 0.0f);
+      vkCmdPushConstants(command_buffer, pipeline->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+      uint32_t first = draw_base_ + batch.first;
+      if (thick)
+        vkCmdDraw(command_buffer, 6, batch.count, 0, first);
+      else
+        vkCmdDraw(command_buffer, batch.count * 2, 1, first * 2, 0);
+      counters::Add(counters::Counter::kDrawCalls);
+    }
+  }
+
+ private:
+  void CreateRing(uint32_t capacity) {
+    capacity_ = capacity;
+    VkDeviceSize size = VkDeviceSize(capacity_) * options_.regions * sizeof(lines::Segment);
+    gpu_->CreateBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer_, memory_,
+                       MemoryCategory::kGeometry);
+    vkMapMemory(device_, memory_, 0, VK_WHOLE_SIZE, 0, &mapped_);
+    region_sync_.assign(options_.regions, SyncPoint{});
+    BeginRegion(0);
+  }
+
+  // 释放内存时隐式解除映射；最近一次 Flush 的批次仍可从 old_buffer_ 绘制
+  void ReleaseRing() {
+    if (!buffer_)
+      return;
+    old_buffer_ = buffer_;
+    deletion_queue_->Release(buffer_);
+    deletion_queue_->Release(memory_);
+    buffer_ = VK_NULL_HANDLE;
+    memory_ = VK_NULL_HANDLE;
+    mapped_ = nullptr;
+  }
+
+  // 等待该段上一次被读取的帧完成（通常早已完成），然后把写入指向它
+  void BeginRegion(uint32_t region) {
+    region_ = region;
+    const auto &sync = region_sync_[region_];
+    if (sync.timeline)
+      sync.timeline->Wait(sync.value);
+    auto *segments = static_cast<lines::Segment *>(mapped_) + size_t(region_) * capacity_;
+    lines_.Reset(segments, capacity_);  // 线宽保持不变
+  }
+
+  std::shared_ptr<Gpu> gpu_;
+  Options options_;
+  VkDevice device_{};
+  std::shared_ptr<DeletionQueue> deletion_queue_;
+  std::shared_ptr<LinesPipeline> thin_pipeline_;
+  std::shared_ptr<LinesPipeline> thick_pipeline_;
+
+  uint32_t capacity_{};  // 每段的线段数
+  VkBuffer buffer_{};
+  VkDeviceMemory memory_{};
+  void *mapped_{};
+  VkBuffer old_buffer_{};  // 增长前的缓冲，只在增长当帧用于绘制
+  bool draw_from_old_{};
+
+  uint32_t region_{};
+  int32_t last_region_{-1};
+  std::vector<SyncPoint> region_sync_;  // 每段最后一次被读取的图形帧
+  lines::LineList lines_;
+
+  std::vector<lines::Batch> draw_batches_;
+  uint32_t draw_base_{};
+  uint32_t drawn_segments_{};
+  uint64_t dropped_segments_{};
+};
+
+// 2D 精灵批量绘制。调用方每帧向 sprites() 添加精灵，Flush 时按 (层, 纹理) 排序并一次性写入常驻映射的实例环形缓冲，
+// 每种 (层, 纹理) 组合一次实例化绘制。环形缓冲的分段方式与 LineBatcher 相同；精灵数超过容量时在写入前扩容，不丢弃。
+// 纹理句柄来自 SceneRenderer 的 TextureStreamer，尚未就绪的纹理本帧跳过；kNoTexture 使用 1x1 的白色纹理。
+class SpriteBatcher {
+ public:
+  struct Options {
+    uint32_t max_sprites{1u << 16};  // 每帧初始容量，不够时自动增长
+    uint32_t regions{3};             // 环形缓冲的段数，应不少于在途帧数加一
+  };
+
+  SpriteBatcher(std::shared_ptr<Gpu> gpu, std::shared_ptr<PipelineRegistry> pipelines, VkRenderPass render_pass, const RenderPassKey &render_pass_key,
+                std::shared_ptr<TextureStreamer> textures, std::shared_ptr<DescriptorLayoutCache> descriptor_layouts)
+      : SpriteBatcher(gpu, pipelines, render_pass, render_pass_key, textures, descriptor_layouts, Options{}) {}
+  SpriteBatcher(std::shared_ptr<Gpu> gpu, std::shared_ptr<PipelineRegistry> pipelines, VkRenderPass render_pass, const RenderPassKey &render_pass_key,
+                std::shared_ptr<TextureStreamer> textures, std::shared_ptr<DescriptorLayoutCache> descriptor_layouts, const Options &options)
+      : gpu_(gpu), textures_(textures), options_(options) {
+    device_ = gpu_->context()->device;
+    deletion_queue_ = gpu_->deletion_queue();
+
+    VkDescriptorSetLayoutBinding samplerBinding{};
+    samplerBinding.binding = 0;
+    samplerBinding.descriptorCount = 1;
+    samplerBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    descriptor_set_layout_ = descriptor_layouts->Get({samplerBinding});
+    pipeline_ = std::make_shared<SpritesPipeline>(pipelines, render_pass, render_pass_key, descriptor_set_layout_);
+
+    white_ = textures_->CreateTexture(std::make_shared<ImageTextureSource>(1, 1, std::vector<uint8_t>{255, 255, 255, 255}, false));
+    CreateRing(std::max(options_.max_sprites, 1u));
+  }
+
+  ~SpriteBatcher() { ReleaseRing(); }
+
+  // 当前帧的精灵列表，在下一次 Flush 之前有效
+  sprites::SpriteList &sprites() { return sprites_; }
+
+  VkBuffer buffer() const { return buffer_; }
+  uint32_t drawn_sprites() const { return drawn_sprites_; }
+  uint32_t batch_count() const { return uint32_t(draw_batches_.size()); }
+
+  // 结束本帧的写入：排序并写入环形缓冲的下一段，然后清空列表。每帧在声明渲染通道时调用一次
+  void Flush() {
+    E3D_TRACE_SCOPE("SpriteBatcher::Flush");
+    // 上一次 Flush 的段已随上一帧提交，现在才知道它的时间线值
+    if (last_region_ >= 0)
+      region_sync_[last_region_] = gpu_->frame_sync();
+    uint32_t region = last_region_ < 0 ? 0 : (uint32_t(last_region_) + 1) % options_.regions;
+
+    if (sprites_.size() > capacity_) {
+      // 旧缓冲可能仍被在途帧读取，交给删除队列
+      uint64_t capacity = capacity_;
+      while (capacity < sprites_.size())
+        capacity *= 2;
+      ReleaseRing();
+      CreateRing(uint32_t(std::min<uint64_t>(capacity, UINT32_MAX / options_.regions)));
+      region = 0;
+    }
+
+    // 等待该段上一次被读取的帧完成（通常早已完成）
+    const auto &sync = region_sync_[region];
+    if (sync.timeline)
+      sync.timeline->Wait(sync.value);
+    auto *instances = static_cast<sprites::Instance *>(mapped_) + size_t(region) * capacity_;
+    draw_batches_ = sprites_.Build(instances, capacity_);
+    // 按纹理在屏幕上的尺寸请求流送的 mip
+    for (const auto &batch : draw_batches_)
+      if (batch.texture != sprites::kNoTexture)
+        textures_->RequestResidency(batch.texture, batch.footprint);
+    draw_base_ = region * capacity_;
+    drawn_sprites_ = uint32_t(sprites_.size() - sprites_.dropped());
+    sprites_.Clear();
+    last_region_ = int32_t(region);
+  }
+
+  // 绘制最近一次 Flush 的精灵，在场景通道中调用。descriptors 为本帧的瞬态描述符分配器
+  void Draw(VkCommandBuffer command_buffer, const Eigen::Matrix4f &transform, FrameDescriptorAllocator &descriptors) {
+    VkPipeline handle = pipeline_->pipeline();
+    if (draw_batches_.empty() || !handle)
+      return;  // 管线仍在编译时整帧跳过
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, handle);
+    counters::Add(counters::Counter::kPipelineBinds);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &buffer_, &offset);
+    SpriteConstants constants{};
+    constants.transform = transform;
+    vkCmdPushConstants(command_buffer, pipeline_->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+
+    // 同一纹理可能出现在多个层中，每帧每种纹理只写一个描述符集
+    frame_sets_.clear();
+    uint32_t bound = kInvalidTexture;
+    for (const auto &batch : draw_batches_) {
+      TextureHandle texture = batch.texture == sprites::kNoTexture ? white_ : batch.texture;
+      if (!textures_->IsReady(texture))
+        continue;
+      if (texture != bound) {
+        auto [it, inserted] = frame_sets_.try_emplace(texture, VK_NULL_HANDLE);
+        if (inserted)
+          it->second = WriteDescriptorSet(descriptors, texture);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_->pipeline_layout, 0, 1, &it->second, 0, nullptr);
+        bound = texture;
+      }
+      vkCmdDraw(command_buffer, 6, batch.count, 0, draw_base_ + batch.first);
+      counters::Add(counters::Counter::kDrawCalls);
+    }
+  }
+
+ private:
+  VkDescriptorSet WriteDescriptorSet(FrameDescriptorAllocator &descriptors, TextureHandle texture) {
+    VkDescriptorSet set = descriptors.Allocate(descriptor_set_layout_);
+    VkDescriptorImageInfo imageInfo = textures_->DescriptorInfo(texture);
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = set;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(device_, 1, &descriptorWrite, 0, nullptr);
+    return set;
+  }
+
+  void CreateRing(uint32_t capacity) {
+    capacity_ = capacity;
+    VkDeviceSize size = VkDeviceSize(capacity_) * options_.regions * sizeof(sprites::Instance);
+    gpu_->CreateBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer_, memory_,
+                       MemoryCategory::kGeometry);
+    vkMapMemory(device_, memory_, 0, VK_WHOLE_SIZE, 0, &mapped_);
+    region_sync_.assign(options_.regions, SyncPoint{});
+    last_region_ = -1;
+  }
+
+  // 释放内存时隐式解除映射
+  void ReleaseRing() {
+    if (!buffer_)
+      return;
+    deletion_queue_->Release(buffer_);
+    deletion_queue_->Release(memory_);
+    buffer_ = VK_NULL_HANDLE;
+    memory_ = VK_NULL_HANDLE;
+    mapped_ = nullptr;
+  }
+
+  std::shared_ptr<Gpu> gpu_;
+  std::shared_ptr<TextureStreamer> textures_;
+  Options options_;
+  VkDevice device_{};
+  std::shared_ptr<DeletionQueue> deletion_queue_;
+  VkDescriptorSetLayout descriptor_set_layout_{};
+  std::shared_ptr<SpritesPipeline> pipeline_;
+  TextureHandle white_{kInvalidTexture};
+
+  uint32_t capacity_{};  // 每段的精灵数
+  VkBuffer buffer_{};
+  VkDeviceMemory memory_{};
+  void *mapped_{};
+  int32_t last_region_{-1};
+  std::vector<SyncPoint> region_sync_;  // 每段最后一次被读取的图形帧
+  sprites::SpriteList sprites_;
+
+  std::vector<sprites::Batch> draw_batches_;
+  uint32_t draw_base_{};
+  uint32_t drawn_sprites_{};
+  std::unordered_map<TextureHandle, VkDescriptorSet> frame_sets_;
+};
+
+class SceneRenderer : public Renderer {
+  std::shared_ptr<Gpu> gpu_;
+  std::shared_ptr<JobSystem> jobs_;
+  uint64_t frame_number_{};
+  std::vector<bool> statistics_mode_;  // 每个查询录制时是否开启了深度预通道
+
+ public:
+  VkDevice device{};
+  uint32_t width{};
+  uint32_t height{};
+  VkFormat image_format{};
+  uint32_t image_count{};
+
+  VkRenderPass render_pass{};
+  VkFramebuffer framebuffer{};
+  uint64_t framebuffer_generation{};  // 帧缓冲对应的渲染图编译版本
+
+  // dynamic resolution：场景先画到中间颜色目标，再 blit 放大到交换链图像。
+  // 目标按最大缩放在渲染图中声明，缩放变化只改变视口/裁剪矩形，不会改变拓扑或重新分配。
+  DynamicResolution dynamic_resolution;
+  bool dynamic_resolution_enabled = true;
+  uint32_t target_width{};  // 中间目标的分配尺寸
+  uint32_t target_height{};
+  uint32_t render_width{};  // 当前帧实际渲染的尺寸
+  uint32_t render_height{};
+
+  // gpu timestamps：每个交换链图像两条，记录场景开始和放大结束
+  VkQueryPool timestamp_query_pool{};
+  std::vector<bool> timestamps_pending;
+  float gpu_frame_ms{};
+
+  // 渲染图中的临时目标；深度为反向 Z 浮点深度，清除为 0
+  static constexpr VkFormat depth_format = VK_FORMAT_D32_SFLOAT;
+  RenderGraph *graph{};
+  RenderGraph::Resource scene_color{RenderGraph::kInvalid};
+  RenderGraph::Resource scene_depth{RenderGraph::kInvalid};
+
+  // ubo
+  std::shared_ptr<DescriptorLayoutCache> descriptor_layouts;
+  std::shared_ptr<DescriptorAllocator> descriptor_allocator;             // 长期存在的描述符集
+  std::shared_ptr<FrameDescriptorAllocator> frame_descriptor_allocator;  // 每帧重置的瞬态描述符集
+  VkDescriptorSetLayout descriptor_set_layout{};
+  std::vector<VkBuffer> uniformBuffers;
+  std::vector<VkDeviceMemory> uniformBuffersMemory;
+  std::vector<void *> uniformBuffersMapped;
+  std::vector<VkDescriptorSet> descriptor_sets;
+
+  // pipelines：注册表在工作线程上编译，depth_prepass 的两个管线就绪之前用 triangles_pipeline 绘制
+  std::shared_ptr<PipelineRegistry> pipelines;
+  RenderPassKey render_pass_key;
+  std::shared_ptr<TrianglesPipeline> triangles_pipeline;
+  std::shared_ptr<TrianglesPipeline> depth_prepass_pipeline;  // 只写深度
+  std::shared_ptr<TrianglesPipeline> depth_equal_pipeline;    // 预通道之后的着色，EQUAL 测试且不写深度
+  bool depth_prepass = true;
+  bool prepass_active = false;  // 本帧实际是否走了预通道（管线编译完成之前不会）
+
+  // pipeline statistics：统计整个场景通道的顶点/片元着色器调用次数，用来衡量深度预通道的效果
+  struct PipelineStatistics {
+    uint64_t vertex_invocations{};
+    uint64_t fragment_invocations{};
+    uint64_t frame{};
+  };
+  VkQueryPool statistics_query_pool{};
+  std::vector<bool> statistics_pending;
+  PipelineStatistics statistics[2];  // 按 depth_prepass 关/开分别记录最近一次结果
+
+  // textures
+  std::shared_ptr<TextureStreamer> textures;
+
+  // point cloud：可选，SetPointCloud 之后才创建管线和缓冲池
+  std::shared_ptr<PointsPipeline> points_pipeline;
+  std::shared_ptr<PointCloudStreamer> point_cloud;
+
+  // debug lines：第一次调用 Lines() 时创建
+  std::shared_ptr<LineBatcher> line_batcher;
+
+  // 2D sprites：第一次调用 Sprites() 时创建，画在场景最上层
+  std::shared_ptr<SpriteBatcher> sprite_batcher;
+
+  // camera & lod；相机由 Engine 的回放时间线驱动
+  CameraPose camera;
+  Eigen::Matrix4f camera_view{Eigen::Matrix4f::Identity()};
+  Eigen::Matrix4f camera_proj{Eigen::Matrix4f::Identity()};
+  meshopt::LodSelector lod_selector;
+  std::vector<meshopt::LodSelector::Object> lod_objects;
+  std::vector<DrawConstants> object_constants;  // 与 lod_objects 一一对应
+
+  // occlusion culling：可选，EnableOcclusionCulling 之后在 LOD 选择之后、录制绘制之前剔除屏幕外和被遮挡的对象
+  std::shared_ptr<occlusion::OcclusionCuller> occlusion_culler;
+  std::vector<Eigen::Matrix4f> occluder_models;  // 作为遮挡物光栅化的网格实例
+  std::vector<occlusion::Box> occlusion_boxes;
+  std::vector<occlusion::Result> occlusion_results;
+  std::vector<size_t> occlusion_objects;  // occlusion_boxes 对应的 lod_objects 序号
+
+  // picking：实例包围球的 BVH，实例增删后在下一次 Pick 时重建
+  bvh::Bvh pick_bvh;
+  bool pick_bvh_dirty = true;
+  int selected_instance = -1;  // 用线框盒标出，-1 表示没有选中
+
+  // vertice
+  std::vector<Vertex> mesh_vertices;
+  std::vector<uint16_t> mesh_indices;
+  std::vector<meshopt::MeshLod> mesh_lods;  // 所有 LOD 共用 mesh_vertices，索引依次拼接在 mesh_indices 中
+  meshopt::MeshOptimizationReport mesh_report;  // 加载时的优化前后对比，退出时输出
+  float mesh_radius{};                      // 网格对象空间包围球半径
+  VkBuffer vertexBuffer{};
+  VkDeviceMemory vertexBufferMemory{};
+  VkBuffer indexBuffer{};
+  VkDeviceMemory indexBufferMemory{};
+
+  SceneRenderer(std::shared_ptr<Gpu> gpu, std::shared_ptr<JobSystem> jobs) : gpu_(gpu), jobs_(jobs) {
+    device = gpu_->context()->device;
+    width = gpu_->width();
+    height = gpu_->height();
+    image_format = gpu_->image_format();
+    image_count = gpu_->image_count();
+
+    std::tie(target_width, target_height) = dynamic_resolution.MaxSize(width, height);
+    std::tie(render_width, render_height) = dynamic_resolution.RenderSize(width, height);
+
+    CreateRenderPass();
+    CreateStatisticsQueryPool();
+    CreateTimestampQueryPool();
+
+    // Uniform
+    CreateDescriptorAllocators();
+    CreateDescriptorSetLayout();
+    CreateUniformBuffers();
+    CreateDescriptorSets();
+
+    // Pipelines：三个变体并行编译，只等待第一帧必需的一个
+    pipelines = std::make_shared<PipelineRegistry>(device, gpu_->deletion_queue(), jobs_.get());
+    triangles_pipeline = std::make_shared<TrianglesPipeline>(pipelines, render_pass, render_pass_key, descriptor_set_layout);
+    depth_prepass_pipeline =
+        std::make_shared<TrianglesPipeline>(pipelines, render_pass, render_pass_key, descriptor_set_layout, TrianglesPipeline::Options{true, true});
+    depth_equal_pipeline = std::make_shared<TrianglesPipeline>(pipelines, render_pass, render_pass_key, descriptor_set_layout,
+                                                               TrianglesPipeline::Options{false, false, VK_COMPARE_OP_EQUAL});
+    pipelines->Require(triangles_pipeline->desc());  // 找不到着色器时抛出异常
+    PrecompileVariants();
+
+    LoadMesh();
+    CreateVertexBuffer();
+    CreateIndexBuffer();
+
+    textures = std::make_shared<TextureStreamer>(gpu_, jobs_, TextureStreamer::Options{});
+  }
+
+  // 释放的对象可能仍被在途帧使用，统一交给删除队列；描述符池由分配器析构时销毁
+  ~SceneRenderer() {
+    auto deletion_queue = gpu_->deletion_queue();
+    sprite_batcher.reset();  // 持有 textures
+    textures.reset();
+    point_cloud.reset();
+    points_pipeline.reset();
+    line_batcher.reset();
+    triangles_pipeline.reset();
+    depth_prepass_pipeline.reset();
+    depth_equal_pipeline.reset();
+    pipelines.reset();  // 等待仍在编译的管线
+    for (size_t i = 0; i < uniformBuffers.size(); ++i) {
+      deletion_queue->Release(uniformBuffers[i]);
+      deletion_queue->Release(uniformBuffersMemory[i]);  // 释放内存时隐式解除映射
+    }
+    deletion_queue->Release(vertexBuffer);
+    deletion_queue->Release(vertexBufferMemory);
+    deletion_queue->Release(indexBuffer);
+    deletion_queue->Release(indexBufferMemory);
+    deletion_queue->Release(framebuffer);
+    deletion_queue->Release(render_pass);
+    deletion_queue->Release(statistics_query_pool);
+    deletion_queue->Release(timestamp_query_pool);
+  }
+
+  // 在场景中绘制一个点云，source 可以是内存中的 pointcloud::Octree 或按需读取的 pointcloud::OctreeFile；传 nullptr 移除
+  void SetPointCloud(std::shared_ptr<pointcloud::Source> source) { SetPointCloud(source, PointCloudStreamer::Options{}); }
+  void SetPointCloud(std::shared_ptr<pointcloud::Source> source, const PointCloudStreamer::Options &options) {
+    point_cloud.reset();
+    if (!source)
+      return;
+    if (!points_pipeline)
+      points_pipeline = std::make_shared<PointsPipeline>(pipelines, render_pass, render_pass_key);
+    point_cloud = std::make_shared<PointCloudStreamer>(gpu_, jobs_, source, points_pipeline, options);
+  }
+
+  // 立即模式线段，本帧添加的线段在下一次 Frame() 中绘制一次
+  lines::LineList &Lines() {
+    if (!line_batcher)
+      line_batcher = std::make_shared<LineBatcher>(gpu_, pipelines, render_pass, render_pass_key);
+    return line_batcher->lines();
+  }
+
+  // 立即模式 2D 精灵，坐标为输出图像的像素（原点在左上角，y 向下），本帧添加的精灵在下一次 Frame() 中绘制一次
+  sprites::SpriteList &Sprites() {
+    if (!sprite_batcher)
+      sprite_batcher = std::make_shared<SpriteBatcher>(gpu_, pipelines, render_pass, render_pass_key, textures, descriptor_layouts);
+    return sprite_batcher->sprites();
+  }
+
+  // 对比深度预通道关/开两种模式最近一次的着色器调用次数（需要两种模式都至少渲染过一帧）
+  void PrintStatistics(std::ostream &os) const {
+    const auto &off = statistics[0];
+    const auto &on = statistics[1];
+    os << "pipeline statistics: prepass off vs=" << off.vertex_invocations << " fs=" << off.fragment_invocations
+       << ", prepass on vs=" << on.vertex_invocations << " fs=" << on.fragment_invocations;
+    if (off.fragment_invocations > 0 && on.frame > 0)
+      os << " (fragment invocations " << 100.0 * (1.0 - double(on.fragment_invocations) / double(off.fragment_invocations)) << "% fewer)";
+    os << "\n";
+  }
+
+  // 每帧的 CPU 准备工作，并声明场景通道和放大通道
+  virtual void AddPasses(RenderGraph &graph, RenderGraph::Resource backbuffer, uint32_t image_index) override {
+    E3D_TRACE_SCOPE("SceneRenderer::AddPasses");
+    this->graph = &graph;
+
+    UpdateUniformBuffer(image_index);
+    textures->Update(frame_number_++);
+    frame_descriptor_allocator->BeginFrame(image_index);
+
+    // 该图像上一次提交已经完成，取回它的查询结果，并用测得的 GPU 时间决定本帧的渲染尺寸
+    ReadStatistics(image_index);
+    if (ReadTimestamps(image_index) && dynamic_resolution_enabled)
+      dynamic_resolution.Update(gpu_frame_ms);
+    if (dynamic_resolution_enabled)
+      std::tie(render_width, render_height) = dynamic_resolution.RenderSize(width, height);
+    else
+      std::tie(render_width, render_height) = dynamic_resolution.MaxSize(width, height);
+
+    using Access = RenderGraph::Access;
+    scene_color = graph.CreateImage("scene_color", {target_width, target_height, image_format});
+    scene_depth = graph.CreateImage("scene_depth", {target_width, target_height, depth_format});
+    auto vertices = graph.ImportBuffer("scene_vertices", vertexBuffer);
+    auto indices = graph.ImportBuffer("scene_indices", indexBuffer);
+    auto uniforms = graph.ImportBuffer("scene_uniforms", uniformBuffers[image_index]);
+    RenderGraph::Resource points = RenderGraph::kInvalid;
+    if (point_cloud) {
+      point_cloud->Update(frame_number_, camera_view, camera_proj, render_height);
+      points = graph.ImportBuffer("point_cloud_pool", point_cloud->pool_buffer());
+    }
+    RenderGraph::Resource line_vertices = RenderGraph::kInvalid;
+    if (selected_instance >= 0 && size_t(selected_instance) < lod_objects.size()) {
+      const auto &object = lod_objects[selected_instance];
+      Eigen::Vector3f extent = Eigen::Vector3f::Constant(object.radius);
+      Lines().Box(object.center - extent, object.center + extent, 0xFFD000FF);
+    }
+    if (line_batcher) {
+      line_batcher->Flush();
+      line_vertices = graph.ImportBuffer("line_vertices", line_batcher->draw_buffer());
+    }
+    RenderGraph::Resource sprite_instances = RenderGraph::kInvalid;
+    if (sprite_batcher) {
+      sprite_batcher->Flush();
+      sprite_instances = graph.ImportBuffer("sprite_instances", sprite_batcher->buffer());
+    }
+
+    graph.AddPass(
+        "scene",
+        [&](RenderGraph::PassBuilder &builder) {
+          builder.Read(vertices, Access::kVertexBuffer);
+          builder.Read(indices, Access::kIndexBuffer);
+          builder.Read(uniforms, Access::kUniformBuffer);
+          if (points != RenderGraph::kInvalid)
+            builder.Read(points, Access::kVertexBuffer);
+          if (line_vertices != RenderGraph::kInvalid)
+            builder.Read(line_vertices, Access::kVertexBuffer);
+          if (sprite_instances != RenderGraph::kInvalid)
+            builder.Read(sprite_instances, Access::kVertexBuffer);
+          builder.Write(scene_color, Access::kColorAttachment);
+          builder.Write(scene_depth, Access::kDepthAttachment);
+        },
+        [this, image_index](VkCommandBuffer command_buffer) { Render(command_buffer, image_index); });
+
+    graph.AddPass(
+        "upscale",
+        [&](RenderGraph::PassBuilder &builder) {
+          builder.Read(scene_color, Access::kTransferSrc);
+          builder.Write(backbuffer, Access::kTransferDst);
+        },
+        [this, image_index](VkCommandBuffer command_buffer) { Upscale(command_buffer, image_index); });
+  }
+
+  // 场景通道：渲染图已把目标转换到附件布局，这里只录制渲染通道本身
+  virtual void Render(VkCommandBuffer command_buffer, uint32_t image_index) override {
+    E3D_TRACE_SCOPE("SceneRenderer::Render");
+    const auto &descriptor_set = descriptor_sets[image_index];  // ubo
+
+    // 渲染图重新编译后临时目标的视图会变化，帧缓冲随之重建，旧帧缓冲在当前帧完成后销毁
+    if (!framebuffer || framebuffer_generation != graph->generation()) {
+      gpu_->deletion_queue()->Release(framebuffer);
+      framebuffer = gpu_->CreateFramebuffer(render_pass, {graph->GetImageView(scene_color), graph->GetImageView(scene_depth)}, target_width, target_height);
+      framebuffer_generation = graph->generation();
+    }
+
+    VkClearValue clearValues[2]{};
+    clearValues[1].depthStencil = {0.0f, 0};  // 反向 Z：远处为 0
+
+    if (statistics_query_pool)
+      vkCmdResetQueryPool(command_buffer, statistics_query_pool, image_index, 1);
+    if (timestamp_query_pool) {
+      vkCmdResetQueryPool(command_buffer, timestamp_query_pool, image_index * 2, 2);
+      vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_query_pool, image_index * 2);
+    }
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = render_pass;
+    renderPassInfo.framebuffer = framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = {render_width, render_height};
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
+
+    vkCmdBeginRenderPass(command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if (statistics_query_pool)
+      vkCmdBeginQuery(command_buffer, statistics_query_pool, image_index, 0);
+    {
+      VkViewport viewport{};
+      viewport.x = 0.0f;
+      viewport.y = 0.0f;
+      viewport.width = (float)render_width;
+      viewport.height = (float)render_height;
+      viewport.minDepth = 0.0f;
+      viewport.maxDepth = 1.0f;
+      vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+      VkRect2D scissor{};
+      scissor.offset = {0, 0};
+      scissor.extent = {render_width, render_height};
+      vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+      lod_selector.SetCamera(camera_view, camera_proj, render_height);
+      lod_selector.SelectAll(lod_objects);
+      if (occlusion_culler)
+        CullOccluded();
+
+      auto draw_visible = [&]() {
+        for (size_t i = 0; i < lod_objects.size(); ++i) {
+          const auto &object = lod_objects[i];
+          if (object.lod < 0)
+            continue;
+          const auto &lod = (*object.lods)[object.lod];
+          Draw(command_buffer, object_constants[i], lod.index_count, lod.index_offset);
+        }
+      };
+
+      // 所有对象共用管线、顶点/索引缓冲和每帧 UBO，只绑定一次；每个对象只推送自己的常量。
+      // 三个变体共用同一个管线布局，切换管线后描述符集保持有效。
+      VkPipeline prepass = depth_prepass_pipeline->pipeline();
+      VkPipeline equal = depth_equal_pipeline->pipeline();
+      prepass_active = depth_prepass && prepass && equal;
+      if (prepass_active) {
+        // 先只写深度，再以 EQUAL 着色，每个像素最多执行一次片元着色器
+        BindGeometry(command_buffer, prepass, descriptor_set, vertexBuffer, indexBuffer, 0);
+        draw_visible();
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, equal);
+        counters::Add(counters::Counter::kPipelineBinds);
+        draw_visible();
+      } else if (VkPipeline pipeline = triangles_pipeline->pipeline()) {
+        BindGeometry(command_buffer, pipeline, descriptor_set, vertexBuffer, indexBuffer, 0);
+        draw_visible();
+      }
+
+      // 点云在网格之后绘制，与网格共用深度
+      if (point_cloud)
+        point_cloud->Draw(command_buffer, camera_proj * camera_view);
+      if (line_batcher)
+        line_batcher->Draw(command_buffer, camera_proj * camera_view, render_width, render_height);
+      // 精灵按输出分辨率的像素给出，视口随动态分辨率缩放，精灵在屏幕上的大小不变
+      if (sprite_batcher) {
+        Eigen::Matrix4f pixels = Eigen::Matrix4f::Identity();
+        pixels(0, 0) = 2.0f / float(width);
+        pixels(1, 1) = 2.0f / float(height);
+        pixels(0, 3) = -1.0f;
+        pixels(1, 3) = -1.0f;
+        sprite_batcher->Draw(command_buffer, pixels, *frame_descriptor_allocator);
+      }
+    }
+    if (statistics_query_pool) {
+      vkCmdEndQuery(command_buffer, statistics_query_pool, image_index);
+      statistics_pending[image_index] = true;
+      statistics_mode_[image_index] = prepass_active;
+    }
+    vkCmdEndRenderPass(command_buffer);
+  }
+
+ private:
+  void CreateUniformBuffers() {
+    VkDeviceSize bufferSize = sizeof(Uniform);
+
+    uniformBuffers.resize(image_count);
+    uniformBuffersMemory.resize(image_count);
+    uniformBuffersMapped.resize(image_count);
+
+    for (size_t i = 0; i < image_count; i++) {
+      gpu_->CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         uniformBuffers[i], uniformBuffersMemory[i], MemoryCategory::kUniforms);
+
+      vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+    }
+  }
+
+  void UpdateUniformBuffer(uint32_t currentImage) {
+    Eigen::Matrix4f view = helper::LookAt(camera.eye, camera.center, camera.up);
+    Eigen::Matrix4f proj = helper::PerspectiveReverseZ(camera.fov, static_cast<float>(width) / height, 0.1f);
+    proj(1, 1) *= -1;
+    camera_view = view;
+    camera_proj = proj;
+
+    // 网格、线段、点云、LOD 选择、遮挡剔除和拾取都使用同一个相机
+    Uniform ubo{};
+    ubo.view = camera_view;
+    ubo.proj = camera_proj;
+
+    // 假设 uniformBuffersMapped 是一个指向 UBO 内存的指针数组
+    memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+  }
+
+  // 资源管线：上传前对网格做顶点缓存、overdraw 和顶点拉取优化，ACMR/ATVR 对比记录在 mesh_report 中
+  void LoadMesh() {
+    mesh_vertices = vertices;
+    mesh_indices = indices;
+
+    auto position = [](const Vertex &v) { return Eigen::Vector3f(v.pos.x(), v.pos.y(), 0.0f); };
+    mesh_report = meshopt::OptimizeMesh(mesh_vertices, mesh_indices, position);
+
+    // 离线生成 LOD 链，所有级别写入同一个索引缓冲
+    mesh_lods = meshopt::BuildLodChain(mesh_indices, mesh_vertices.size(), [&](uint32_t i) { return position(mesh_vertices[i]); });
+
+    mesh_radius = 0.0f;
+    for (const auto &v : mesh_vertices)
+      mesh_radius = std::max(mesh_radius, v.pos.norm());
+    AddInstance(Eigen::Matrix4f::Identity());
+  }
+
+ public:
+  // 场景中的网格实例，每个实例一次绘制
+  void AddInstance(const Eigen::Matrix4f &model) {
+    float scale = model.block<3, 3>(0, 0).colwise().norm().maxCoeff();
+    lod_objects.push_back({model.block<3, 1>(0, 3), mesh_radius * scale, &mesh_lods});
+    object_constants.push_back({model});
+    pick_bvh_dirty = true;
+  }
+
+  // 同时清除遮挡物
+  void ClearInstances() {
+    lod_objects.clear();
+    object_constants.clear();
+    occluder_models.clear();
+    pick_bvh_dirty = true;
+    selected_instance = -1;
+  }
+
+  // 屏幕像素 (x, y) 下最近的实例（按包围球求交），没有时返回 -1
+  int Pick(float x, float y) {
+    E3D_TRACE_SCOPE("SceneRenderer::Pick");
+    if (pick_bvh_dirty) {
+      std::vector<bvh::Aabb> boxes;
+      boxes.reserve(lod_objects.size());
+      for (const auto &object : lod_objects) {
+        Eigen::Vector3f extent = Eigen::Vector3f::Constant(object.radius);
+        boxes.emplace_back(object.center - extent, object.center + extent);
+      }
+      pick_bvh.Build(boxes, jobs_.get());
+      pick_bvh_dirty = false;
+    }
+
+    auto [origin, direction] = helper::ScreenRay(x, y, width, height, camera_view, camera_proj);
+    auto sphere = [&](uint32_t primitive, const bvh::Ray &ray) {
+      const auto &object = lod_objects[primitive];
+      Eigen::Vector3f oc = ray.origin - object.center;
+      float b = oc.dot(ray.direction);
+      float c = oc.squaredNorm() - object.radius * object.radius;
+      float discriminant = b * b - c;
+      if (discriminant < 0.0f)
+        return INFINITY;
+      float t = -b - std::sqrt(discriminant);
+      if (t < 0.0f)
+        t = -b + std::sqrt(discriminant);  // 相机在球内
+      return t >= 0.0f ? t : INFINITY;
+    };
+    bvh::Hit hit = pick_bvh.Raycast({origin, direction}, sphere);
+    return hit ? int(hit.primitive) : -1;
+  }
+
+  // 把一个网格实例作为遮挡物，通常是离相机近的大物体；它本身仍需用 AddInstance 添加才会被绘制
+  void AddOccluder(const Eigen::Matrix4f &model) { occluder_models.push_back(model); }
+
+  void EnableOcclusionCulling(bool enabled) { EnableOcclusionCulling(enabled, occlusion::OcclusionCuller::Options{}); }
+  void EnableOcclusionCulling(bool enabled, const occlusion::OcclusionCuller::Options &options) {
+    occlusion_culler = enabled ? std::make_shared<occlusion::OcclusionCuller>(jobs_.get(), options) : nullptr;
+  }
+
+ private:
+
+  // 用最精细一级 LOD 光栅化遮挡物（简化后的网格可能超出原轮廓，不再保守），然后测试每个未剔除对象的包围球外接盒
+  void CullOccluded() {
+    E3D_TRACE_SCOPE("SceneRenderer::CullOccluded");
+    occlusion_culler->Begin(camera_proj * camera_view);
+    const auto &finest = mesh_lods.front();
+    auto position = [this](uint32_t i) { return Eigen::Vector3f(mesh_vertices[i].pos.x(), mesh_vertices[i].pos.y(), 0.0f); };
+    for (const auto &model : occluder_models)
+      occlusion_culler->AddOccluder(mesh_indices.data() + finest.index_offset, finest.index_count, mesh_vertices.size(), position, model);
+    occlusion_culler->Rasterize();
+
+    occlusion_boxes.clear();
+    occlusion_objects.clear();
+    for (size_t i = 0; i < lod_objects.size(); ++i) {
+      const auto &object = lod_objects[i];
+      if (object.lod < 0)
+        continue;
+      Eigen::Vector3f extent = Eigen::Vector3f::Constant(object.radius);
+      occlusion_boxes.push_back({object.center - extent, object.center + extent});
+      occlusion_objects.push_back(i);
+    }
+    occlusion_culler->Test(occlusion_boxes, occlusion_results);
+    for (size_t i = 0; i < occlusion_objects.size(); ++i)
+      if (occlusion_results[i] != occlusion::Result::kVisible)
+        lod_objects[occlusion_objects[i]].lod = -1;
   }
 
   void CreateVertexBuffer() {
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+    VkDeviceSize bufferSize = sizeof(mesh_vertices[0]) * mesh_vertices.size();
 
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
     gpu_->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                       stagingBuffer, stagingBufferMemory);
+                       stagingBuffer, stagingBufferMemory, MemoryCategory::kStaging);
 
     void *data;
     vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t)bufferSize);
+    memcpy(data, mesh_vertices.data(), (size_t)bufferSize);
     vkUnmapMemory(device, stagingBufferMemory);
 
     gpu_->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                       vertexBuffer, vertexBufferMemory);
+                       vertexBuffer, vertexBufferMemory, MemoryCategory::kGeometry);
 
     gpu_->CopyBuffer(stagingBuffer, vertexBuffer, bufferSize);
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    // CopyBuffer 会等待拷贝完成，暂存缓冲可以立即销毁
+    gpu_->deletion_queue()->Destroy(stagingBuffer);
+    gpu_->deletion_queue()->Destroy(stagingBufferMemory);
   }
 
   void CreateIndexBuffer() {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+    VkDeviceSize bufferSize = sizeof(mesh_indices[0]) * mesh_indices.size();
 
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
     gpu_->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                       stagingBuffer, stagingBufferMemory);
+                       stagingBuffer, stagingBufferMemory, MemoryCategory::kStaging);
 
     void *data;
     vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t)bufferSize);
+    memcpy(data, mesh_indices.data(), (size_t)bufferSize);
     vkUnmapMemory(device, stagingBufferMemory);
 
     gpu_->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                       indexBuffer, indexBufferMemory);
+                       indexBuffer, indexBufferMemory, MemoryCategory::kGeometry);
 
     gpu_->CopyBuffer(stagingBuffer, indexBuffer, bufferSize);
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    gpu_->deletion_queue()->Destroy(stagingBuffer);
+    gpu_->deletion_queue()->Destroy(stagingBufferMemory);
   }
 
   void CreateRenderPass() {
@@ -1248,56 +3446,164 @@ class SceneRenderer : public Renderer {
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;  // 布局转换和同步都由渲染图负责
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // 深度只在通道内使用，结束后不需要保存
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = depth_format;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
+    VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment};
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = 2;
+    renderPassInfo.pAttachments = attachments;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
 
     if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &render_pass) != VK_SUCCESS) {
       throw std::runtime_error("failed to create render pass!");
     }
+    gpu_->deletion_queue()->Track(render_pass);
+    render_pass_key = {{image_format}, depth_format, VK_SAMPLE_COUNT_1_BIT, 0};
+  }
+
+  // 设备不支持 pipelineStatisticsQuery 时不创建查询池，统计保持为 0
+  void CreateStatisticsQueryPool() {
+    if (!gpu_->context()->enabled_features.pipelineStatisticsQuery)
+      return;
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolInfo.queryCount = image_count;
+    queryPoolInfo.pipelineStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    VkResult err = vkCreateQueryPool(device, &queryPoolInfo, nullptr, &statistics_query_pool);
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("vkCreateQueryPool failed " + helper::ToStr(err));
+    gpu_->deletion_queue()->Track(statistics_query_pool);
+
+    statistics_pending.assign(image_count, false);
+    statistics_mode_.assign(image_count, false);
   }
 
-  void CreateDescriptorPool() {
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = image_count;
+  // 图形队列不支持时间戳时不创建查询池，动态分辨率保持在最大缩放
+  void CreateTimestampQueryPool() {
+    if (gpu_->context()->timestamp_period == 0.0f)
+      return;
 
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = image_count;
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = image_count * 2;
+
+    VkResult err = vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestamp_query_pool);
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("vkCreateQueryPool failed " + helper::ToStr(err));
+    gpu_->deletion_queue()->Track(timestamp_query_pool);
+
+    timestamps_pending.assign(image_count, false);
+  }
+
+  // 取回该图像上一次提交的 GPU 时间，有新结果时返回 true
+  bool ReadTimestamps(uint32_t image_index) {
+    if (!timestamp_query_pool || !timestamps_pending[image_index])
+      return false;
+
+    uint64_t results[2]{};
+    VkResult err =
+        vkGetQueryPoolResults(device, timestamp_query_pool, image_index * 2, 2, sizeof(results), results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (err == VK_NOT_READY)
+      return false;
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("vkGetQueryPoolResults failed " + helper::ToStr(err));
 
-    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptor_pool) != VK_SUCCESS) {
-      throw std::runtime_error("failed to create descriptor pool!");
+    timestamps_pending[image_index] = false;
+    gpu_frame_ms = float(double(results[1] - results[0]) * gpu_->context()->timestamp_period * 1e-6);
+
+    // 采集跟踪时把场景的 GPU 区间换算到 CPU 时钟，与 CPU 事件放在同一时间轴上
+    int64_t begin_ns{}, end_ns{};
+    if (trace::Enabled() && gpu_->GpuTicksToTraceNs(results[0], begin_ns) && gpu_->GpuTicksToTraceNs(results[1], end_ns))
+      trace::Record("scene", "gpu", begin_ns, end_ns, trace::kGpuTrack);
+    return true;
+  }
+
+  // 把中间目标的 [0, render) 区域线性过滤放大到整个交换链图像，布局转换由渲染图完成。
+  // 结束时间戳写在这里，只统计受渲染缩放影响的部分，UI 始终按原生分辨率绘制。
+  void Upscale(VkCommandBuffer command_buffer, uint32_t image_index) {
+    VkImage swapchain_image = gpu_->context()->swapchain_images[image_index];
+
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.srcOffsets[1] = {int32_t(render_width), int32_t(render_height), 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.dstOffsets[1] = {int32_t(width), int32_t(height), 1};
+    vkCmdBlitImage(command_buffer, graph->GetImage(scene_color), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1, &blit, VK_FILTER_LINEAR);
+
+    if (timestamp_query_pool) {
+      vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamp_query_pool, image_index * 2 + 1);
+      timestamps_pending[image_index] = true;
     }
   }
 
+  void ReadStatistics(uint32_t image_index) {
+    if (!statistics_query_pool || !statistics_pending[image_index])
+      return;
+
+    // 结果按统计位从低到高排列：顶点着色器调用、片元着色器调用
+    uint64_t results[2]{};
+    VkResult err = vkGetQueryPoolResults(device, statistics_query_pool, image_index, 1, sizeof(results), results, sizeof(results), VK_QUERY_RESULT_64_BIT);
+    if (err == VK_NOT_READY)
+      return;
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("vkGetQueryPoolResults failed " + helper::ToStr(err));
+
+    statistics_pending[image_index] = false;
+    auto &stats = statistics[statistics_mode_[image_index] ? 1 : 0];
+    stats.vertex_invocations = results[0];
+    stats.fragment_invocations = results[1];
+    stats.frame = frame_number_;
+  }
+
+  // 在后台编译所有功能组合的三种网格管线，结果进入管线缓存，之后切换功能位时不再卡顿
+  void PrecompileVariants() {
+    for (uint32_t features : MeshFeatures::Variants())
+      for (const auto &options : {TrianglesPipeline::Options{false, true, VK_COMPARE_OP_GREATER_OR_EQUAL, features},
+                                  TrianglesPipeline::Options{true, true, VK_COMPARE_OP_GREATER_OR_EQUAL, features},
+                                  TrianglesPipeline::Options{false, false, VK_COMPARE_OP_EQUAL, features}})
+        TrianglesPipeline(pipelines, render_pass, render_pass_key, descriptor_set_layout, options);
+  }
+
+  void CreateDescriptorAllocators() {
+    descriptor_layouts = std::make_shared<DescriptorLayoutCache>(device);
+    descriptor_allocator = std::make_shared<DescriptorAllocator>(device);
+    frame_descriptor_allocator = std::make_shared<FrameDescriptorAllocator>(device, image_count);
+  }
+
   void CreateDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
@@ -1306,28 +3612,13 @@ class SceneRenderer : public Renderer {
     uboLayoutBinding.pImmutableSamplers = nullptr;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
-
-    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptor_set_layout) != VK_SUCCESS) {
-      throw std::runtime_error("failed to create descriptor set layout!");
-    }
+    descriptor_set_layout = descriptor_layouts->Get({uboLayoutBinding});
   }
 
   void CreateDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(image_count, descriptor_set_layout);
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptor_pool;
-    allocInfo.descriptorSetCount = image_count;
-    allocInfo.pSetLayouts = layouts.data();
-
     descriptor_sets.resize(image_count);
-    if (vkAllocateDescriptorSets(device, &allocInfo, descriptor_sets.data()) != VK_SUCCESS) {
-      throw std::runtime_error("failed to allocate descriptor sets!");
-    }
+    for (size_t i = 0; i < image_count; i++)
+      descriptor_sets[i] = descriptor_allocator->Allocate(descriptor_set_layout);
 
     for (size_t i = 0; i < image_count; i++) {
       VkDescriptorBufferInfo bufferInfo{};
@@ -1348,58 +3639,442 @@ class SceneRenderer : public Renderer {
     }
   }
 
-  void Draw(VkCommandBuffer command_buffer, VkPipeline pipeline, VkDescriptorSet descriptor_set, VkBuffer vertex_buffer, VkBuffer index_buffer,
-            VkDeviceSize offset, uint32_t count) {
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, triangles_pipeline->pipeline);
+  void BindGeometry(VkCommandBuffer command_buffer, VkPipeline pipeline, VkDescriptorSet descriptor_set, VkBuffer vertex_buffer, VkBuffer index_buffer,
+                    VkDeviceSize offset) {
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
     vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, &offset);
     vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, VK_INDEX_TYPE_UINT16);
     vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, triangles_pipeline->pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
-    vkCmdDrawIndexed(command_buffer, count, 1, 0, 0, 0);
+    counters::Add(counters::Counter::kPipelineBinds);
+    counters::Add(counters::Counter::kDescriptorBinds);
+  }
+
+  // 每次绘制只写一次 push constant，不再重复绑定描述符集
+  void Draw(VkCommandBuffer command_buffer, const DrawConstants &constants, uint32_t count, uint32_t first_index = 0) {
+    vkCmdPushConstants(command_buffer, triangles_pipeline->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &constants);
+    vkCmdDrawIndexed(command_buffer, count, 1, first_index, 0, 0);
+    counters::Add(counters::Counter::kDrawCalls);
+    counters::Add(counters::Counter::kTriangles, count / 3);
   }
 };
 
+// 基于 Dear ImGui 的 UI，录制在同一帧的命令缓冲中，位于场景放大之后，按原生分辨率直接画在交换链图像上。
+// 顶点/索引缓冲由 imgui_impl_vulkan 为每个交换链图像各保留一份、常驻映射，只在不够用时增长。
+// 内置 HUD 显示帧时间曲线、各通道 GPU 耗时、显存用量和绘制计数。关闭后不声明通道、不做任何 ImGui 工作。
 class UiRenderer : public Renderer {
  public:
-  UiRenderer() {}
-  ~UiRenderer() {}
-  virtual void Render(VkCommandBuffer command_buffer, uint32_t image_index) override {}
+  struct Options {
+    bool enabled = true;
+    bool hud = true;
+    uint32_t history = 240;  // 帧时间曲线保留的帧数
+  };
+
+  // window 为空（无窗口模式）时没有输入，显示尺寸取目标图像尺寸
+  UiRenderer(std::shared_ptr<Gpu> gpu, Window *window) : UiRenderer(gpu, window, Options{}) {}
+  UiRenderer(std::shared_ptr<Gpu> gpu, Window *window, const Options &options) : gpu_(gpu), window_(window), options_(options) {
+    auto context = gpu_->context();
+    device_ = context->device;
+    frame_ms_.assign(options_.history, 0.0f);
+    gpu_ms_.assign(options_.history, 0.0f);
+
+    CreateRenderPass();
+    for (uint32_t i = 0; i < gpu_->image_count(); ++i)
+      framebuffers_.push_back(gpu_->CreateFramebuffer(render_pass_, i));
+
+    // ImGui 只需要字体纹理等少量组合图像采样器
+    VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.maxSets = 16;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptor_pool_) != VK_SUCCESS)
+      throw std::runtime_error("failed to create imgui descriptor pool!");
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = nullptr;  // 不写 imgui.ini
+    ImGui::StyleColorsDark();
+    if (window_)
+      ImGui_ImplSDL2_InitForVulkan(window_->sdl_window);
+
+    uint32_t image_count = std::max(gpu_->image_count(), 2u);
+    ImGui_ImplVulkan_InitInfo initInfo{};
+    initInfo.Instance = context->instance;
+    initInfo.PhysicalDevice = context->physical_device;
+    initInfo.Device = device_;
+    initInfo.QueueFamily = context->graphics_family_index;
+    initInfo.Queue = context->graphics_queue;
+    initInfo.DescriptorPool = descriptor_pool_;
+    initInfo.MinImageCount = image_count;
+    initInfo.ImageCount = image_count;
+    // 1.92.2 起渲染通道移到 PipelineInfoMain 中；采样数保持默认（单采样）
+#if IMGUI_VERSION_NUM >= 19220
+    initInfo.PipelineInfoMain.RenderPass = render_pass_;
+#else
+    initInfo.RenderPass = render_pass_;
+#endif
+    if (!ImGui_ImplVulkan_Init(&initInfo))
+      throw std::runtime_error("ImGui_ImplVulkan_Init failed");
+  }
+
+  // 调用前设备必须空闲
+  ~UiRenderer() {
+    ImGui_ImplVulkan_Shutdown();
+    if (window_)
+      ImGui_ImplSDL2_Shutdown();
+    ImGui::DestroyContext();
+    vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
+    for (auto framebuffer : framebuffers_)
+      gpu_->deletion_queue()->Release(framebuffer);
+    gpu_->deletion_queue()->Release(render_pass_);
+  }
+
+  void SetEnabled(bool enabled) { options_.enabled = enabled; }
+  bool enabled() const { return options_.enabled; }
+  void SetHudVisible(bool visible) { options_.hud = visible; }
+
+  // 每帧在 HUD 之后调用，用于绘制应用自己的 ImGui 窗口
+  void SetUserFunction(std::function<void(void)> func) { user_func_ = std::move(func); }
+  // HUD 中通道耗时的来源，为空时不显示
+  void SetPassTimer(PassTimer *timer) { pass_timer_ = timer; }
+
+  // 返回 true 表示 ImGui 需要这个事件（鼠标在 UI 上、正在输入文本），应用不应再处理
+  bool ProcessEvent(const Window::Event &event) {
+    if (!options_.enabled || !window_)
+      return false;
+    ImGui_ImplSDL2_ProcessEvent(&event);
+    const ImGuiIO &io = ImGui::GetIO();
+    bool mouse = event.type == SDL_MOUSEMOTION || event.type == SDL_MOUSEBUTTONDOWN || event.type == SDL_MOUSEBUTTONUP || event.type == SDL_MOUSEWHEEL;
+    bool keyboard = event.type == SDL_KEYDOWN || event.type == SDL_KEYUP || event.type == SDL_TEXTINPUT;
+    return (mouse && io.WantCaptureMouse) || (keyboard && io.WantCaptureKeyboard);
+  }
+
+  // 一帧结束时记录，用于帧时间曲线
+  void RecordFrame(float frame_ms, float cpu_ms, float gpu_ms) {
+    frame_ms_[history_index_] = frame_ms;
+    gpu_ms_[history_index_] = gpu_ms;
+    history_index_ = (history_index_ + 1) % options_.history;
+    last_cpu_ms_ = cpu_ms;
+  }
+
+  // 上一帧 UI 在 CPU 上的耗时（构建 + 录制），关闭时为 0；GPU 耗时见 PassTimer 中的 "ui" 通道
+  float cpu_ms() const { return cpu_ms_; }
+
+  virtual void AddPasses(RenderGraph &graph, RenderGraph::Resource backbuffer, uint32_t image_index) override {
+    last_ui_cpu_ms_ = cpu_ms_;
+    cpu_ms_ = 0.0f;
+    if (!options_.enabled)
+      return;
+
+    auto start = std::chrono::steady_clock::now();
+    BuildFrame();
+    cpu_ms_ += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    graph.AddPass(
+        "ui", [&](RenderGraph::PassBuilder &builder) { builder.Write(backbuffer, RenderGraph::Access::kColorAttachment); },
+        [this, image_index](VkCommandBuffer command_buffer) { Render(command_buffer, image_index); });
+  }
+
+  virtual void Render(VkCommandBuffer command_buffer, uint32_t image_index) override {
+    E3D_TRACE_SCOPE("UiRenderer::Render");
+    auto start = std::chrono::steady_clock::now();
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = render_pass_;
+    renderPassInfo.framebuffer = framebuffers_[image_index];
+    renderPassInfo.renderArea.extent = {gpu_->width(), gpu_->height()};
+    vkCmdBeginRenderPass(command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), command_buffer);
+    vkCmdEndRenderPass(command_buffer);
+
+    cpu_ms_ += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+ private:
+  // 交换链图像此时已由渲染图转换到颜色附件布局，保留放大后的场景内容
+  void CreateRenderPass() {
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = gpu_->image_format();
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    if (vkCreateRenderPass(device_, &renderPassInfo, nullptr, &render_pass_) != VK_SUCCESS)
+      throw std::runtime_error("failed to create ui render pass!");
+    gpu_->deletion_queue()->Track(render_pass_);
+  }
+
+  void BuildFrame() {
+    E3D_TRACE_SCOPE("UiRenderer::BuildFrame");
+    ImGui_ImplVulkan_NewFrame();
+    if (window_) {
+      ImGui_ImplSDL2_NewFrame();
+    } else {
+      auto now = std::chrono::steady_clock::now();
+      ImGuiIO &io = ImGui::GetIO();
+      io.DisplaySize = ImVec2(float(gpu_->width()), float(gpu_->height()));
+      io.DeltaTime = last_frame_ == std::chrono::steady_clock::time_point{} ? 1.0f / 60.0f
+                                                                           : std::max(std::chrono::duration<float>(now - last_frame_).count(), 1e-6f);
+      last_frame_ = now;
+    }
+    ImGui::NewFrame();
+    if (options_.hud)
+      DrawHud();
+    if (user_func_)
+      user_func_();
+    ImGui::Render();
+  }
+
+  void DrawHud() {
+    ImGui::SetNextWindowPos(ImVec2(8.0f, 8.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    if (!ImGui::Begin("HUD", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing)) {
+      ImGui::End();
+      return;
+    }
+
+    // 帧时间：最近一帧的值和整个历史的曲线，曲线从最旧的一帧开始
+    uint32_t last = (history_index_ + options_.history - 1) % options_.history;
+    float frame_ms = frame_ms_[last];
+    ImGui::Text("%.1f FPS  frame %.2f ms  cpu %.2f ms  gpu %.2f ms", frame_ms > 0.0f ? 1000.0f / frame_ms : 0.0f, frame_ms, last_cpu_ms_, gpu_ms_[last]);
+    float max_ms = 1000.0f / 30.0f;
+    for (float ms : frame_ms_)
+      max_ms = std::max(max_ms, ms);
+    ImGui::PlotLines("frame", frame_ms_.data(), int(options_.history), int(history_index_), nullptr, 0.0f, max_ms, ImVec2(240.0f, 48.0f));
+    ImGui::PlotLines("gpu", gpu_ms_.data(), int(options_.history), int(history_index_), nullptr, 0.0f, max_ms, ImVec2(240.0f, 48.0f));
+
+    if (pass_timer_ && pass_timer_->enabled() && ImGui::CollapsingHeader("GPU passes", ImGuiTreeNodeFlags_DefaultOpen)) {
+      for (const auto &timing : pass_timer_->timings())
+        ImGui::Text("%-16s %7.3f ms", timing.name.c_str(), timing.ms);
+      ImGui::Text("%-16s %7.3f ms", "total", pass_timer_->total_ms());
+    }
+
+    if (ImGui::CollapsingHeader("Memory", ImGuiTreeNodeFlags_DefaultOpen)) {
+      auto budget = gpu_->memory_budget();
+      for (uint32_t i = 0; i < budget->heap_count(); ++i) {
+        auto heap = budget->heap(i);
+        if (heap.budget == 0)
+          continue;
+        char overlay[64];
+        std::snprintf(overlay, sizeof(overlay), "%llu / %llu MB", (unsigned long long)(heap.usage >> 20), (unsigned long long)(heap.budget >> 20));
+        ImGui::Text("heap %u%s", i, heap.device_local ? " (device)" : "");
+        ImGui::ProgressBar(float(double(heap.usage) / double(heap.budget)), ImVec2(240.0f, 0.0f), overlay);
+      }
+      for (uint32_t c = 0; c < uint32_t(MemoryCategory::kCount); ++c)
+        ImGui::Text("%-16s %8.1f MB", Name(MemoryCategory(c)), double(budget->category_usage(MemoryCategory(c))) / double(1 << 20));
+    }
+
+    if (ImGui::CollapsingHeader("Counters", ImGuiTreeNodeFlags_DefaultOpen)) {
+      auto counters = counters::Registry::Get().Last();
+      for (auto counter : {counters::Counter::kDrawCalls, counters::Counter::kTriangles, counters::Counter::kPipelineBinds,
+                           counters::Counter::kDescriptorBinds, counters::Counter::kUploadBytes})
+        ImGui::Text("%-16s %10lld", counters::Name(counter), (long long)counters[counter]);
+    }
+
+    // 构建 HUD 时本帧的录制还没有发生，显示上一帧的完整耗时
+    ImGui::Text("ui cpu %.3f ms  gpu %.3f ms", last_ui_cpu_ms_, pass_timer_ ? pass_timer_->pass_ms("ui") : 0.0f);
+    ImGui::End();
+  }
+
+  std::shared_ptr<Gpu> gpu_;
+  Window *window_;
+  Options options_;
+  VkDevice device_{};
+  VkRenderPass render_pass_{};
+  std::vector<VkFramebuffer> framebuffers_;
+  VkDescriptorPool descriptor_pool_{};
+
+  std::function<void(void)> user_func_;
+  PassTimer *pass_timer_{};
+  std::chrono::steady_clock::time_point last_frame_{};
+
+  std::vector<float> frame_ms_;
+  std::vector<float> gpu_ms_;
+  uint32_t history_index_{};
+  float last_cpu_ms_{};
+  float cpu_ms_{};
+  float last_ui_cpu_ms_{};
 };
 
 class Engine {
   Window *window_{};
+  std::shared_ptr<JobSystem> jobs_{};
   std::shared_ptr<Gpu> gpu_{};
   SceneRenderer *scene_renderer_{};
   UiRenderer *ui_renderer_{};
+  RenderGraph *render_graph_{};
+  std::shared_ptr<PassTimer> pass_timer_{};
+
+  std::shared_ptr<Clock> clock_{std::make_shared<SystemClock>()};
+  std::shared_ptr<Timeline> timeline_{};
+  FrameStats *frame_stats_{};
 
-  std::function<void(void)> user_render_func;
+  uint32_t trace_frames_left_{};  // 正在采集的跟踪还剩多少帧
+  std::string trace_path_;
 
  public:
   Engine() {
     window_ = new Window("e3d", 1280, 720);
+    jobs_ = std::make_shared<JobSystem>();
     gpu_ = std::make_shared<Gpu>(window_);
-    scene_renderer_ = new SceneRenderer(gpu_);
-    ui_renderer_ = new UiRenderer();
+    CreateRenderers();
   }
 
-  ~Engine() {}
+  // 无窗口模式，由调用方逐帧驱动，用于基准测试
+  explicit Engine(const Gpu::HeadlessOptions &options) {
+    jobs_ = std::make_shared<JobSystem>();
+    gpu_ = std::make_shared<Gpu>(options);
+    CreateRenderers();
+  }
+
+  // 先等待设备空闲再释放各模块，最后清空删除队列并报告仍然存活的对象（非 0 即泄漏）
+  ~Engine() {
+    vkDeviceWaitIdle(gpu_->context()->device);
+    delete ui_renderer_;
+    scene_renderer_->pipelines->Report(std::cout);
+    scene_renderer_->mesh_report.Print(std::cout, "scene");
+    delete scene_renderer_;
+    if (ktx2::Stats().levels > 0)
+      ktx2::Stats().Print(std::cout);  // 纹理流送的后台任务已在上面结束
+    delete render_graph_;
+    pass_timer_.reset();
+    gpu_->deletion_queue()->Flush();
+    gpu_->deletion_queue()->Report(std::cout);
+    gpu_->memory_budget()->Report(std::cout);
+    gpu_.reset();
+    delete window_;
+  }
 
   void Run() {
     bool quit = false;
     while (!quit) {
-      Window::Event event;
-      while (window_->PollEvent(&event)) {
-        if (event.type == SDL_QUIT) {
-          quit = true;
-        } else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == window_->GetWindowId()) {
-          quit = true;
+      {
+        E3D_TRACE_SCOPE("Engine::PollEvents");
+        Window::Event event;
+        while (window_->PollEvent(&event)) {
+          if (ui_renderer_->ProcessEvent(event))
+            continue;
+          if (event.type == SDL_QUIT) {
+            quit = true;
+          } else if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
+            scene_renderer_->selected_instance = scene_renderer_->Pick(float(event.button.x), float(event.button.y));
+          } else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == window_->GetWindowId()) {
+            quit = true;
+          }
         }
       }
 
-      gpu_->Render([this](VkCommandBuffer command_buffer, uint32_t image_index) { scene_renderer_->Render(command_buffer, image_index); });
+      Frame();
+    }
+  }
+
+  // 录制并提交一帧。有回放时间线时先按时钟触发场景事件并设置相机。
+  void Frame() {
+    {
+      E3D_TRACE_SCOPE("Engine::Frame");
+      auto start = std::chrono::steady_clock::now();
+      if (timeline_) {
+        double time = clock_->Now();
+        timeline_->Advance(time);
+        scene_renderer_->camera = timeline_->Camera(time);
+      }
+
+      gpu_->Render([this](VkCommandBuffer command_buffer, uint32_t image_index) { RenderFrame(command_buffer, image_index); });
+      clock_->Tick();
+
+      counters::Registry::Get().EndFrame();
+      double frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      if (frame_stats_)
+        frame_stats_->Record(frame_ms, frame_ms - gpu_->wait_ms(), scene_renderer_->gpu_frame_ms);
+      if (ui_renderer_->enabled())
+        ui_renderer_->RecordFrame(float(frame_ms), float(frame_ms - gpu_->wait_ms()), pass_timer_->enabled() ? pass_timer_->total_ms() : scene_renderer_->gpu_frame_ms);
+    }
+
+    if (trace_frames_left_ > 0 && --trace_frames_left_ == 0) {
+      size_t events = trace::EndCapture(trace_path_);
+      std::cout << "trace: " << events << " events written to " << trace_path_ << "\n";
     }
   }
 
-  void SetUserRenderFunction(std::function<void(void)> &&func) { user_render_func = func; }
+  // 采集接下来 frames 帧的 CPU/GPU 跟踪并写到 path（Chrome trace JSON，可在 Perfetto 中打开）。
+  // GPU 区间在若干帧后才读回，最后几帧的 GPU 区间不在采集范围内。
+  void CaptureTrace(uint32_t frames, const std::string &path) {
+    if (frames == 0)
+      return;
+    trace_frames_left_ = frames;
+    trace_path_ = path;
+    trace::SetThreadName("main");
+    trace::BeginCapture();
+  }
+
+  // 替换动画时钟，例如用 FixedStepClock 让每次运行的帧序列完全一致
+  void SetClock(std::shared_ptr<Clock> clock) { clock_ = clock; }
+  void SetTimeline(std::shared_ptr<Timeline> timeline) { timeline_ = timeline; }
+  // 每帧向 stats 追加一条记录，传 nullptr 停止记录
+  void SetFrameStats(FrameStats *stats) { frame_stats_ = stats; }
+
+  // 每帧结束时汇总的引擎计数（绘制调用、绑定、三角形、上传字节、对象创建/销毁等），保留最近若干帧
+  counters::Registry &counters() { return counters::Registry::Get(); }
+
+  std::shared_ptr<Gpu> gpu() { return gpu_; }
+  SceneRenderer *scene() { return scene_renderer_; }
+  // 有窗口时默认开启，无窗口模式默认关闭，需要测量 UI 开销时用 SetEnabled(true) 打开
+  UiRenderer *ui() { return ui_renderer_; }
+  // 各通道上一次读回的 GPU 耗时
+  PassTimer *pass_timer() { return pass_timer_.get(); }
+
+  // 每帧在 HUD 之后调用，可以在其中使用 ImGui 绘制应用自己的窗口
+  void SetUserRenderFunction(std::function<void(void)> &&func) { ui_renderer_->SetUserFunction(std::move(func)); }
+
+ private:
+  void CreateRenderers() {
+    scene_renderer_ = new SceneRenderer(gpu_, jobs_);
+    pass_timer_ = std::make_shared<PassTimer>(gpu_->context()->device, gpu_->deletion_queue().get(), gpu_->context()->timestamp_period, gpu_->image_count());
+    UiRenderer::Options ui_options;
+    ui_options.enabled = window_ != nullptr;
+    ui_renderer_ = new UiRenderer(gpu_, window_, ui_options);
+    ui_renderer_->SetPassTimer(pass_timer_.get());
+    render_graph_ = new RenderGraph(gpu_->context()->physical_device, gpu_->context()->device, gpu_->deletion_queue().get());
+    render_graph_->SetMemoryBudget(gpu_->memory_budget().get());
+    render_graph_->SetPassTimer(pass_timer_.get());
+  }
+
+  // 每帧重新声明渲染图；拓扑不变时 Compile 直接复用上一次的结果
+  void RenderFrame(VkCommandBuffer command_buffer, uint32_t image_index) {
+    auto context = gpu_->context();
+    render_graph_->Reset();
+    // 获取信号量在 COLOR_ATTACHMENT_OUTPUT 阶段等待，交换链图像的依赖链从该阶段开始
+    auto backbuffer = render_graph_->ImportImage("backbuffer", context->swapchain_images[image_index], context->swapchain_image_views[image_index],
+                                                 {gpu_->width(), gpu_->height(), gpu_->image_format()}, VK_IMAGE_LAYOUT_UNDEFINED,
+                                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, gpu_->present_layout());
+
+    scene_renderer_->AddPasses(*render_graph_, backbuffer, image_index);
+    ui_renderer_->AddPasses(*render_graph_, backbuffer, image_index);
+
+    render_graph_->Compile();
+    pass_timer_->Begin(command_buffer, image_index);
+    render_graph_->Execute(command_buffer);
+  }
 };
 
 }  // namespace e3d
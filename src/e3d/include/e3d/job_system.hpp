@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace.hpp"
+
+namespace e3d {
+
+// 简单的后台线程池，用于资源加载、转码、加速结构构建等不能阻塞帧循环的工作。
+class JobSystem {
+ public:
+  explicit JobSystem(uint32_t thread_count = 0) {
+    if (thread_count == 0)
+      thread_count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+    for (uint32_t i = 0; i < thread_count; ++i)
+      threads_.emplace_back([this, i] {
+        trace::SetThreadName("job worker " + std::to_string(i));
+        WorkerLoop();
+      });
+  }
+
+  ~JobSystem() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &thread : threads_)
+      thread.join();
+  }
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  uint32_t thread_count() const { return static_cast<uint32_t>(threads_.size()); }
+
+  // 提交一个任务，返回可等待的 future
+  template <typename Fn>
+  auto Submit(Fn &&fn) -> std::future<decltype(fn())> {
+    using Result = decltype(fn());
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+    auto future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.emplace_back([task] { (*task)(); });
+    }
+    cv_.notify_one();
+    return future;
+  }
+
+  // 把 [0, count) 切分成若干块并行执行 fn(begin, end)，调用线程也参与计算，返回时全部完成
+  void ParallelFor(size_t count, size_t min_batch, const std::function<void(size_t, size_t)> &fn) {
+    if (count == 0)
+      return;
+
+    size_t batches = std::min<size_t>(thread_count() + 1, (count + min_batch - 1) / std::max<size_t>(min_batch, 1));
+    if (batches <= 1) {
+      fn(0, count);
+      return;
+    }
+
+    size_t batch_size = (count + batches - 1) / batches;
+    std::vector<std::future<void>> futures;
+    futures.reserve(batches - 1);
+    for (size_t b = 1; b < batches; ++b) {
+      size_t begin = b * batch_size;
+      size_t end = std::min(count, begin + batch_size);
+      if (begin < end)
+        futures.push_back(Submit([&fn, begin, end] { fn(begin, end); }));
+    }
+    fn(0, std::min(count, batch_size));
+    for (auto &future : futures)
+      future.get();
+  }
+
+ private:
+  void WorkerLoop() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (stop_ && queue_.empty())
+          return;
+        job = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      E3D_TRACE_SCOPE("job");
+      job();
+    }
+  }
+
+  std::vector<std::thread> threads_;
+  std::deque<std::function<void()>> queue_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_{false};
+};
+
+}  // namespace e3d
@@ -0,0 +1,433 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef E3D_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef E3D_WITH_BASISU
+#include <basisu_transcoder.h>
+#endif
+
+namespace e3d {
+
+namespace ktx2 {
+
+// KTX2 超压缩方案
+enum class Supercompression : uint32_t {
+  kNone = 0,
+  kBasisLZ = 1,
+  kZstd = 2,
+  kZlib = 3,
+};
+
+// DFD 中的颜色模型，用于区分 Basis 的两种编码
+constexpr uint8_t kColorModelETC1S = 163;
+constexpr uint8_t kColorModelUASTC = 166;
+
+struct Level {
+  uint64_t offset;
+  uint64_t length;
+  uint64_t uncompressed_length;
+};
+
+// 解析后的 KTX2 容器，data 持有整个文件内容
+struct File {
+  VkFormat format{VK_FORMAT_UNDEFINED};
+  uint32_t type_size{};
+  uint32_t width{};
+  uint32_t height{};
+  uint32_t levels{};
+  Supercompression scheme{Supercompression::kNone};
+  uint8_t color_model{};
+  bool has_alpha{};
+  std::vector<Level> level_index;
+  std::vector<uint8_t> data;
+
+  bool IsBasis() const { return scheme == Supercompression::kBasisLZ || color_model == kColorModelUASTC; }
+};
+
+inline File Parse(std::vector<uint8_t> data) {
+  static const uint8_t kIdentifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+  constexpr size_t kHeaderSize = 80;
+
+  if (data.size() < kHeaderSize || memcmp(data.data(), kIdentifier, sizeof(kIdentifier)) != 0)
+    throw std::runtime_error("not a KTX2 file!");
+
+  auto u32 = [&](size_t offset) {
+    uint32_t v;
+    memcpy(&v, data.data() + offset, sizeof(v));
+    return v;
+  };
+  auto u64 = [&](size_t offset) {
+    uint64_t v;
+    memcpy(&v, data.data() + offset, sizeof(v));
+    return v;
+  };
+
+  File file;
+  file.format = static_cast<VkFormat>(u32(12));
+  file.type_size = u32(16);
+  file.width = u32(20);
+  file.height = std::max(1u, u32(24));
+  uint32_t depth = u32(28);
+  uint32_t layers = u32(32);
+  uint32_t faces = u32(36);
+  file.levels = std::max(1u, u32(40));
+  file.scheme = static_cast<Supercompression>(u32(44));
+
+  if (depth > 1 || layers > 1 || faces != 1)
+    throw std::runtime_error("only 2D KTX2 textures are supported!");
+
+  uint32_t dfd_offset = u32(48);
+  uint32_t dfd_length = u32(52);
+  if (data.size() < kHeaderSize + size_t(file.levels) * 24)
+    throw std::runtime_error("truncated KTX2 level index!");
+
+  for (uint32_t i = 0; i < file.levels; ++i) {
+    size_t base = kHeaderSize + size_t(i) * 24;
+    Level level{u64(base), u64(base + 8), u64(base + 16)};
+    if (level.offset + level.length > data.size())
+      throw std::runtime_error("truncated KTX2 level data!");
+    file.level_index.push_back(level);
+  }
+
+  // 基础 DFD 块：colorModel 位于块头后第 8 字节，每个 sample 16 字节，channelType 的低 4 位为通道 ID
+  if (dfd_length >= 28 && dfd_offset + dfd_length <= data.size()) {
+    const uint8_t *block = data.data() + dfd_offset + 4;
+    file.color_model = block[8];
+    uint32_t block_size = (uint32_t(block[6]) | uint32_t(block[7]) << 8);
+    uint32_t samples = block_size > 24 ? (block_size - 24) / 16 : 0;
+    for (uint32_t s = 0; s < samples; ++s) {
+      uint8_t channel = block[24 + s * 16 + 3] & 0x0F;
+      bool etc1s_alpha = file.color_model == kColorModelETC1S && channel == 15;
+      bool uastc_alpha = file.color_model == kColorModelUASTC && channel == 3;
+      bool rgba_alpha = file.color_model != kColorModelETC1S && file.color_model != kColorModelUASTC && channel == 15;
+      if (etc1s_alpha || uastc_alpha || rgba_alpha)
+        file.has_alpha = true;
+    }
+  }
+
+  // 没有 VkFormat 的数据只能是 Basis Universal，否则无法知道如何解释
+  if (file.format == VK_FORMAT_UNDEFINED && !file.IsBasis())
+    throw std::runtime_error("KTX2 file has VK_FORMAT_UNDEFINED but is not Basis Universal!");
+
+  file.data = std::move(data);
+  return file;
+}
+
+inline File Load(const std::string &filename) {
+  std::ifstream stream(filename, std::ios::ate | std::ios::binary);
+  if (!stream.is_open())
+    throw std::runtime_error("failed to open file!");
+
+  size_t size = (size_t)stream.tellg();
+  std::vector<uint8_t> data(size);
+  stream.seekg(0);
+  stream.read(reinterpret_cast<char *>(data.data()), size);
+  return Parse(std::move(data));
+}
+
+// 转码目标，按优先级排列
+enum class Target {
+  kBC7,
+  kASTC4x4,
+  kBC3,
+  kBC1,
+  kETC2,
+  kRGBA8,
+  kPassthrough,  // 容器中已是设备支持的格式，直接上传
+};
+
+struct TranscodeTarget {
+  Target target;
+  VkFormat format;
+};
+
+inline bool IsSampleable(VkPhysicalDevice physical_device, VkFormat format) {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+  return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+// 根据物理设备支持的特性和格式选择最优的块压缩格式，都不支持时回退到 RGBA8
+inline TranscodeTarget SelectTarget(VkPhysicalDevice physical_device, const VkPhysicalDeviceFeatures &enabled, const File &file) {
+  if (!file.IsBasis() && file.format != VK_FORMAT_UNDEFINED) {
+    bool rgba8 = file.format == VK_FORMAT_R8G8B8A8_UNORM || file.format == VK_FORMAT_R8G8B8A8_SRGB;
+    if (rgba8 && file.levels > 1 && enabled.textureCompressionBC) {
+      // 自带 mip 链的 RGBA8 在 CPU 上压缩为 BC1/BC3；只有一级时保持 RGBA8，由 GPU blit 生成 mip 链
+      if (file.has_alpha && IsSampleable(physical_device, VK_FORMAT_BC3_UNORM_BLOCK))
+        return {Target::kBC3, file.format == VK_FORMAT_R8G8B8A8_SRGB ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK};
+      if (!file.has_alpha && IsSampleable(physical_device, VK_FORMAT_BC1_RGB_UNORM_BLOCK))
+        return {Target::kBC1, file.format == VK_FORMAT_R8G8B8A8_SRGB ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK};
+    }
+    if (IsSampleable(physical_device, file.format))
+      return {Target::kPassthrough, file.format};
+    throw std::runtime_error("KTX2 format " + std::to_string(file.format) + " is not supported by the device");
+  }
+
+  if (enabled.textureCompressionBC && IsSampleable(physical_device, VK_FORMAT_BC7_UNORM_BLOCK))
+    return {Target::kBC7, VK_FORMAT_BC7_UNORM_BLOCK};
+  if (enabled.textureCompressionASTC_LDR && IsSampleable(physical_device, VK_FORMAT_ASTC_4x4_UNORM_BLOCK))
+    return {Target::kASTC4x4, VK_FORMAT_ASTC_4x4_UNORM_BLOCK};
+  if (enabled.textureCompressionBC && file.has_alpha && IsSampleable(physical_device, VK_FORMAT_BC3_UNORM_BLOCK))
+    return {Target::kBC3, VK_FORMAT_BC3_UNORM_BLOCK};
+  if (enabled.textureCompressionBC && !file.has_alpha && IsSampleable(physical_device, VK_FORMAT_BC1_RGB_UNORM_BLOCK))
+    return {Target::kBC1, VK_FORMAT_BC1_RGB_UNORM_BLOCK};
+  if (enabled.textureCompressionETC2 && IsSampleable(physical_device, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK))
+    return {Target::kETC2, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK};
+  return {Target::kRGBA8, VK_FORMAT_R8G8B8A8_UNORM};
+}
+
+// 转码吞吐和显存节省统计，多个工作线程并发累加
+struct TranscodeStats {
+  std::atomic<uint64_t> levels{};
+  std::atomic<uint64_t> input_bytes{};         // 容器中的（超压缩）数据
+  std::atomic<uint64_t> output_bytes{};        // 上传到 GPU 的数据
+  std::atomic<uint64_t> uncompressed_bytes{};  // 同尺寸 RGBA8 所需的数据
+  std::atomic<uint64_t> nanoseconds{};
+
+  void Print(std::ostream &os) const {
+    double seconds = nanoseconds.load() * 1e-9;
+    double mpix = uncompressed_bytes.load() / 4.0 / 1e6;
+    double saving = uncompressed_bytes.load() == 0 ? 0.0 : 1.0 - double(output_bytes.load()) / double(uncompressed_bytes.load());
+    os << "KTX2 transcode: " << levels.load() << " levels, " << (seconds > 0.0 ? mpix / seconds : 0.0) << " Mpix/s, "
+       << (seconds > 0.0 ? input_bytes.load() / 1e6 / seconds : 0.0) << " MB/s input, " << output_bytes.load() / 1e6 << " MB GPU vs "
+       << uncompressed_bytes.load() / 1e6 << " MB RGBA8 (" << saving * 100.0 << "% saved)" << std::endl;
+  }
+};
+
+inline TranscodeStats &Stats() {
+  static TranscodeStats stats;
+  return stats;
+}
+
+namespace detail {
+
+inline uint16_t PackRGB565(const uint8_t *c) { return uint16_t((c[0] >> 3) << 11 | (c[1] >> 2) << 5 | (c[2] >> 3)); }
+
+inline void UnpackRGB565(uint16_t v, int *c) {
+  c[0] = ((v >> 11) & 31) * 255 / 31;
+  c[1] = ((v >> 5) & 63) * 255 / 63;
+  c[2] = (v & 31) * 255 / 31;
+}
+
+// BC1 颜色块：包围盒端点内缩后按投影选索引，速度优先
+inline void EncodeBC1Color(const uint8_t block[16][4], uint8_t *out) {
+  uint8_t lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      lo[c] = std::min(lo[c], block[i][c]);
+      hi[c] = std::max(hi[c], block[i][c]);
+    }
+  }
+  for (int c = 0; c < 3; ++c) {
+    int inset = (hi[c] - lo[c]) >> 4;
+    lo[c] = static_cast<uint8_t>(lo[c] + inset);
+    hi[c] = static_cast<uint8_t>(hi[c] - inset);
+  }
+
+  uint16_t c0 = PackRGB565(hi), c1 = PackRGB565(lo);
+  if (c0 < c1)
+    std::swap(c0, c1);
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    int e0[3], e1[3];
+    UnpackRGB565(c0, e0);
+    UnpackRGB565(c1, e1);
+    int axis[3] = {e1[0] - e0[0], e1[1] - e0[1], e1[2] - e0[2]};
+    int length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    // 调色板顺序为 c0, c1, 2/3c0+1/3c1, 1/3c0+2/3c1
+    static const uint32_t kRemap[4] = {0, 2, 3, 1};
+    for (int i = 0; i < 16; ++i) {
+      int dot = (block[i][0] - e0[0]) * axis[0] + (block[i][1] - e0[1]) * axis[1] + (block[i][2] - e0[2]) * axis[2];
+      int step = std::clamp((dot * 3 + length / 2) / length, 0, 3);
+      indices |= kRemap[step] << (i * 2);
+    }
+  }
+
+  memcpy(out + 0, &c0, 2);
+  memcpy(out + 2, &c1, 2);
+  memcpy(out + 4, &indices, 4);
+}
+
+// BC3 alpha 块：8 级插值
+inline void EncodeBC3Alpha(const uint8_t block[16][4], uint8_t *out) {
+  uint8_t lo = 255, hi = 0;
+  for (int i = 0; i < 16; ++i) {
+    lo = std::min(lo, block[i][3]);
+    hi = std::max(hi, block[i][3]);
+  }
+  out[0] = hi;
+  out[1] = lo;
+
+  uint64_t indices = 0;
+  if (hi != lo) {
+    // a0 > a1 时调色板顺序为 a0, a1, 然后 6 个从 a0 到 a1 的插值
+    static const uint64_t kRemap[8] = {0, 2, 3, 4, 5, 6, 7, 1};
+    for (int i = 0; i < 16; ++i) {
+      int step = std::clamp(((hi - block[i][3]) * 7 + (hi - lo) / 2) / (hi - lo), 0, 7);
+      indices |= kRemap[step] << (i * 3);
+    }
+  }
+  for (int i = 0; i < 6; ++i)
+    out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+}
+
+// 把 RGBA8 图像压缩为 BC1 (8 字节/块) 或 BC3 (16 字节/块)
+inline std::vector<uint8_t> EncodeBC(const uint8_t *rgba, uint32_t width, uint32_t height, bool bc3) {
+  uint32_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+  size_t block_bytes = bc3 ? 16 : 8;
+  std::vector<uint8_t> out(size_t(blocks_x) * blocks_y * block_bytes);
+
+  uint8_t block[16][4];
+  for (uint32_t by = 0; by < blocks_y; ++by) {
+    for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+      for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t x = std::min(bx * 4 + i % 4, width - 1);
+        uint32_t y = std::min(by * 4 + i / 4, height - 1);
+        memcpy(block[i], rgba + (size_t(y) * width + x) * 4, 4);
+      }
+      uint8_t *dst = out.data() + (size_t(by) * blocks_x + bx) * block_bytes;
+      if (bc3) {
+        EncodeBC3Alpha(block, dst);
+        EncodeBC1Color(block, dst + 8);
+      } else {
+        EncodeBC1Color(block, dst);
+      }
+    }
+  }
+  return out;
+}
+
+}  // namespace detail
+
+// 转码器：解开超压缩并转成目标格式。实例可被多个工作线程同时使用。
+class Transcoder {
+ public:
+  Transcoder(std::shared_ptr<const File> file, TranscodeTarget target) : file_(file), target_(target) {
+    if (file_->scheme == Supercompression::kZlib)
+      throw std::runtime_error("ZLIB supercompressed KTX2 is not supported!");
+#ifdef E3D_WITH_BASISU
+    if (file_->IsBasis()) {
+      static std::once_flag init;
+      std::call_once(init, [] { basist::basisu_transcoder_init(); });
+      basis_ = std::make_unique<basist::ktx2_transcoder>();
+      if (!basis_->init(file_->data.data(), static_cast<uint32_t>(file_->data.size())) || !basis_->start_transcoding())
+        throw std::runtime_error("failed to initialize Basis transcoder!");
+    }
+#else
+    if (file_->IsBasis())
+      throw std::runtime_error("Basis Universal KTX2 requires building with E3D_WITH_BASISU");
+#endif
+#ifndef E3D_WITH_ZSTD
+    if (file_->scheme == Supercompression::kZstd)
+      throw std::runtime_error("Zstd supercompressed KTX2 requires building with E3D_WITH_ZSTD");
+#endif
+  }
+
+  std::vector<uint8_t> TranscodeLevel(uint32_t level) const {
+    auto start = std::chrono::steady_clock::now();
+    const Level &index = file_->level_index[level];
+    uint32_t width = std::max(1u, file_->width >> level);
+    uint32_t height = std::max(1u, file_->height >> level);
+
+    std::vector<uint8_t> result;
+    if (file_->IsBasis()) {
+      result = TranscodeBasis(level, width, height);
+    } else {
+      std::vector<uint8_t> raw = Decompress(index);
+      if (target_.target == Target::kBC1 || target_.target == Target::kBC3)
+        result = detail::EncodeBC(raw.data(), width, height, target_.target == Target::kBC3);
+      else
+        result = std::move(raw);
+    }
+
+    auto &stats = Stats();
+    stats.levels++;
+    stats.input_bytes += index.length;
+    stats.output_bytes += result.size();
+    stats.uncompressed_bytes += uint64_t(width) * height * 4;
+    stats.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return result;
+  }
+
+ private:
+  std::vector<uint8_t> Decompress(const Level &index) const {
+    const uint8_t *src = file_->data.data() + index.offset;
+    if (file_->scheme == Supercompression::kNone)
+      return std::vector<uint8_t>(src, src + index.length);
+
+#ifdef E3D_WITH_ZSTD
+    std::vector<uint8_t> out(index.uncompressed_length);
+    size_t size = ZSTD_decompress(out.data(), out.size(), src, index.length);
+    if (ZSTD_isError(size) || size != out.size())
+      throw std::runtime_error("ZSTD_decompress failed " + std::string(ZSTD_getErrorName(size)));
+    return out;
+#else
+    throw std::runtime_error("unsupported KTX2 supercompression");
+#endif
+  }
+
+  std::vector<uint8_t> TranscodeBasis(uint32_t level, uint32_t width, uint32_t height) const {
+#ifdef E3D_WITH_BASISU
+    basist::transcoder_texture_format format = basist::transcoder_texture_format::cTFRGBA32;
+    switch (target_.target) {
+      case Target::kBC7:
+        format = basist::transcoder_texture_format::cTFBC7_RGBA;
+        break;
+      case Target::kASTC4x4:
+        format = basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+        break;
+      case Target::kBC3:
+        format = basist::transcoder_texture_format::cTFBC3_RGBA;
+        break;
+      case Target::kBC1:
+        format = basist::transcoder_texture_format::cTFBC1_RGB;
+        break;
+      case Target::kETC2:
+        format = basist::transcoder_texture_format::cTFETC2_RGBA;
+        break;
+      default:
+        break;
+    }
+
+    bool uncompressed = basist::basis_transcoder_format_is_uncompressed(format);
+    uint32_t units = uncompressed ? width * height : ((width + 3) / 4) * ((height + 3) / 4);
+    std::vector<uint8_t> out(size_t(units) * basist::basis_get_bytes_per_block_or_pixel(format));
+
+    // 每次调用使用独立的状态，允许多个工作线程并发转码不同级别
+    basist::ktx2_transcoder_state state;
+    if (!basis_->transcode_image_level(level, 0, 0, out.data(), units, format, 0, 0, 0, -1, -1, &state))
+      throw std::runtime_error("Basis transcode failed for level " + std::to_string(level));
+    return out;
+#else
+    throw std::runtime_error("Basis Universal KTX2 requires building with E3D_WITH_BASISU");
+#endif
+  }
+
+  std::shared_ptr<const File> file_;
+  TranscodeTarget target_;
+#ifdef E3D_WITH_BASISU
+  std::unique_ptr<basist::ktx2_transcoder> basis_;
+#endif
+};
+
+}  // namespace ktx2
+
+}  // namespace e3d
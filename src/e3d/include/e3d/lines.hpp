@@ -0,0 +1,160 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace e3d::lines {
+
+// 线段端点，16 字节。颜色与 helper::ColorU32ToF32 相同按 0xRRGGBBAA 书写，着色器中按 R8G8B8A8 读入后交换分量
+struct Vertex {
+  float x, y, z;
+  uint32_t color;
+};
+static_assert(sizeof(Vertex) == 16, "lines::Vertex must stay 16 bytes");
+
+// 一条线段的两个端点相邻存放。细线按顶点读取画 LINE_LIST，粗线把同一块内存按实例（32 字节步长）读取并在顶点着色器中扩展成四边形
+struct Segment {
+  Vertex a, b;
+};
+static_assert(sizeof(Segment) == 32, "lines::Segment must stay 32 bytes");
+
+// 一段线宽相同的连续线段，对应一次绘制
+struct Batch {
+  uint32_t first;  // 第一条线段的序号
+  uint32_t count;
+  float width;  // 屏幕空间像素；不大于 1 时用硬件细线
+};
+
+// 立即模式的线段列表：直接写入外部提供的内存（通常是常驻映射的顶点缓冲），每条线段只有一次 32 字节的写入。
+// 线宽变化时开始新的批次，同一线宽的调用无论多少次都合并为一次绘制。超出容量的线段被丢弃并计数。
+class LineList {
+ public:
+  LineList() = default;
+  LineList(Segment *data, uint32_t capacity) { Reset(data, capacity); }
+
+  // 换到新的目标内存并清空
+  void Reset(Segment *data, uint32_t capacity) {
+    data_ = data;
+    capacity_ = capacity;
+    count_ = 0;
+    dropped_ = 0;
+    batches_.clear();
+    batch_first_ = 0;
+  }
+
+  // 之后添加的线段使用该线宽
+  void SetWidth(float width) {
+    if (width == width_)
+      return;
+    CloseBatch();
+    width_ = width;
+  }
+  float width() const { return width_; }
+
+  void Line(const Eigen::Vector3f &a, const Eigen::Vector3f &b, uint32_t color) { Line(a, b, color, color); }
+  void Line(const Eigen::Vector3f &a, const Eigen::Vector3f &b, uint32_t color_a, uint32_t color_b) {
+    if (count_ == capacity_) {
+      dropped_++;
+      return;
+    }
+    data_[count_++] = {{a.x(), a.y(), a.z(), color_a}, {b.x(), b.y(), b.z(), color_b}};
+  }
+
+  void Polyline(const Eigen::Vector3f *points, size_t count, uint32_t color, bool closed = false) {
+    for (size_t i = 1; i < count; ++i)
+      Line(points[i - 1], points[i], color);
+    if (closed && count > 2)
+      Line(points[count - 1], points[0], color);
+  }
+  void Polyline(const std::vector<Eigen::Vector3f> &points, uint32_t color, bool closed = false) {
+    Polyline(points.data(), points.size(), color, closed);
+  }
+
+  // 轴对齐包围盒
+  void Box(const Eigen::Vector3f &min, const Eigen::Vector3f &max, uint32_t color) { Box(Eigen::Matrix4f::Identity(), min, max, color); }
+
+  // transform 变换后的包围盒，例如带旋转的物体包围盒
+  void Box(const Eigen::Matrix4f &transform, const Eigen::Vector3f &min, const Eigen::Vector3f &max, uint32_t color) {
+    Eigen::Vector3f corners[8];
+    for (int i = 0; i < 8; ++i) {
+      Eigen::Vector4f p((i & 1) ? max.x() : min.x(), (i & 2) ? max.y() : min.y(), (i & 4) ? max.z() : min.z(), 1.0f);
+      corners[i] = (transform * p).head<3>();
+    }
+    Edges(corners, color);
+  }
+
+  // 透视视锥的 12 条棱，view_proj 为相机的投影乘视图矩阵（Vulkan 深度范围 [0, 1]，正向或反向 Z 都可以）。
+  // 远平面沿视线方向离近平面超过 max_distance 时截断在 max_distance 处；无穷远投影（helper::PerspectiveReverseZ）的远平面在 w = 0 处，总是被截断。
+  void Frustum(const Eigen::Matrix4f &view_proj, uint32_t color, float max_distance = 100.0f) {
+    Eigen::Matrix4f inverse = view_proj.inverse();
+    auto unproject = [&](float x, float y, float z) -> Eigen::Vector4f { return inverse * Eigen::Vector4f(x, y, z, 1.0f); };
+
+    // 反投影后的 w 与到相机的距离成反比，|w| 较大的一端是近平面（反向 Z 时为 NDC z = 1）
+    float near_z = std::abs(unproject(0.0f, 0.0f, 1.0f).w()) > std::abs(unproject(0.0f, 0.0f, 0.0f).w()) ? 1.0f : 0.0f;
+    float far_z = 1.0f - near_z;
+
+    // 棱的方向取近平面到 NDC z = 0.5 处的点，这一点在任何透视投影下都是有限的
+    Eigen::Vector3f axis = (Dehomogenize(unproject(0.0f, 0.0f, 0.5f)) - Dehomogenize(unproject(0.0f, 0.0f, near_z))).normalized();
+
+    Eigen::Vector3f corners[8];
+    for (int i = 0; i < 4; ++i) {
+      float x = (i & 1) ? 1.0f : -1.0f;
+      float y = (i & 2) ? 1.0f : -1.0f;
+      Eigen::Vector4f near = unproject(x, y, near_z);
+      Eigen::Vector3f origin = Dehomogenize(near);
+      Eigen::Vector3f direction = Dehomogenize(unproject(x, y, 0.5f)) - origin;
+
+      // t 以 direction 为单位：先按 max_distance 截断，远平面有限且更近时用远平面
+      float t = max_distance / direction.dot(axis);
+      Eigen::Vector4f far = unproject(x, y, far_z);
+      if (std::abs(far.w()) > 1e-6f * std::abs(near.w()))
+        t = std::min(t, (Dehomogenize(far) - origin).dot(direction) / direction.squaredNorm());
+
+      corners[i] = origin;
+      corners[i | 4] = origin + direction * t;
+    }
+    Edges(corners, color);
+  }
+
+  // 结束写入，返回所有非空批次
+  const std::vector<Batch> &Finish() {
+    CloseBatch();
+    return batches_;
+  }
+
+  uint32_t size() const { return count_; }
+  uint32_t capacity() const { return capacity_; }
+  uint64_t dropped() const { return dropped_; }
+  const std::vector<Batch> &batches() const { return batches_; }
+
+ private:
+  static Eigen::Vector3f Dehomogenize(const Eigen::Vector4f &p) { return p.head<3>() / p.w(); }
+
+  // corners 按 x、y、z 三位编号
+  void Edges(const Eigen::Vector3f *corners, uint32_t color) {
+    static const uint8_t edges[12][2] = {{0, 1}, {2, 3}, {4, 5}, {6, 7}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+    for (const auto &e : edges)
+      Line(corners[e[0]], corners[e[1]], color);
+  }
+
+  void CloseBatch() {
+    if (count_ > batch_first_)
+      batches_.push_back({batch_first_, count_ - batch_first_, width_});
+    batch_first_ = count_;
+  }
+
+  Segment *data_{};
+  uint32_t capacity_{};
+  uint32_t count_{};
+  uint64_t dropped_{};
+  float width_{1.0f};
+  uint32_t batch_first_{};
+  std::vector<Batch> batches_;
+};
+
+}  // namespace e3d::lines
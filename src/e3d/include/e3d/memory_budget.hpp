@@ -0,0 +1,210 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+namespace e3d {
+
+enum class MemoryCategory : uint32_t {
+  kGeometry,
+  kUniforms,
+  kTextures,
+  kStaging,
+  kRenderTargets,
+  kOther,
+  kCount,
+};
+
+inline const char *Name(MemoryCategory category) {
+  static const char *names[] = {"geometry", "uniforms", "textures", "staging", "render targets", "other"};
+  return names[size_t(category)];
+}
+
+// 显存预算：按堆和内存类型统计引擎自己的分配，设备支持 VK_EXT_memory_budget 时用驱动报告的
+// 预算和用量（包含其它进程和驱动内部的分配），否则以堆大小的一部分作为预算、以引擎的统计作为用量。
+// 软预算之上流送系统应主动逐出，硬预算留给驱动换页之前的最后余量。
+class MemoryBudget {
+ public:
+  struct Options {
+    float soft_fraction = 0.8f;             // 软预算占堆预算的比例
+    float hard_fraction = 0.95f;            // 硬预算占堆预算的比例
+    float fallback_budget_fraction = 0.8f;  // 没有扩展时，预算取堆大小的该比例
+  };
+
+  enum class Pressure {
+    kNone,
+    kSoft,  // 超过软预算，流送系统应逐出
+    kHard,  // 超过硬预算，继续分配可能导致驱动换页或分配失败
+  };
+
+  struct HeapUsage {
+    VkDeviceSize size{};
+    VkDeviceSize budget{};
+    VkDeviceSize usage{};         // 整个堆的用量，有扩展时包含其它进程
+    VkDeviceSize engine_usage{};  // 引擎自己的分配
+    bool device_local{};
+  };
+
+  MemoryBudget(VkPhysicalDevice physical_device, bool use_extension) : MemoryBudget(physical_device, use_extension, Options{}) {}
+  MemoryBudget(VkPhysicalDevice physical_device, bool use_extension, const Options &options)
+      : physical_device_(physical_device), use_extension_(use_extension), options_(options) {
+    vkGetPhysicalDeviceMemoryProperties(physical_device_, &properties_);
+    for (uint32_t i = 0; i < properties_.memoryHeapCount; ++i) {
+      heaps_[i].size = properties_.memoryHeaps[i].size;
+      heaps_[i].budget = VkDeviceSize(double(heaps_[i].size) * options_.fallback_budget_fraction);
+      heaps_[i].device_local = (properties_.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+    Update();
+  }
+
+  MemoryBudget(const MemoryBudget &) = delete;
+  MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+  bool uses_extension() const { return use_extension_; }
+  const Options &options() const { return options_; }
+  uint32_t heap_count() const { return properties_.memoryHeapCount; }
+  uint32_t HeapOfType(uint32_t type_index) const { return properties_.memoryTypes[type_index].heapIndex; }
+
+  // 重新读取驱动报告的预算和用量，每帧调用一次即可
+  void Update() {
+    if (!use_extension_)
+      return;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budget;
+    vkGetPhysicalDeviceMemoryProperties2(physical_device_, &properties);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t i = 0; i < properties_.memoryHeapCount; ++i) {
+      heaps_[i].budget = budget.heapBudget[i];
+      driver_usage_[i] = budget.heapUsage[i];
+      engine_usage_at_update_[i] = heaps_[i].engine_usage;
+    }
+  }
+
+  void OnAllocate(VkDeviceMemory memory, uint32_t type_index, VkDeviceSize size, MemoryCategory category) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    allocations_[memory] = {type_index, size, category};
+    heaps_[HeapOfType(type_index)].engine_usage += size;
+    type_usage_[type_index] += size;
+    category_usage_[size_t(category)] += size;
+  }
+
+  void OnFree(VkDeviceMemory memory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = allocations_.find(memory);
+    if (it == allocations_.end())
+      return;
+    const auto &a = it->second;
+    heaps_[HeapOfType(a.type_index)].engine_usage -= a.size;
+    type_usage_[a.type_index] -= a.size;
+    category_usage_[size_t(a.category)] -= a.size;
+    allocations_.erase(it);
+  }
+
+  HeapUsage heap(uint32_t heap_index) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return HeapLocked(heap_index);
+  }
+
+  VkDeviceSize type_usage(uint32_t type_index) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return type_usage_[type_index];
+  }
+
+  VkDeviceSize category_usage(MemoryCategory category) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return category_usage_[size_t(category)];
+  }
+
+  VkDeviceSize SoftLimit(uint32_t heap_index) const { return VkDeviceSize(double(heap(heap_index).budget) * options_.soft_fraction); }
+  VkDeviceSize HardLimit(uint32_t heap_index) const { return VkDeviceSize(double(heap(heap_index).budget) * options_.hard_fraction); }
+
+  Pressure HeapPressure(uint32_t heap_index) const {
+    auto usage = heap(heap_index).usage;
+    if (usage > HardLimit(heap_index))
+      return Pressure::kHard;
+    if (usage > SoftLimit(heap_index))
+      return Pressure::kSoft;
+    return Pressure::kNone;
+  }
+
+  // 该堆在软预算内还能分配的字节数，已超出时为 0
+  VkDeviceSize Available(uint32_t heap_index) const {
+    auto usage = heap(heap_index).usage;
+    auto limit = SoftLimit(heap_index);
+    return usage < limit ? limit - usage : 0;
+  }
+
+  // 在 type_index 上再分配 size 字节是否会超过硬预算
+  bool ExceedsHardLimit(uint32_t type_index, VkDeviceSize size) const {
+    uint32_t heap_index = HeapOfType(type_index);
+    return heap(heap_index).usage + size > HardLimit(heap_index);
+  }
+
+  // 所有设备本地堆中软预算余量最小的一个，流送系统据此收缩自己的预算
+  VkDeviceSize DeviceLocalAvailable() const {
+    VkDeviceSize available = VK_WHOLE_SIZE;
+    for (uint32_t i = 0; i < heap_count(); ++i)
+      if (heap(i).device_local)
+        available = std::min(available, Available(i));
+    return available;
+  }
+
+  void Report(std::ostream &os) const {
+    constexpr double kMiB = 1.0 / (1024.0 * 1024.0);
+    os << "memory budget (" << (use_extension_ ? "VK_EXT_memory_budget" : "engine tally") << "):\n";
+    for (uint32_t i = 0; i < heap_count(); ++i) {
+      auto h = heap(i);
+      os << "  heap " << i << (h.device_local ? " device-local" : " host") << ": usage " << double(h.usage) * kMiB << " MiB (engine "
+         << double(h.engine_usage) * kMiB << ") / budget " << double(h.budget) * kMiB << " MiB / size " << double(h.size) * kMiB << " MiB\n";
+    }
+    os << " ";
+    for (size_t c = 0; c < size_t(MemoryCategory::kCount); ++c)
+      os << " " << Name(MemoryCategory(c)) << "=" << double(category_usage(MemoryCategory(c))) * kMiB << " MiB";
+    os << "\n";
+  }
+
+ private:
+  struct Allocation {
+    uint32_t type_index;
+    VkDeviceSize size;
+    MemoryCategory category;
+  };
+
+  // 驱动报告的用量只在 Update 时刷新，两次刷新之间加上引擎自己新增的分配
+  HeapUsage HeapLocked(uint32_t heap_index) const {
+    HeapUsage h = heaps_[heap_index];
+    if (use_extension_) {
+      int64_t delta = int64_t(h.engine_usage) - int64_t(engine_usage_at_update_[heap_index]);
+      h.usage = VkDeviceSize(std::max<int64_t>(0, int64_t(driver_usage_[heap_index]) + delta));
+    } else {
+      h.usage = h.engine_usage;
+    }
+    return h;
+  }
+
+  VkPhysicalDevice physical_device_;
+  bool use_extension_;
+  Options options_;
+  VkPhysicalDeviceMemoryProperties properties_{};
+
+  mutable std::mutex mutex_;
+  std::array<HeapUsage, VK_MAX_MEMORY_HEAPS> heaps_{};
+  std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> driver_usage_{};
+  std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> engine_usage_at_update_{};
+  std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> type_usage_{};
+  std::array<VkDeviceSize, size_t(MemoryCategory::kCount)> category_usage_{};
+  std::unordered_map<VkDeviceMemory, Allocation> allocations_;
+};
+
+}  // namespace e3d
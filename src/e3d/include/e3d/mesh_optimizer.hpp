@@ -0,0 +1,370 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace e3d {
+
+namespace meshopt {
+
+// 顶点缓存模拟结果。ACMR = 变换顶点数 / 三角形数，ATVR = 变换顶点数 / 唯一顶点数，两者越小越好。
+struct VertexCacheStats {
+  uint32_t vertices_transformed{};
+  uint32_t triangles{};
+  uint32_t unique_vertices{};
+  float acmr{};
+  float atvr{};
+};
+
+// 用 FIFO 缓存模拟 GPU 的 post-transform 顶点缓存，统计 ACMR/ATVR，不依赖 GPU 即可验证优化效果。
+template <typename Index>
+inline VertexCacheStats AnalyzeVertexCache(const std::vector<Index> &indices, size_t vertex_count, uint32_t cache_size = 16) {
+  VertexCacheStats stats{};
+  std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+  std::vector<bool> referenced(vertex_count, false);
+  uint32_t timestamp = cache_size + 1;
+
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    for (size_t k = 0; k < 3; ++k) {
+      uint32_t v = static_cast<uint32_t>(indices[i + k]);
+      if (timestamp - cache_timestamps[v] > cache_size) {
+        // 未命中：顶点重新变换并进入 FIFO 队尾
+        cache_timestamps[v] = timestamp++;
+        stats.vertices_transformed++;
+      }
+      if (!referenced[v]) {
+        referenced[v] = true;
+        stats.unique_vertices++;
+      }
+    }
+    stats.triangles++;
+  }
+
+  stats.acmr = stats.triangles == 0 ? 0.0f : float(stats.vertices_transformed) / stats.triangles;
+  stats.atvr = stats.unique_vertices == 0 ? 0.0f : float(stats.vertices_transformed) / stats.unique_vertices;
+  return stats;
+}
+
+namespace detail {
+
+// Forsyth 评分参数，参见 "Linear-Speed Vertex Cache Optimisation"。
+constexpr int kForsythCacheSize = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriScore = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+inline float VertexScore(int cache_position, uint32_t remaining_valence) {
+  if (remaining_valence == 0)
+    return -1.0f;
+
+  float score = 0.0f;
+  if (cache_position >= 0) {
+    if (cache_position < 3) {
+      // 刚用过的三个顶点分数固定，避免偏向同一三角形的某条边
+      score = kLastTriScore;
+    } else {
+      const float scaler = 1.0f / (kForsythCacheSize - 3);
+      score = std::pow(1.0f - (cache_position - 3) * scaler, kCacheDecayPower);
+    }
+  }
+
+  // 剩余三角形越少的顶点优先级越高，尽快把孤立三角形消耗掉
+  score += kValenceBoostScale * std::pow(static_cast<float>(remaining_valence), -kValenceBoostPower);
+  return score;
+}
+
+// 顶点到三角形的邻接表（CSR 存储）
+struct TriangleAdjacency {
+  std::vector<uint32_t> counts;
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> data;
+
+  template <typename Index>
+  void Build(const std::vector<Index> &indices, size_t vertex_count) {
+    size_t triangle_count = indices.size() / 3;
+    counts.assign(vertex_count, 0);
+    offsets.assign(vertex_count, 0);
+    data.resize(triangle_count * 3);
+
+    for (size_t i = 0; i < triangle_count * 3; ++i)
+      counts[indices[i]]++;
+
+    uint32_t offset = 0;
+    for (size_t v = 0; v < vertex_count; ++v) {
+      offsets[v] = offset;
+      offset += counts[v];
+    }
+
+    std::vector<uint32_t> fill(offsets);
+    for (size_t t = 0; t < triangle_count; ++t)
+      for (size_t k = 0; k < 3; ++k)
+        data[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+  }
+};
+
+}  // namespace detail
+
+// 按 Forsyth 算法重排三角形，提高 post-transform 顶点缓存命中率。
+template <typename Index>
+inline std::vector<Index> OptimizeVertexCache(const std::vector<Index> &indices, size_t vertex_count) {
+  const size_t triangle_count = indices.size() / 3;
+  std::vector<Index> result;
+  result.reserve(triangle_count * 3);
+  if (triangle_count == 0)
+    return result;
+
+  detail::TriangleAdjacency adjacency;
+  adjacency.Build(indices, vertex_count);
+
+  // live_triangles 随着三角形输出递减，即顶点剩余的度
+  std::vector<uint32_t> live_triangles(adjacency.counts);
+  std::vector<float> vertex_score(vertex_count);
+  for (size_t v = 0; v < vertex_count; ++v)
+    vertex_score[v] = detail::VertexScore(-1, live_triangles[v]);
+
+  std::vector<float> triangle_score(triangle_count);
+  std::vector<bool> emitted(triangle_count, false);
+  for (size_t t = 0; t < triangle_count; ++t)
+    triangle_score[t] = vertex_score[indices[t * 3 + 0]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> new_cache;
+  cache.reserve(detail::kForsythCacheSize + 3);
+  new_cache.reserve(detail::kForsythCacheSize + 3);
+
+  size_t input_cursor = 0;
+  size_t best_triangle = 0;
+  for (size_t t = 1; t < triangle_count; ++t)
+    if (triangle_score[t] > triangle_score[best_triangle])
+      best_triangle = t;
+
+  for (size_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+    // 缓存中没有可用的三角形时，按输入顺序取下一个未输出的三角形
+    if (best_triangle == SIZE_MAX) {
+      while (emitted[input_cursor])
+        ++input_cursor;
+      best_triangle = input_cursor;
+    }
+
+    const uint32_t a = static_cast<uint32_t>(indices[best_triangle * 3 + 0]);
+    const uint32_t b = static_cast<uint32_t>(indices[best_triangle * 3 + 1]);
+    const uint32_t c = static_cast<uint32_t>(indices[best_triangle * 3 + 2]);
+    result.push_back(static_cast<Index>(a));
+    result.push_back(static_cast<Index>(b));
+    result.push_back(static_cast<Index>(c));
+    emitted[best_triangle] = true;
+
+    // 更新 LRU 缓存：新三角形的顶点放在最前面
+    new_cache.clear();
+    new_cache.push_back(a);
+    new_cache.push_back(b);
+    new_cache.push_back(c);
+    for (uint32_t v : cache)
+      if (v != a && v != b && v != c)
+        new_cache.push_back(v);
+
+    // 从顶点邻接表中移除已输出的三角形
+    for (uint32_t v : {a, b, c}) {
+      uint32_t *begin = &adjacency.data[adjacency.offsets[v]];
+      uint32_t *end = begin + live_triangles[v];
+      uint32_t *it = std::find(begin, end, static_cast<uint32_t>(best_triangle));
+      if (it != end) {
+        *it = *(end - 1);
+        live_triangles[v]--;
+      }
+    }
+
+    // 挤出缓存的顶点重新计分
+    for (size_t i = detail::kForsythCacheSize; i < new_cache.size(); ++i) {
+      uint32_t v = new_cache[i];
+      float score = detail::VertexScore(-1, live_triangles[v]);
+      float delta = score - vertex_score[v];
+      vertex_score[v] = score;
+
+      const uint32_t *adj = &adjacency.data[adjacency.offsets[v]];
+      for (uint32_t k = 0; k < live_triangles[v]; ++k)
+        triangle_score[adj[k]] += delta;
+    }
+    if (new_cache.size() > detail::kForsythCacheSize)
+      new_cache.resize(detail::kForsythCacheSize);
+    cache.swap(new_cache);
+
+    // 更新缓存内顶点及其相邻三角形的分数，同时挑选下一个最佳三角形
+    for (size_t i = 0; i < cache.size(); ++i) {
+      uint32_t v = cache[i];
+      float score = detail::VertexScore(static_cast<int>(i), live_triangles[v]);
+      float delta = score - vertex_score[v];
+      vertex_score[v] = score;
+
+      const uint32_t *adj = &adjacency.data[adjacency.offsets[v]];
+      for (uint32_t k = 0; k < live_triangles[v]; ++k)
+        triangle_score[adj[k]] += delta;
+    }
+
+    best_triangle = SIZE_MAX;
+    float best_score = -1.0f;
+    for (uint32_t v : cache) {
+      const uint32_t *adj = &adjacency.data[adjacency.offsets[v]];
+      for (uint32_t k = 0; k < live_triangles[v]; ++k) {
+        if (triangle_score[adj[k]] > best_score) {
+          best_score = triangle_score[adj[k]];
+          best_triangle = adj[k];
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+// 按 Sander 等人 "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" 的思路，
+// 先把已优化缓存的索引切分成簇，再按簇朝外程度排序，使靠外的面先画，减少 overdraw。
+// threshold 控制允许的 ACMR 退化，1.05 表示最多变差 5%。
+template <typename Index, typename PositionFn>
+inline std::vector<Index> OptimizeOverdraw(const std::vector<Index> &indices, size_t vertex_count, PositionFn &&position, float threshold = 1.05f,
+                                           uint32_t cache_size = 16) {
+  const size_t triangle_count = indices.size() / 3;
+  if (triangle_count == 0)
+    return indices;
+
+  // 模拟缓存，记录每个三角形的未命中次数，3 次未命中的位置是天然的簇边界
+  std::vector<uint32_t> cluster_starts;
+  {
+    std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+    uint32_t timestamp = cache_size + 1;
+    uint32_t cluster_misses = 0;
+    uint32_t cluster_start = 0;
+    uint32_t total_misses = 0;
+
+    for (size_t t = 0; t < triangle_count; ++t) {
+      uint32_t misses = 0;
+      for (size_t k = 0; k < 3; ++k) {
+        uint32_t v = static_cast<uint32_t>(indices[t * 3 + k]);
+        if (timestamp - cache_timestamps[v] > cache_size) {
+          cache_timestamps[v] = timestamp++;
+          misses++;
+        }
+      }
+      total_misses += misses;
+
+      // 硬边界：缓存被完全刷新；软边界：当前簇 ACMR 已经低于整体 ACMR 的 threshold 倍以内
+      bool hard_boundary = (misses == 3);
+      uint32_t cluster_triangles = static_cast<uint32_t>(t) - cluster_start;
+      float total_acmr = float(total_misses) / float(t + 1);
+      bool soft_boundary = cluster_triangles > 0 && float(cluster_misses) / cluster_triangles <= total_acmr * threshold;
+
+      if (t == 0 || hard_boundary || soft_boundary) {
+        cluster_starts.push_back(static_cast<uint32_t>(t));
+        cluster_start = static_cast<uint32_t>(t);
+        cluster_misses = 0;
+      }
+      cluster_misses += misses;
+    }
+  }
+
+  // 计算网格质心
+  Eigen::Vector3f mesh_centroid = Eigen::Vector3f::Zero();
+  for (size_t i = 0; i < indices.size(); ++i)
+    mesh_centroid += position(static_cast<uint32_t>(indices[i]));
+  mesh_centroid /= static_cast<float>(indices.size());
+
+  // 簇排序键：簇质心相对网格质心的偏移在簇平均法线上的投影，越朝外越先画
+  const size_t cluster_count = cluster_starts.size();
+  std::vector<float> sort_keys(cluster_count);
+  for (size_t c = 0; c < cluster_count; ++c) {
+    size_t begin = cluster_starts[c];
+    size_t end = c + 1 < cluster_count ? cluster_starts[c + 1] : triangle_count;
+
+    Eigen::Vector3f centroid = Eigen::Vector3f::Zero();
+    Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+    float area = 0.0f;
+    for (size_t t = begin; t < end; ++t) {
+      Eigen::Vector3f p0 = position(static_cast<uint32_t>(indices[t * 3 + 0]));
+      Eigen::Vector3f p1 = position(static_cast<uint32_t>(indices[t * 3 + 1]));
+      Eigen::Vector3f p2 = position(static_cast<uint32_t>(indices[t * 3 + 2]));
+      Eigen::Vector3f n = (p1 - p0).cross(p2 - p0);
+      float a = n.norm();
+      centroid += (p0 + p1 + p2) * (a / 3.0f);
+      normal += n;
+      area += a;
+    }
+    if (area > 0.0f)
+      centroid /= area;
+    if (normal.squaredNorm() > 0.0f)
+      normal.normalize();
+
+    sort_keys[c] = (centroid - mesh_centroid).dot(normal);
+  }
+
+  std::vector<uint32_t> cluster_order(cluster_count);
+  for (size_t c = 0; c < cluster_count; ++c)
+    cluster_order[c] = static_cast<uint32_t>(c);
+  std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](uint32_t l, uint32_t r) { return sort_keys[l] > sort_keys[r]; });
+
+  std::vector<Index> result;
+  result.reserve(indices.size());
+  for (uint32_t c : cluster_order) {
+    size_t begin = cluster_starts[c];
+    size_t end = c + 1 < cluster_count ? cluster_starts[c + 1] : triangle_count;
+    result.insert(result.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+  }
+  return result;
+}
+
+// 按索引首次引用的顺序重排顶点，提高顶点拉取的内存局部性；未被引用的顶点被丢弃。
+// 返回新的顶点数组，indices 被原地改写为新的编号。
+template <typename VertexT, typename Index>
+inline std::vector<VertexT> OptimizeVertexFetch(const std::vector<VertexT> &vertices, std::vector<Index> &indices) {
+  constexpr uint32_t kUnused = UINT32_MAX;
+  std::vector<uint32_t> remap(vertices.size(), kUnused);
+  std::vector<VertexT> result;
+  result.reserve(vertices.size());
+
+  for (auto &index : indices) {
+    uint32_t &target = remap[static_cast<uint32_t>(index)];
+    if (target == kUnused) {
+      target = static_cast<uint32_t>(result.size());
+      result.push_back(vertices[static_cast<uint32_t>(index)]);
+    }
+    index = static_cast<Index>(target);
+  }
+
+  return result;
+}
+
+// 网格优化前后的缓存统计
+struct MeshOptimizationReport {
+  VertexCacheStats before;
+  VertexCacheStats after;
+
+  void Print(std::ostream &os, const char *name) const {
+    os << "Mesh optimization [" << name << "]: ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr
+       << " (" << after.triangles << " triangles, " << after.unique_vertices << " vertices)" << std::endl;
+  }
+};
+
+// 资源管线中的网格优化阶段：顶点缓存 -> overdraw -> 顶点拉取，结果原地写回。
+template <typename VertexT, typename Index, typename PositionFn>
+inline MeshOptimizationReport OptimizeMesh(std::vector<VertexT> &vertices, std::vector<Index> &indices, PositionFn &&position,
+                                           float overdraw_threshold = 1.05f) {
+  MeshOptimizationReport report;
+  report.before = AnalyzeVertexCache(indices, vertices.size());
+
+  indices = OptimizeVertexCache(indices, vertices.size());
+  indices = OptimizeOverdraw(indices, vertices.size(), [&](uint32_t i) -> Eigen::Vector3f { return position(vertices[i]); }, overdraw_threshold);
+  vertices = OptimizeVertexFetch(vertices, indices);
+
+  report.after = AnalyzeVertexCache(indices, vertices.size());
+  return report;
+}
+
+}  // namespace meshopt
+
+}  // namespace e3d
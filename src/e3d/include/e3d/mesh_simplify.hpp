@@ -0,0 +1,392 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+#include "mesh_optimizer.hpp"
+
+namespace e3d {
+
+namespace meshopt {
+
+namespace detail {
+
+// 对称 4x4 二次误差矩阵，只存上三角 10 个元素。weight 为累加的权重，用于把加权平方和归一化成平方距离
+struct Quadric {
+  double a00{}, a01{}, a02{}, a03{};
+  double a11{}, a12{}, a13{};
+  double a22{}, a23{};
+  double a33{};
+  double weight{};
+
+  static Quadric FromPlane(const Eigen::Vector3d &n, double d, double weight) {
+    Quadric q;
+    q.a00 = n.x() * n.x() * weight;
+    q.a01 = n.x() * n.y() * weight;
+    q.a02 = n.x() * n.z() * weight;
+    q.a03 = n.x() * d * weight;
+    q.a11 = n.y() * n.y() * weight;
+    q.a12 = n.y() * n.z() * weight;
+    q.a13 = n.y() * d * weight;
+    q.a22 = n.z() * n.z() * weight;
+    q.a23 = n.z() * d * weight;
+    q.a33 = d * d * weight;
+    q.weight = weight;
+    return q;
+  }
+
+  Quadric &operator+=(const Quadric &o) {
+    a00 += o.a00, a01 += o.a01, a02 += o.a02, a03 += o.a03;
+    a11 += o.a11, a12 += o.a12, a13 += o.a13;
+    a22 += o.a22, a23 += o.a23;
+    a33 += o.a33;
+    weight += o.weight;
+    return *this;
+  }
+
+  // vᵀQv，v = (x, y, z, 1)
+  double Error(const Eigen::Vector3d &p) const {
+    double x = p.x(), y = p.y(), z = p.z();
+    return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y + a22 * z * z +
+           2 * a23 * z + a33;
+  }
+
+  // p 到各平面的加权均方距离，单位是长度的平方，与网格尺度和面积权重无关
+  double SquaredDistance(const Eigen::Vector3d &p) const { return weight > 0.0 ? std::max(Error(p), 0.0) / weight : 0.0; }
+};
+
+struct Collapse {
+  double cost;
+  uint32_t from;
+  uint32_t to;
+  uint32_t version;
+
+  bool operator<(const Collapse &o) const { return cost > o.cost; }  // 小顶堆
+};
+
+}  // namespace detail
+
+// 基于二次误差度量 (Garland-Heckbert) 的半边折叠简化。顶点只会折叠到已有顶点上，
+// 因此结果可以直接复用原顶点缓冲。返回新的索引，result_error 为对象空间下的几何误差：
+// 折叠后的顶点到它所代表的原始平面的加权均方根距离，取所有折叠中的最大值。target_error 使用同样的单位。
+template <typename Index, typename PositionFn>
+inline std::vector<Index> SimplifyMesh(const std::vector<Index> &indices, size_t vertex_count, PositionFn &&position, size_t target_index_count,
+                                       float target_error, float *result_error = nullptr) {
+  const size_t triangle_count = indices.size() / 3;
+
+  std::vector<Eigen::Vector3d> positions(vertex_count);
+  for (size_t v = 0; v < vertex_count; ++v)
+    positions[v] = position(static_cast<uint32_t>(v)).template cast<double>();
+
+  std::vector<std::array<uint32_t, 3>> triangles(triangle_count);
+  std::vector<bool> triangle_alive(triangle_count, true);
+  std::vector<std::vector<uint32_t>> vertex_triangles(vertex_count);
+  for (size_t t = 0; t < triangle_count; ++t) {
+    for (size_t k = 0; k < 3; ++k) {
+      triangles[t][k] = static_cast<uint32_t>(indices[t * 3 + k]);
+      vertex_triangles[triangles[t][k]].push_back(static_cast<uint32_t>(t));
+    }
+  }
+
+  // 面平面的二次误差，按面积加权
+  std::vector<detail::Quadric> quadrics(vertex_count);
+  for (const auto &tri : triangles) {
+    Eigen::Vector3d n = (positions[tri[1]] - positions[tri[0]]).cross(positions[tri[2]] - positions[tri[0]]);
+    double area = n.norm();
+    if (area <= 0.0)
+      continue;
+    n /= area;
+    auto q = detail::Quadric::FromPlane(n, -n.dot(positions[tri[0]]), area * 0.5);
+    for (uint32_t v : tri)
+      quadrics[v] += q;
+  }
+
+  // 开放边界加垂直约束平面，防止轮廓收缩
+  {
+    std::vector<std::pair<uint64_t, uint32_t>> edges;
+    edges.reserve(triangle_count * 3);
+    for (size_t t = 0; t < triangle_count; ++t) {
+      for (size_t k = 0; k < 3; ++k) {
+        uint32_t a = triangles[t][k], b = triangles[t][(k + 1) % 3];
+        uint64_t key = a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+        edges.push_back({key, static_cast<uint32_t>(t)});
+      }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size(); ++i) {
+      bool shared = (i > 0 && edges[i - 1].first == edges[i].first) || (i + 1 < edges.size() && edges[i + 1].first == edges[i].first);
+      if (shared)
+        continue;
+
+      uint32_t a = static_cast<uint32_t>(edges[i].first >> 32), b = static_cast<uint32_t>(edges[i].first & 0xFFFFFFFF);
+      const auto &tri = triangles[edges[i].second];
+      Eigen::Vector3d face_normal = (positions[tri[1]] - positions[tri[0]]).cross(positions[tri[2]] - positions[tri[0]]);
+      Eigen::Vector3d edge = positions[b] - positions[a];
+      Eigen::Vector3d n = edge.cross(face_normal);
+      double length = n.norm();
+      if (length <= 0.0)
+        continue;
+      n /= length;
+      auto q = detail::Quadric::FromPlane(n, -n.dot(positions[a]), edge.squaredNorm() * 10.0);
+      quadrics[a] += q;
+      quadrics[b] += q;
+    }
+  }
+
+  std::vector<uint32_t> remap(vertex_count);
+  std::vector<uint32_t> version(vertex_count, 0);
+  for (size_t v = 0; v < vertex_count; ++v)
+    remap[v] = static_cast<uint32_t>(v);
+
+  std::priority_queue<detail::Collapse> heap;
+  auto push_edge = [&](uint32_t a, uint32_t b) {
+    detail::Quadric q = quadrics[a];
+    q += quadrics[b];
+    double cost_ab = q.SquaredDistance(positions[b]);
+    double cost_ba = q.SquaredDistance(positions[a]);
+    if (cost_ab <= cost_ba)
+      heap.push({cost_ab, a, b, version[a] + version[b]});
+    else
+      heap.push({cost_ba, b, a, version[a] + version[b]});
+  };
+
+  for (const auto &tri : triangles)
+    for (size_t k = 0; k < 3; ++k)
+      if (tri[k] < tri[(k + 1) % 3])
+        push_edge(tri[k], tri[(k + 1) % 3]);
+
+  // 折叠后相邻三角形若翻转或退化为细长三角形则拒绝
+  auto collapse_flips = [&](uint32_t from, uint32_t to) {
+    for (uint32_t t : vertex_triangles[from]) {
+      if (!triangle_alive[t])
+        continue;
+      const auto &tri = triangles[t];
+      if (tri[0] == to || tri[1] == to || tri[2] == to)
+        continue;
+
+      Eigen::Vector3d p[3], q[3];
+      for (size_t k = 0; k < 3; ++k) {
+        p[k] = positions[tri[k]];
+        q[k] = tri[k] == from ? positions[to] : p[k];
+      }
+      Eigen::Vector3d n0 = (p[1] - p[0]).cross(p[2] - p[0]);
+      Eigen::Vector3d n1 = (q[1] - q[0]).cross(q[2] - q[0]);
+      if (n0.dot(n1) <= 0.25 * n0.norm() * n1.norm())
+        return true;
+    }
+    return false;
+  };
+
+  const double max_error = double(target_error) * double(target_error);
+  double current_error = 0.0;
+  size_t live_triangles = triangle_count;
+
+  while (live_triangles * 3 > target_index_count && !heap.empty()) {
+    detail::Collapse c = heap.top();
+    heap.pop();
+
+    if (remap[c.from] != c.from || remap[c.to] != c.to || version[c.from] + version[c.to] != c.version)
+      continue;
+    if (c.cost > max_error)
+      break;
+    if (collapse_flips(c.from, c.to))
+      continue;
+
+    remap[c.from] = c.to;
+    quadrics[c.to] += quadrics[c.from];
+    version[c.to]++;
+    current_error = std::max(current_error, c.cost);
+
+    for (uint32_t t : vertex_triangles[c.from]) {
+      if (!triangle_alive[t])
+        continue;
+      auto &tri = triangles[t];
+      for (auto &v : tri)
+        if (v == c.from)
+          v = c.to;
+      if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0]) {
+        triangle_alive[t] = false;
+        live_triangles--;
+      } else {
+        vertex_triangles[c.to].push_back(t);
+      }
+    }
+    vertex_triangles[c.from].clear();
+
+    // 重新计算 to 周围所有边的代价
+    for (uint32_t t : vertex_triangles[c.to]) {
+      if (!triangle_alive[t])
+        continue;
+      for (uint32_t v : triangles[t])
+        if (v != c.to)
+          push_edge(c.to, v);
+    }
+  }
+
+  std::vector<Index> result;
+  result.reserve(live_triangles * 3);
+  for (size_t t = 0; t < triangle_count; ++t) {
+    if (!triangle_alive[t])
+      continue;
+    for (uint32_t v : triangles[t])
+      result.push_back(static_cast<Index>(v));
+  }
+
+  if (result_error)
+    *result_error = static_cast<float>(std::sqrt(current_error));
+  return result;
+}
+
+// 一级 LOD 在共享索引缓冲中的位置，error 为对象空间误差
+struct MeshLod {
+  uint32_t index_offset;
+  uint32_t index_count;
+  float error;
+};
+
+// 离线生成 LOD 链：每级目标三角形数按 reduction 递减，所有级别拼接进同一个索引数组，共享同一份顶点。
+// 调用后 indices 被替换为拼接结果，返回每一级的范围。
+template <typename Index, typename PositionFn>
+inline std::vector<MeshLod> BuildLodChain(std::vector<Index> &indices, size_t vertex_count, PositionFn &&position, uint32_t max_lods = 4,
+                                          float reduction = 0.5f, float max_error = 1e30f) {
+  std::vector<MeshLod> lods;
+  std::vector<Index> combined = indices;
+  lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+
+  std::vector<Index> source = indices;
+  float accumulated_error = 0.0f;
+  for (uint32_t level = 1; level < max_lods; ++level) {
+    size_t target = static_cast<size_t>(source.size() / 3 * reduction) * 3;
+    if (target < 3)
+      break;
+
+    float error = 0.0f;
+    std::vector<Index> lod = SimplifyMesh(source, vertex_count, position, target, max_error, &error);
+    if (lod.empty() || lod.size() >= source.size())
+      break;
+
+    // 每级只度量到上一级的距离，相加得到到原始网格距离的上界，LOD 链的误差也因此单调递增
+    accumulated_error += error;
+    lod = OptimizeVertexCache(lod, vertex_count);
+
+    lods.push_back({static_cast<uint32_t>(combined.size()), static_cast<uint32_t>(lod.size()), accumulated_error});
+    combined.insert(combined.end(), lod.begin(), lod.end());
+    source = std::move(lod);
+  }
+
+  indices = std::move(combined);
+  return lods;
+}
+
+// 运行时 LOD 选择：把对象空间误差投影到屏幕像素，选择误差不超过阈值的最粗一级。
+// 带滞回区间避免在阈值附近来回跳变，并用全局三角形预算约束远处大量对象的开销。
+class LodSelector {
+ public:
+  float pixel_error_threshold{1.0f};  // 允许的屏幕空间误差（像素）
+  float hysteresis{0.25f};            // 向更粗一级切换时需要低于阈值的比例
+  float min_pixel_radius{0.5f};       // 投影半径小于此值的对象直接剔除
+  uint64_t triangle_budget{4000000};  // 每帧提交的三角形上限，对象数增加时靠粗化和放弃远处对象保持在此之内
+
+  struct Object {
+    Eigen::Vector3f center;  // 世界空间包围球
+    float radius;
+    const std::vector<MeshLod> *lods;
+    int lod{0};  // 上一帧选择的级别，-1 表示被剔除
+  };
+
+  // proj 为 helper::Perspective 的结果，proj(1,1) = 1 / tan(fov / 2)
+  void SetCamera(const Eigen::Matrix4f &view, const Eigen::Matrix4f &proj, uint32_t viewport_height) {
+    view_ = view;
+    pixels_per_unit_ = std::abs(proj(1, 1)) * 0.5f * static_cast<float>(viewport_height);
+
+    // 近平面距离：视线深度 d 处的 NDC 深度为 (-p22 d + p23) / (-p32 d + p33)，取 z = 0 和 z = 1（Vulkan 深度范围）两处中较小的正深度，
+    // 正向、反向 Z 和无穷远平面都适用
+    near_ = 0.0f;
+    for (float z : {0.0f, 1.0f}) {
+      float depth = (proj(2, 3) - z * proj(3, 3)) / (proj(2, 2) - z * proj(3, 2));
+      if (depth > 0.0f && std::isfinite(depth))
+        near_ = near_ > 0.0f ? std::min(near_, depth) : depth;
+    }
+  }
+
+  // 对象空间误差 error 在距离 distance 处投影后的像素数
+  float ProjectError(float error, float distance) const { return error * pixels_per_unit_ / std::max(distance, 1e-4f); }
+
+  int Select(Object &object) const {
+    float distance = ViewDistance(object);
+    if (distance < 0.0f || ProjectError(object.radius, distance) < min_pixel_radius)
+      return object.lod = -1;
+
+    const auto &lods = *object.lods;
+    int current = std::clamp(object.lod, 0, static_cast<int>(lods.size()) - 1);
+    int lod = current;
+
+    // 当前级别误差超过阈值时细化
+    while (lod > 0 && ProjectError(lods[lod].error, distance) > pixel_error_threshold)
+      lod--;
+    // 更粗一级误差足够小时才粗化
+    while (lod + 1 < static_cast<int>(lods.size()) && ProjectError(lods[lod + 1].error, distance) < pixel_error_threshold * (1.0f - hysteresis))
+      lod++;
+
+    return object.lod = lod;
+  }
+
+  // 选择所有对象的 LOD，超出三角形预算时从屏幕上最小的对象开始逐级粗化。返回提交的三角形数。
+  uint64_t SelectAll(std::vector<Object> &objects) const {
+    uint64_t triangles = 0;
+    for (auto &object : objects) {
+      if (Select(object) >= 0)
+        triangles += (*object.lods)[object.lod].index_count / 3;
+    }
+    if (triangles <= triangle_budget)
+      return triangles;
+
+    std::vector<std::pair<float, size_t>> order;
+    order.reserve(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i)
+      if (objects[i].lod >= 0)
+        order.push_back({ProjectError(objects[i].radius, ViewDistance(objects[i])), i});
+    std::sort(order.begin(), order.end());
+
+    for (auto [size, i] : order) {
+      auto &object = objects[i];
+      const auto &lods = *object.lods;
+      while (triangles > triangle_budget && object.lod >= 0) {
+        triangles -= lods[object.lod].index_count / 3;
+        if (object.lod + 1 < static_cast<int>(lods.size())) {
+          object.lod++;
+          triangles += lods[object.lod].index_count / 3;
+        } else {
+          object.lod = -1;  // 最粗一级仍然超预算，放弃绘制
+        }
+      }
+      if (triangles <= triangle_budget)
+        break;
+    }
+    return triangles;
+  }
+
+ private:
+  // 包围球最近点的视线深度，不小于近平面；整个包围球都在近平面之前（相机一侧或身后）时返回 -1
+  float ViewDistance(const Object &object) const {
+    Eigen::Vector4f p = view_ * Eigen::Vector4f(object.center.x(), object.center.y(), object.center.z(), 1.0f);
+    float depth = -p.z();
+    if (depth + object.radius < near_)
+      return -1.0f;
+    return std::max(depth - object.radius, std::max(near_, 1e-4f));
+  }
+
+  Eigen::Matrix4f view_{Eigen::Matrix4f::Identity()};
+  float pixels_per_unit_{1.0f};
+  float near_{0.0f};
+};
+
+}  // namespace meshopt
+
+}  // namespace e3d
@@ -0,0 +1,327 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "job_system.hpp"
+#include "simd.hpp"
+#include "trace.hpp"
+
+namespace e3d::occlusion {
+
+// 待测试的世界空间轴对齐包围盒
+struct Box {
+  Eigen::Vector3f min;
+  Eigen::Vector3f max;
+};
+
+enum class Result : uint8_t {
+  kVisible,
+  kOutside,   // 投影完全在屏幕外
+  kOccluded,  // 被遮挡物完全挡住
+};
+
+// 最近一次 Rasterize / Test 的统计
+struct Stats {
+  uint64_t occluder_triangles{};  // 实际光栅化的遮挡三角形
+  uint64_t tested{};
+  uint64_t outside{};
+  uint64_t occluded{};
+  double raster_ms{};
+  double test_ms{};
+
+  uint64_t culled() const { return outside + occluded; }
+  double culled_ratio() const { return tested ? double(culled()) / double(tested) : 0.0; }
+};
+
+// CPU 软件遮挡剔除。每帧把少量遮挡网格光栅化到低分辨率深度缓冲，再用它测试物体包围盒，在提交绘制之前剔除被挡住的物体。
+// 深度存 1/w：它在屏幕空间线性，越大越近，清除为 0（无穷远），与投影矩阵是否反向 Z 无关。
+// 缓冲按 8x8 像素分块，每块另存块内最远的深度（层次 Z），包围盒测试先看块，块不能判定时才逐像素比较，逐像素部分 4 路 SIMD。
+// 光栅化按块行分带在工作线程上并行，每条带只写自己的行，不需要同步；包围盒测试也按物体并行。
+// 判定是保守的：遮挡三角形只覆盖像素中心严格在内部的像素，跨越近平面的遮挡三角形整片丢弃，
+// 包围盒有角点在近平面之前时直接视为可见。
+class OcclusionCuller {
+ public:
+  static constexpr uint32_t kTileSize = 8;
+
+  struct Options {
+    uint32_t width{256};  // 向上取整到 kTileSize 的倍数
+    uint32_t height{128};
+    float near_w{1e-3f};  // 裁剪空间 w 小于该值的顶点视为在近平面之前
+  };
+
+  explicit OcclusionCuller(JobSystem *jobs) : OcclusionCuller(jobs, Options{}) {}
+  OcclusionCuller(JobSystem *jobs, const Options &options) : jobs_(jobs), options_(options) {
+    width_ = std::max(kTileSize, (options_.width + kTileSize - 1) / kTileSize * kTileSize);
+    height_ = std::max(kTileSize, (options_.height + kTileSize - 1) / kTileSize * kTileSize);
+    tiles_x_ = width_ / kTileSize;
+    tiles_y_ = height_ / kTileSize;
+    depth_.assign(size_t(width_) * height_ + 4, 0.0f);  // 多出的元素用于 16 字节对齐
+    hiz_.assign(size_t(tiles_x_) * tiles_y_, 0.0f);
+  }
+
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+  const Stats &stats() const { return stats_; }
+
+  // 开始新的一帧：清空遮挡物，设置相机。view_proj 为投影乘视图矩阵
+  void Begin(const Eigen::Matrix4f &view_proj) {
+    view_proj_ = view_proj;
+    triangles_.clear();
+    stats_ = {};
+  }
+
+  // 添加一个遮挡网格，position(i) 返回第 i 个顶点的对象空间位置。只做变换和三角形建立，真正的光栅化在 Rasterize 中
+  template <typename Index, typename PositionFn>
+  void AddOccluder(const Index *indices, size_t index_count, size_t vertex_count, PositionFn &&position, const Eigen::Matrix4f &model) {
+    Eigen::Matrix4f transform = view_proj_ * model;
+    clip_.resize(vertex_count);
+    for (size_t i = 0; i < vertex_count; ++i) {
+      Eigen::Vector3f p = position(uint32_t(i));
+      clip_[i] = transform * Eigen::Vector4f(p.x(), p.y(), p.z(), 1.0f);
+    }
+    for (size_t i = 0; i + 2 < index_count; i += 3)
+      SetupTriangle(clip_[indices[i]], clip_[indices[i + 1]], clip_[indices[i + 2]]);
+  }
+  template <typename Index, typename PositionFn>
+  void AddOccluder(const std::vector<Index> &indices, size_t vertex_count, PositionFn &&position, const Eigen::Matrix4f &model) {
+    AddOccluder(indices.data(), indices.size(), vertex_count, position, model);
+  }
+
+  // 清除深度缓冲并光栅化本帧的所有遮挡物，然后生成层次 Z
+  void Rasterize() {
+    E3D_TRACE_SCOPE("OcclusionCuller::Rasterize");
+    auto start = std::chrono::steady_clock::now();
+    stats_.occluder_triangles = triangles_.size();
+    auto rasterize_rows = [this](size_t begin, size_t end) {
+      for (size_t tile_row = begin; tile_row < end; ++tile_row)
+        RasterizeTileRow(uint32_t(tile_row));
+    };
+    if (jobs_)
+      jobs_->ParallelFor(tiles_y_, 1, rasterize_rows);
+    else
+      rasterize_rows(0, tiles_y_);
+    stats_.raster_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // 测试单个包围盒，需要在 Rasterize 之后调用，可在多个线程中同时调用
+  Result Test(const Box &box) const {
+    // 8 个角点的裁剪坐标：从最小角出发，沿三个轴加上矩阵对应列的倍数
+    Eigen::Vector4f base = view_proj_ * Eigen::Vector4f(box.min.x(), box.min.y(), box.min.z(), 1.0f);
+    Eigen::Vector3f extent = box.max - box.min;
+    Eigen::Vector4f axes[3] = {view_proj_.col(0) * extent.x(), view_proj_.col(1) * extent.y(), view_proj_.col(2) * extent.z()};
+
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY, nearest = 0.0f;
+    for (int i = 0; i < 8; ++i) {
+      Eigen::Vector4f c = base;
+      for (int axis = 0; axis < 3; ++axis)
+        if (i & (1 << axis))
+          c += axes[axis];
+      if (c.w() < options_.near_w)
+        return Result::kVisible;  // 与近平面相交，无法在屏幕空间判定
+      float inv_w = 1.0f / c.w();
+      float x = (c.x() * inv_w * 0.5f + 0.5f) * float(width_);
+      float y = (c.y() * inv_w * 0.5f + 0.5f) * float(height_);
+      min_x = std::min(min_x, x);
+      max_x = std::max(max_x, x);
+      min_y = std::min(min_y, y);
+      max_y = std::max(max_y, y);
+      nearest = std::max(nearest, inv_w);
+    }
+    if (max_x < 0.0f || max_y < 0.0f || min_x >= float(width_) || min_y >= float(height_))
+      return Result::kOutside;
+
+    // 覆盖到的像素（包含边界所在的像素）
+    int x0 = std::max(0, int(std::floor(min_x)));
+    int y0 = std::max(0, int(std::floor(min_y)));
+    int x1 = std::min(int(width_) - 1, int(std::floor(max_x)));
+    int y1 = std::min(int(height_) - 1, int(std::floor(max_y)));
+
+    using simd::Float4;
+    Float4 box_depth = Float4::Broadcast(nearest);
+    Float4 first = Float4::Broadcast(float(x0)), last = Float4::Broadcast(float(x1));
+    const float *depth = Depth();
+    for (int ty = y0 / int(kTileSize); ty <= y1 / int(kTileSize); ++ty) {
+      for (int tx = x0 / int(kTileSize); tx <= x1 / int(kTileSize); ++tx) {
+        // 块内最远的遮挡物也比包围盒最近点更近，整块都挡住
+        if (hiz_[size_t(ty) * tiles_x_ + tx] > nearest)
+          continue;
+        int row_begin = std::max(y0, ty * int(kTileSize)), row_end = std::min(y1, ty * int(kTileSize) + int(kTileSize) - 1);
+        for (int y = row_begin; y <= row_end; ++y) {
+          for (int x = tx * int(kTileSize); x < (tx + 1) * int(kTileSize); x += 4) {
+            Float4 column = Float4::Broadcast(float(x)) + Float4::Ramp();
+            Float4 d = Float4::Load(depth + size_t(y) * width_ + x);
+            if (((column >= first) & (column <= last) & (d <= box_depth)).Any())
+              return Result::kVisible;
+          }
+        }
+      }
+    }
+    return Result::kOccluded;
+  }
+
+  // 并行测试一组包围盒，结果写入 results（与 boxes 一一对应），并更新统计
+  void Test(const std::vector<Box> &boxes, std::vector<Result> &results) {
+    E3D_TRACE_SCOPE("OcclusionCuller::Test");
+    auto start = std::chrono::steady_clock::now();
+    results.resize(boxes.size());
+    std::atomic<uint64_t> outside{0}, occluded{0};
+    auto test_range = [&](size_t begin, size_t end) {
+      uint64_t local_outside = 0, local_occluded = 0;
+      for (size_t i = begin; i < end; ++i) {
+        results[i] = Test(boxes[i]);
+        local_outside += results[i] == Result::kOutside;
+        local_occluded += results[i] == Result::kOccluded;
+      }
+      outside += local_outside;
+      occluded += local_occluded;
+    };
+    if (jobs_)
+      jobs_->ParallelFor(boxes.size(), 256, test_range);
+    else
+      test_range(0, boxes.size());
+    stats_.tested += boxes.size();
+    stats_.outside += outside;
+    stats_.occluded += occluded;
+    stats_.test_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // 像素 (x, y) 处遮挡物的 1/w，0 表示没有遮挡物
+  float DepthAt(uint32_t x, uint32_t y) const { return Depth()[size_t(y) * width_ + x]; }
+
+ private:
+  // 屏幕空间三角形：三条边函数与 1/w 平面，都以像素坐标为自变量，三角形内部边函数全为正
+  struct Triangle {
+    float edge_a[3], edge_b[3], edge_c[3];
+    float z_a, z_b, z_c;
+    int min_x, min_y, max_x, max_y;
+  };
+
+  float *Depth() { return depth_.data() + AlignOffset(); }
+  const float *Depth() const { return depth_.data() + AlignOffset(); }
+  size_t AlignOffset() const { return (16 - reinterpret_cast<uintptr_t>(depth_.data()) % 16) % 16 / sizeof(float); }
+
+  void SetupTriangle(const Eigen::Vector4f &c0, const Eigen::Vector4f &c1, const Eigen::Vector4f &c2) {
+    if (c0.w() < options_.near_w || c1.w() < options_.near_w || c2.w() < options_.near_w)
+      return;  // 不裁剪，丢弃整个三角形仍然是保守的
+    float x[3], y[3], z[3];
+    const Eigen::Vector4f *clip[3] = {&c0, &c1, &c2};
+    for (int i = 0; i < 3; ++i) {
+      z[i] = 1.0f / clip[i]->w();
+      x[i] = (clip[i]->x() * z[i] * 0.5f + 0.5f) * float(width_);
+      y[i] = (clip[i]->y() * z[i] * 0.5f + 0.5f) * float(height_);
+    }
+
+    Triangle t;
+    t.min_x = std::max(0, int(std::floor(std::min({x[0], x[1], x[2]}))));
+    t.min_y = std::max(0, int(std::floor(std::min({y[0], y[1], y[2]}))));
+    t.max_x = std::min(int(width_) - 1, int(std::floor(std::max({x[0], x[1], x[2]}))));
+    t.max_y = std::min(int(height_) - 1, int(std::floor(std::max({y[0], y[1], y[2]}))));
+    if (t.min_x > t.max_x || t.min_y > t.max_y)
+      return;
+
+    // 边 i 是顶点 i+1 到 i+2 的边，在对面的顶点 i 处取值为两倍面积
+    for (int i = 0; i < 3; ++i) {
+      int j = (i + 1) % 3, k = (i + 2) % 3;
+      t.edge_a[i] = y[j] - y[k];
+      t.edge_b[i] = x[k] - x[j];
+      t.edge_c[i] = x[j] * y[k] - x[k] * y[j];
+    }
+    float area = t.edge_a[0] * x[0] + t.edge_b[0] * y[0] + t.edge_c[0];
+    if (std::abs(area) < 1e-8f)
+      return;
+    // 两面都作为遮挡物，按面积符号统一成内部为正
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < 3; ++i) {
+      t.edge_a[i] *= sign;
+      t.edge_b[i] *= sign;
+      t.edge_c[i] *= sign;
+    }
+    area = std::abs(area);
+
+    // 重心坐标为 edge_i / area，1/w 按重心坐标插值后仍是像素坐标的一次函数
+    t.z_a = t.z_b = t.z_c = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+      float w = z[i] / area;
+      t.z_a += t.edge_a[i] * w;
+      t.z_b += t.edge_b[i] * w;
+      t.z_c += t.edge_c[i] * w;
+    }
+    triangles_.push_back(t);
+  }
+
+  // 清除一行块，光栅化与之相交的三角形，再计算这些块的层次 Z
+  void RasterizeTileRow(uint32_t tile_row) {
+    using simd::Float4;
+    using simd::Mask4;
+    int y_begin = int(tile_row * kTileSize), y_end = y_begin + int(kTileSize) - 1;
+    float *depth = Depth();
+    std::fill(depth + size_t(y_begin) * width_, depth + size_t(y_end + 1) * width_, 0.0f);
+
+    Float4 ramp = Float4::Ramp();
+    Float4 four = Float4::Broadcast(4.0f);
+    for (const auto &t : triangles_) {
+      if (t.max_y < y_begin || t.min_y > y_end)
+        continue;
+      int row_begin = std::max(t.min_y, y_begin), row_end = std::min(t.max_y, y_end);
+      int x_begin = t.min_x & ~3;
+      // 每行从对齐的起点开始，四个像素一组步进
+      Float4 start_x = Float4::Broadcast(float(x_begin) + 0.5f) + ramp;
+      Float4 e_step[3], z_step = Float4::Broadcast(t.z_a) * four;
+      for (int i = 0; i < 3; ++i)
+        e_step[i] = Float4::Broadcast(t.edge_a[i]) * four;
+
+      for (int y = row_begin; y <= row_end; ++y) {
+        Float4 py = Float4::Broadcast(float(y) + 0.5f);
+        Float4 e[3];
+        for (int i = 0; i < 3; ++i)
+          e[i] = Float4::Broadcast(t.edge_a[i]) * start_x + Float4::Broadcast(t.edge_b[i]) * py + Float4::Broadcast(t.edge_c[i]);
+        Float4 z = Float4::Broadcast(t.z_a) * start_x + Float4::Broadcast(t.z_b) * py + Float4::Broadcast(t.z_c);
+        Float4 zero = Float4::Broadcast(0.0f);
+        float *row = depth + size_t(y) * width_;
+        for (int x = x_begin; x <= t.max_x; x += 4) {
+          Mask4 inside = (e[0] > zero) & (e[1] > zero) & (e[2] > zero);
+          if (inside.Any()) {
+            Float4 d = Float4::Load(row + x);
+            Select(inside, Max(d, z), d).Store(row + x);
+          }
+          for (int i = 0; i < 3; ++i)
+            e[i] = e[i] + e_step[i];
+          z = z + z_step;
+        }
+      }
+    }
+
+    // 每块取最远（最小）的深度
+    for (uint32_t tx = 0; tx < tiles_x_; ++tx) {
+      Float4 farthest = Float4::Broadcast(INFINITY);
+      for (int y = y_begin; y <= y_end; ++y) {
+        const float *p = depth + size_t(y) * width_ + tx * kTileSize;
+        farthest = Min(farthest, Min(Float4::Load(p), Float4::Load(p + 4)));
+      }
+      hiz_[size_t(tile_row) * tiles_x_ + tx] = farthest.MinElement();
+    }
+  }
+
+  JobSystem *jobs_;
+  Options options_;
+  uint32_t width_{};
+  uint32_t height_{};
+  uint32_t tiles_x_{};
+  uint32_t tiles_y_{};
+  std::vector<float> depth_;  // 行主序，起点按 16 字节对齐
+  std::vector<float> hiz_;    // 每块最远的深度
+  Eigen::Matrix4f view_proj_{Eigen::Matrix4f::Identity()};
+  std::vector<Eigen::Vector4f> clip_;  // AddOccluder 的临时顶点
+  std::vector<Triangle> triangles_;
+  Stats stats_;
+};
+
+}  // namespace e3d::occlusion
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "deletion_queue.hpp"
+
+namespace e3d {
+
+// 逐通道的 GPU 计时。每个槽位（通常对应交换链图像）一组时间戳查询，录制时在通道前后各写一次；
+// 同一槽位下一次开始时读回上一次的结果，此时那一帧已经完成，不会等待 GPU。
+// 图形队列不支持时间戳（timestamp_period 为 0）时什么也不做，timings 保持为空。
+class PassTimer {
+ public:
+  struct Timing {
+    std::string name;
+    float ms{};
+  };
+
+  PassTimer(VkDevice device, DeletionQueue *deletion_queue, float timestamp_period, uint32_t slots)
+      : PassTimer(device, deletion_queue, timestamp_period, slots, 32) {}
+  PassTimer(VkDevice device, DeletionQueue *deletion_queue, float timestamp_period, uint32_t slots, uint32_t max_passes)
+      : device_(device), deletion_queue_(deletion_queue), period_(timestamp_period), max_passes_(max_passes), names_(slots) {
+    if (period_ == 0.0f)
+      return;
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = slots * max_passes_ * 2;
+    if (vkCreateQueryPool(device_, &queryPoolInfo, nullptr, &pool_) != VK_SUCCESS)
+      throw std::runtime_error("failed to create pass timer query pool!");
+    deletion_queue_->Track(pool_);
+  }
+
+  ~PassTimer() { deletion_queue_->Release(pool_); }
+
+  PassTimer(const PassTimer &) = delete;
+  PassTimer &operator=(const PassTimer &) = delete;
+
+  bool enabled() const { return pool_ != VK_NULL_HANDLE; }
+
+  // 在帧命令缓冲的开头、任何渲染通道之外调用
+  void Begin(VkCommandBuffer command_buffer, uint32_t slot) {
+    if (!pool_)
+      return;
+    Resolve(slot);
+    slot_ = slot;
+    names_[slot_].clear();
+    vkCmdResetQueryPool(command_buffer, pool_, First(slot_), max_passes_ * 2);
+  }
+
+  // 超出 max_passes 的通道不计时
+  void BeginPass(VkCommandBuffer command_buffer, const std::string &name) {
+    if (!pool_ || names_[slot_].size() == max_passes_)
+      return;
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool_, First(slot_) + uint32_t(names_[slot_].size()) * 2);
+    names_[slot_].push_back(name);
+    open_ = true;
+  }
+
+  void EndPass(VkCommandBuffer command_buffer) {
+    if (!open_)
+      return;
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool_, First(slot_) + uint32_t(names_[slot_].size()) * 2 - 1);
+    open_ = false;
+  }
+
+  // 最近一次读回的结果，按执行顺序
+  const std::vector<Timing> &timings() const { return timings_; }
+
+  float total_ms() const {
+    float total = 0.0f;
+    for (const auto &t : timings_)
+      total += t.ms;
+    return total;
+  }
+
+  // 找不到该通道时返回 0
+  float pass_ms(const std::string &name) const {
+    for (const auto &t : timings_)
+      if (t.name == name)
+        return t.ms;
+    return 0.0f;
+  }
+
+ private:
+  uint32_t First(uint32_t slot) const { return slot * max_passes_ * 2; }
+
+  void Resolve(uint32_t slot) {
+    const auto &names = names_[slot];
+    if (names.empty())
+      return;
+
+    results_.resize(names.size() * 2);
+    VkResult err = vkGetQueryPoolResults(device_, pool_, First(slot), uint32_t(results_.size()), results_.size() * sizeof(uint64_t), results_.data(),
+                                         sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (err == VK_NOT_READY)
+      return;
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("vkGetQueryPoolResults failed for pass timer");
+
+    timings_.resize(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+      timings_[i].name = names[i];
+      timings_[i].ms = float(double(results_[i * 2 + 1] - results_[i * 2]) * period_ * 1e-6);
+    }
+  }
+
+  VkDevice device_;
+  DeletionQueue *deletion_queue_;
+  float period_;
+  uint32_t max_passes_;
+  VkQueryPool pool_{};
+
+  std::vector<std::vector<std::string>> names_;  // 每个槽位最近一次录制的通道
+  uint32_t slot_{};
+  bool open_{};
+  std::vector<uint64_t> results_;
+  std::vector<Timing> timings_;
+};
+
+}  // namespace e3d
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "deletion_queue.hpp"
+#include "job_system.hpp"
+#include "trace.hpp"
+
+// 编译好的 SPIR-V 所在目录，由构建系统定义为 src/shaders 的构建输出目录
+#ifndef E3D_SHADER_DIR
+#define E3D_SHADER_DIR "."
+#endif
+
+namespace e3d {
+
+enum class BlendMode : uint8_t {
+  kOpaque,
+  kAlpha,     // src * a + dst * (1 - a)
+  kAdditive,  // src * a + dst
+};
+
+// 渲染通道的兼容性：附件格式和采样数相同的渲染通道可以使用同一个管线，见 Vulkan 规范 "Render Pass Compatibility"
+struct RenderPassKey {
+  std::vector<VkFormat> color_formats;
+  VkFormat depth_format = VK_FORMAT_UNDEFINED;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  uint32_t subpass = 0;
+
+  bool operator==(const RenderPassKey &o) const {
+    return color_formats == o.color_formats && depth_format == o.depth_format && samples == o.samples && subpass == o.subpass;
+  }
+};
+
+// 功能位在编译期映射为特化常量：第 i 位对应 constant_id i 的 bool 常量（按 VkBool32 占 4 字节）
+template <uint32_t kCount>
+constexpr std::array<uint32_t, kCount> FeatureSpecialization(uint32_t features) {
+  std::array<uint32_t, kCount> values{};
+  for (uint32_t i = 0; i < kCount; ++i)
+    values[i] = (features >> i) & 1u;
+  return values;
+}
+
+// kCount 个功能位的全部组合，用于预编译整个变体矩阵
+template <uint32_t kCount>
+constexpr std::array<uint32_t, (1u << kCount)> FeatureVariants() {
+  std::array<uint32_t, (1u << kCount)> variants{};
+  for (uint32_t i = 0; i < (1u << kCount); ++i)
+    variants[i] = i;
+  return variants;
+}
+
+// 图形管线的完整描述。视口和裁剪矩形总是动态状态，不在描述中。
+// render_pass 只用于创建，去重时按 render_pass_key 比较，兼容的渲染通道共用同一个管线。
+struct PipelineDesc {
+  std::string vertex_shader;    // SPIR-V 文件名
+  std::string fragment_shader;  // 为空时只有顶点着色器，例如深度预通道
+  std::vector<uint32_t> specialization;  // constant_id i 的值，两个阶段共用；着色器中没有声明的编号会被忽略
+  std::vector<VkVertexInputBindingDescription> bindings;
+  std::vector<VkVertexInputAttributeDescription> attributes;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+  VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  bool depth_test = true;
+  bool depth_write = true;
+  VkCompareOp depth_compare = VK_COMPARE_OP_GREATER_OR_EQUAL;  // 反向 Z
+  bool color_write = true;
+  BlendMode blend = BlendMode::kOpaque;
+  VkPipelineLayout layout{};  // 由调用方创建，需要比注册表中的管线活得久
+  VkRenderPass render_pass{};
+  RenderPassKey render_pass_key;
+
+  bool operator==(const PipelineDesc &o) const {
+    if (vertex_shader != o.vertex_shader || fragment_shader != o.fragment_shader || specialization != o.specialization || topology != o.topology || polygon_mode != o.polygon_mode ||
+        cull_mode != o.cull_mode || front_face != o.front_face || depth_test != o.depth_test || depth_write != o.depth_write ||
+        depth_compare != o.depth_compare || color_write != o.color_write || blend != o.blend || layout != o.layout || !(render_pass_key == o.render_pass_key))
+      return false;
+    if (bindings.size() != o.bindings.size() || attributes.size() != o.attributes.size())
+      return false;
+    for (size_t i = 0; i < bindings.size(); ++i) {
+      const auto &a = bindings[i];
+      const auto &b = o.bindings[i];
+      if (a.binding != b.binding || a.stride != b.stride || a.inputRate != b.inputRate)
+        return false;
+    }
+    for (size_t i = 0; i < attributes.size(); ++i) {
+      const auto &a = attributes[i];
+      const auto &b = o.attributes[i];
+      if (a.location != b.location || a.binding != b.binding || a.format != b.format || a.offset != b.offset)
+        return false;
+    }
+    return true;
+  }
+
+  size_t Hash() const {
+    size_t h = 0;
+    auto combine = [&h](size_t v) { h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2); };
+    combine(std::hash<std::string>()(vertex_shader));
+    combine(std::hash<std::string>()(fragment_shader));
+    for (auto value : specialization)
+      combine(value);
+    for (const auto &b : bindings)
+      combine(size_t(b.binding) | size_t(b.stride) << 8 | size_t(b.inputRate) << 40);
+    for (const auto &a : attributes)
+      combine(size_t(a.location) | size_t(a.binding) << 8 | size_t(a.format) << 16 | size_t(a.offset) << 32);
+    combine(size_t(topology) | size_t(polygon_mode) << 8 | size_t(cull_mode) << 16 | size_t(front_face) << 24 | size_t(depth_compare) << 32 |
+            size_t(depth_test) << 40 | size_t(depth_write) << 41 | size_t(color_write) << 42 | size_t(blend) << 48);
+    combine(std::hash<VkPipelineLayout>()(layout));
+    for (auto format : render_pass_key.color_formats)
+      combine(size_t(format));
+    combine(size_t(render_pass_key.depth_format) | size_t(render_pass_key.samples) << 32 | size_t(render_pass_key.subpass) << 40);
+    return h;
+  }
+};
+
+struct PipelineDescHash {
+  size_t operator()(const PipelineDesc &desc) const { return desc.Hash(); }
+};
+
+// 管线注册表：按描述去重，缺失的管线在工作线程上编译，渲染线程不会因为新的管线变体而卡顿。
+// 绘制时用 Get 取管线，尚未编译完成时返回 VK_NULL_HANDLE（或指定的后备管线），调用方跳过这次绘制。
+// 启动时必须存在的管线用 Require 同步等待。所有编译共用一个 VkPipelineCache，可以保存到文件供下次启动使用。
+class PipelineRegistry {
+ public:
+  using Handle = uint32_t;
+  static constexpr Handle kInvalid = UINT32_MAX;
+
+  enum class State : uint8_t { kPending, kReady, kFailed };
+
+  struct Options {
+    std::string cache_path;  // 管线缓存文件，为空时不读写
+  };
+
+  // jobs 为空时在调用线程上同步编译
+  PipelineRegistry(VkDevice device, std::shared_ptr<DeletionQueue> deletion_queue, JobSystem *jobs)
+      : PipelineRegistry(device, deletion_queue, jobs, Options{}) {}
+  PipelineRegistry(VkDevice device, std::shared_ptr<DeletionQueue> deletion_queue, JobSystem *jobs, const Options &options)
+      : device_(device), deletion_queue_(deletion_queue), jobs_(jobs), options_(options) {
+    std::vector<char> data;
+    if (!options_.cache_path.empty()) {
+      std::ifstream file(options_.cache_path, std::ios::binary);
+      if (file)
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // 数据与当前驱动不匹配时驱动会忽略它，创建一个空缓存
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+    if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &cache_) != VK_SUCCESS)
+      throw std::runtime_error("failed to create pipeline cache!");
+  }
+
+  // 等待所有编译结束；管线可能仍被在途的帧使用，交给删除队列
+  ~PipelineRegistry() {
+    WaitIdle();
+    if (!options_.cache_path.empty())
+      SaveCache(options_.cache_path);
+    for (auto &entry : entries_)
+      if (entry->pipeline)
+        deletion_queue_->Release(entry->pipeline);
+    for (auto &layout : layouts_)
+      deletion_queue_->Release(layout.layout);
+    for (auto &[name, module] : modules_)
+      vkDestroyShaderModule(device_, module, nullptr);
+    vkDestroyPipelineCache(device_, cache_, nullptr);
+  }
+
+  PipelineRegistry(const PipelineRegistry &) = delete;
+  PipelineRegistry &operator=(const PipelineRegistry &) = delete;
+
+  // 请求一个管线，不阻塞。相同描述返回同一个句柄；第一次请求时提交编译
+  Handle Request(const PipelineDesc &desc) {
+    std::shared_ptr<Entry> entry;
+    Handle handle{};
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      requests_++;
+      auto it = handles_.find(desc);
+      if (it != handles_.end())
+        return it->second;
+
+      handle = static_cast<Handle>(entries_.size());
+      entry = std::make_shared<Entry>();
+      entry->desc = desc;
+      entries_.push_back(entry);
+      handles_.emplace(desc, handle);
+      if (jobs_) {
+        entry->done = jobs_->Submit([this, entry] { Compile(*entry); }).share();
+        return handle;
+      }
+    }
+    Compile(*entry);
+    return handle;
+  }
+
+  // 管线布局按内容去重，与注册表同生命周期，因此描述中的 layout 句柄不会被复用到别的布局上
+  VkPipelineLayout Layout(const std::vector<VkDescriptorSetLayout> &set_layouts, const std::vector<VkPushConstantRange> &push_constants) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 布局只有几个，线性查找
+    for (const auto &layout : layouts_) {
+      if (layout.set_layouts != set_layouts || layout.push_constants.size() != push_constants.size())
+        continue;
+      bool same = true;
+      for (size_t i = 0; i < push_constants.size(); ++i) {
+        const auto &a = layout.push_constants[i];
+        const auto &b = push_constants[i];
+        same = same && a.stageFlags == b.stageFlags && a.offset == b.offset && a.size == b.size;
+      }
+      if (same)
+        return layout.layout;
+    }
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+    layoutInfo.pSetLayouts = set_layouts.data();
+    layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(push_constants.size());
+    layoutInfo.pPushConstantRanges = push_constants.data();
+    VkPipelineLayout layout{};
+    if (vkCreatePipelineLayout(device_, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+      throw std::runtime_error("failed to create pipeline layout!");
+    deletion_queue_->Track(layout);
+    layouts_.push_back({set_layouts, push_constants, layout});
+    return layout;
+  }
+
+  // 同步获取，未就绪时在当前线程等待；编译失败时抛出异常
+  VkPipeline Require(const PipelineDesc &desc) {
+    Handle handle = Request(desc);
+    Wait(handle);
+    auto entry = GetEntry(handle);
+    if (entry->state.load(std::memory_order_acquire) != State::kReady)
+      throw std::runtime_error("failed to create pipeline " + desc.vertex_shader + " / " + desc.fragment_shader + ": " + entry->error);
+    return entry->pipeline;
+  }
+
+  // 就绪时返回管线，否则返回 VK_NULL_HANDLE。绘制时调用，不阻塞
+  VkPipeline Get(Handle handle) const {
+    if (handle == kInvalid)
+      return VK_NULL_HANDLE;
+    auto entry = GetEntry(handle);
+    return entry->state.load(std::memory_order_acquire) == State::kReady ? entry->pipeline : VK_NULL_HANDLE;
+  }
+
+  // 未就绪时使用后备管线，后备管线需要与 handle 的布局和顶点格式兼容
+  VkPipeline Get(Handle handle, Handle fallback) const {
+    VkPipeline pipeline = Get(handle);
+    return pipeline ? pipeline : Get(fallback);
+  }
+
+  State state(Handle handle) const { return GetEntry(handle)->state.load(std::memory_order_acquire); }
+
+  void Wait(Handle handle) {
+    auto entry = GetEntry(handle);
+    if (entry->done.valid())
+      entry->done.wait();
+  }
+
+  void WaitIdle() {
+    std::vector<std::shared_ptr<Entry>> entries;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      entries = entries_;
+    }
+    for (auto &entry : entries)
+      if (entry->done.valid())
+        entry->done.wait();
+  }
+
+  void SaveCache(const std::string &path) {
+    size_t size = 0;
+    vkGetPipelineCacheData(device_, cache_, &size, nullptr);
+    std::vector<char> data(size);
+    if (size == 0 || vkGetPipelineCacheData(device_, cache_, &size, data.data()) != VK_SUCCESS)
+      return;
+    std::ofstream file(path, std::ios::binary);
+    file.write(data.data(), std::streamsize(size));
+  }
+
+  VkPipelineCache cache() const { return cache_; }
+
+  void Report(std::ostream &os) const {
+    os << "pipelines: " << size() << " unique of " << requests() << " requests, " << compiled() << " compiled in " << compile_ms() << " ms\n";
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+  uint64_t requests() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requests_;
+  }
+  uint64_t compiled() const { return compiled_.load(); }
+  double compile_ms() const { return double(compile_us_.load()) / 1000.0; }  // 所有编译的累计耗时
+
+ private:
+  struct Entry {
+    PipelineDesc desc;
+    VkPipeline pipeline{};  // 在 state 变为 kReady 之前写入
+    std::atomic<State> state{State::kPending};
+    std::string error;
+    std::shared_future<void> done;
+  };
+
+  struct LayoutEntry {
+    std::vector<VkDescriptorSetLayout> set_layouts;
+    std::vector<VkPushConstantRange> push_constants;
+    VkPipelineLayout layout;
+  };
+
+  std::shared_ptr<Entry> GetEntry(Handle handle) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (handle >= entries_.size())
+      throw std::runtime_error("invalid pipeline handle");
+    return entries_[handle];
+  }
+
+  // 着色器模块按文件名缓存，在注册表析构时销毁
+  VkShaderModule GetModule(const std::string &name) {
+    {
+      std::lock_guard<std::mutex> lock(modules_mutex_);
+      auto it = modules_.find(name);
+      if (it != modules_.end())
+        return it->second;
+    }
+
+    std::string path = std::string(E3D_SHADER_DIR) + "/" + name;
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+      throw std::runtime_error("failed to open shader " + path);
+    std::vector<char> code(size_t(file.tellg()));
+    file.seekg(0);
+    file.read(code.data(), std::streamsize(code.size()));
+
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+    VkShaderModule module{};
+    if (vkCreateShaderModule(device_, &createInfo, nullptr, &module) != VK_SUCCESS)
+      throw std::runtime_error("failed to create shader module " + name);
+
+    // 两个线程同时加载同一个文件时保留先插入的一个
+    std::lock_guard<std::mutex> lock(modules_mutex_);
+    auto [it, inserted] = modules_.emplace(name, module);
+    if (!inserted)
+      vkDestroyShaderModule(device_, module, nullptr);
+    return it->second;
+  }
+
+  void Compile(Entry &entry) {
+    E3D_TRACE_SCOPE("PipelineRegistry::Compile");
+    auto start = std::chrono::steady_clock::now();
+    try {
+      entry.pipeline = Create(entry.desc);
+      deletion_queue_->Track(entry.pipeline);
+      entry.state.store(State::kReady, std::memory_order_release);
+    } catch (const std::exception &e) {
+      entry.error = e.what();
+      std::cerr << "pipeline compile failed: " << e.what() << "\n";
+      entry.state.store(State::kFailed, std::memory_order_release);
+    }
+    compile_us_ += uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    compiled_++;
+  }
+
+  VkPipeline Create(const PipelineDesc &desc) {
+    std::vector<VkSpecializationMapEntry> specializationEntries(desc.specialization.size());
+    for (uint32_t i = 0; i < specializationEntries.size(); ++i)
+      specializationEntries[i] = {i, i * uint32_t(sizeof(uint32_t)), sizeof(uint32_t)};
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = desc.specialization.size() * sizeof(uint32_t);
+    specializationInfo.pData = desc.specialization.data();
+    const VkSpecializationInfo *specialization = desc.specialization.empty() ? nullptr : &specializationInfo;
+
+    VkPipelineShaderStageCreateInfo shaderStages[2]{};
+    uint32_t stageCount = 1;
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = GetModule(desc.vertex_shader);
+    shaderStages[0].pName = "main";
+    shaderStages[0].pSpecializationInfo = specialization;
+    if (!desc.fragment_shader.empty()) {
+      shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+      shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+      shaderStages[1].module = GetModule(desc.fragment_shader);
+      shaderStages[1].pName = "main";
+      shaderStages[1].pSpecializationInfo = specialization;
+      stageCount = 2;
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.bindings.size());
+    vertexInputInfo.pVertexBindingDescriptions = desc.bindings.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.attributes.size());
+    vertexInputInfo.pVertexAttributeDescriptions = desc.attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = desc.topology;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = desc.polygon_mode;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = desc.cull_mode;
+    rasterizer.frontFace = desc.front_face;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = desc.render_pass_key.samples;
+
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    blendAttachment.colorWriteMask =
+        desc.color_write ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT : 0;
+    if (desc.blend != BlendMode::kOpaque) {
+      blendAttachment.blendEnable = VK_TRUE;
+      blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+      blendAttachment.dstColorBlendFactor = desc.blend == BlendMode::kAdditive ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+      blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+      blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+      blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+      blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+    std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(desc.render_pass_key.color_formats.size(), blendAttachment);
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = static_cast<uint32_t>(blendAttachments.size());
+    colorBlending.pAttachments = blendAttachments.data();
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = desc.depth_test ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = desc.depth_write ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = desc.depth_compare;
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = stageCount;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = desc.render_pass_key.depth_format != VK_FORMAT_UNDEFINED ? &depthStencil : nullptr;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = desc.layout;
+    pipelineInfo.renderPass = desc.render_pass;
+    pipelineInfo.subpass = desc.render_pass_key.subpass;
+
+    // 管线缓存是内部同步的，多个工作线程可以同时使用
+    VkPipeline pipeline{};
+    VkResult result = vkCreateGraphicsPipelines(device_, cache_, 1, &pipelineInfo, nullptr, &pipeline);
+    if (result != VK_SUCCESS)
+      throw std::runtime_error("vkCreateGraphicsPipelines failed (" + std::to_string(int(result)) + ")");
+    return pipeline;
+  }
+
+  VkDevice device_;
+  std::shared_ptr<DeletionQueue> deletion_queue_;
+  JobSystem *jobs_;
+  Options options_;
+  VkPipelineCache cache_{};
+
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<Entry>> entries_;  // 按句柄索引
+  std::unordered_map<PipelineDesc, Handle, PipelineDescHash> handles_;
+  uint64_t requests_{};
+  std::vector<LayoutEntry> layouts_;
+
+  std::mutex modules_mutex_;
+  std::unordered_map<std::string, VkShaderModule> modules_;
+
+  std::atomic<uint64_t> compiled_{};
+  std::atomic<uint64_t> compile_us_{};
+};
+
+}  // namespace e3d
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace e3d {
+
+// 动画时间来源。引擎每帧开始时读取 Now()，帧提交后调用 Tick()。
+class Clock {
+ public:
+  virtual ~Clock() = default;
+  virtual double Now() const = 0;  // 秒
+  virtual void Tick() {}
+};
+
+// 真实时间，从创建时开始计时
+class SystemClock : public Clock {
+ public:
+  double Now() const override { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count(); }
+
+ private:
+  std::chrono::steady_clock::time_point start_{std::chrono::steady_clock::now()};
+};
+
+// 固定步长：第 n 帧的时间总是 n * step，与实际帧率无关，每次运行渲染完全相同的帧序列
+class FixedStepClock : public Clock {
+ public:
+  explicit FixedStepClock(double step = 1.0 / 60.0) : step_(step) {}
+
+  double Now() const override { return double(frame_) * step_; }
+  void Tick() override { frame_++; }
+
+  uint64_t frame() const { return frame_; }
+
+ private:
+  double step_;
+  uint64_t frame_{};
+};
+
+struct CameraPose {
+  Eigen::Vector3f eye{2.0f, 2.0f, 2.0f};
+  Eigen::Vector3f center{0.0f, 0.0f, 0.0f};
+  Eigen::Vector3f up{0.0f, 0.0f, 1.0f};
+  float fov = 45.0f * float(M_PI) / 180.0f;  // 垂直视场角（弧度）
+};
+
+// 脚本化的回放时间线：相机关键帧之间线性插值，场景事件在时间到达时按顺序触发一次
+class Timeline {
+ public:
+  void AddCameraKey(double time, const CameraPose &pose) {
+    auto it = std::upper_bound(camera_keys_.begin(), camera_keys_.end(), time, [](double t, const CameraKey &k) { return t < k.time; });
+    camera_keys_.insert(it, {time, pose});
+  }
+
+  void At(double time, std::function<void()> action) {
+    auto it = std::upper_bound(events_.begin() + next_event_, events_.end(), time, [](double t, const Event &e) { return t < e.time; });
+    events_.insert(it, {time, std::move(action)});
+  }
+
+  double duration() const {
+    double end = camera_keys_.empty() ? 0.0 : camera_keys_.back().time;
+    return events_.empty() ? end : std::max(end, events_.back().time);
+  }
+
+  CameraPose Camera(double time) const {
+    if (camera_keys_.empty())
+      return {};
+    if (time <= camera_keys_.front().time)
+      return camera_keys_.front().pose;
+    if (time >= camera_keys_.back().time)
+      return camera_keys_.back().pose;
+
+    auto next = std::upper_bound(camera_keys_.begin(), camera_keys_.end(), time, [](double t, const CameraKey &k) { return t < k.time; });
+    auto prev = next - 1;
+    float s = float((time - prev->time) / (next->time - prev->time));
+    const auto &a = prev->pose;
+    const auto &b = next->pose;
+
+    CameraPose pose;
+    pose.eye = a.eye + (b.eye - a.eye) * s;
+    pose.center = a.center + (b.center - a.center) * s;
+    pose.up = (a.up + (b.up - a.up) * s).normalized();
+    pose.fov = a.fov + (b.fov - a.fov) * s;
+    return pose;
+  }
+
+  // 触发时间不晚于 time 且尚未触发的事件
+  void Advance(double time) {
+    while (next_event_ < events_.size() && events_[next_event_].time <= time)
+      events_[next_event_++].action();
+  }
+
+  // 重新回放前调用，所有事件重新变为未触发
+  void Rewind() { next_event_ = 0; }
+
+ private:
+  struct CameraKey {
+    double time;
+    CameraPose pose;
+  };
+  struct Event {
+    double time;
+    std::function<void()> action;
+  };
+
+  std::vector<CameraKey> camera_keys_;
+  std::vector<Event> events_;
+  size_t next_event_{};
+};
+
+// 逐帧记录的耗时（毫秒）。frame 为整帧墙钟时间，cpu 为其中去掉等待 GPU 和交换链的部分，
+// gpu 为场景时间戳测得的时间（读回有若干帧延迟，尚未读到时为 0，不计入统计）。
+class FrameStats {
+ public:
+  struct Sample {
+    double frame_ms;
+    double cpu_ms;
+    double gpu_ms;
+  };
+
+  struct Percentiles {
+    double p50{};
+    double p95{};
+    double p99{};
+    double max{};
+    double mean{};
+  };
+
+  struct Summary {
+    size_t frames{};
+    Percentiles frame;
+    Percentiles cpu;
+    Percentiles gpu;
+    size_t hitches{};  // 整帧时间超过预算的帧数
+    double average_fps{};
+  };
+
+  void Record(double frame_ms, double cpu_ms, double gpu_ms) { samples_.push_back({frame_ms, cpu_ms, gpu_ms}); }
+  void Clear() { samples_.clear(); }
+
+  const std::vector<Sample> &samples() const { return samples_; }
+
+  Summary Summarize(double budget_ms) const {
+    Summary summary;
+    summary.frames = samples_.size();
+    if (samples_.empty())
+      return summary;
+
+    std::vector<double> frame, cpu, gpu;
+    double total_ms = 0.0;
+    for (const auto &s : samples_) {
+      frame.push_back(s.frame_ms);
+      cpu.push_back(s.cpu_ms);
+      if (s.gpu_ms > 0.0)
+        gpu.push_back(s.gpu_ms);
+      total_ms += s.frame_ms;
+      if (s.frame_ms > budget_ms)
+        summary.hitches++;
+    }
+    summary.frame = Compute(frame);
+    summary.cpu = Compute(cpu);
+    summary.gpu = Compute(gpu);
+    summary.average_fps = total_ms > 0.0 ? 1000.0 * double(samples_.size()) / total_ms : 0.0;
+    return summary;
+  }
+
+ private:
+  // 最近秩法：第 p 百分位取排序后第 ceil(p * n) 个值
+  static Percentiles Compute(std::vector<double> &values) {
+    Percentiles result;
+    if (values.empty())
+      return result;
+    std::sort(values.begin(), values.end());
+    auto rank = [&](double p) { return values[std::min(values.size() - 1, size_t(std::max(1.0, std::ceil(p * double(values.size())))) - 1)]; };
+    result.p50 = rank(0.50);
+    result.p95 = rank(0.95);
+    result.p99 = rank(0.99);
+    result.max = values.back();
+    double sum = 0.0;
+    for (double v : values)
+      sum += v;
+    result.mean = sum / double(values.size());
+    return result;
+  }
+
+  std::vector<Sample> samples_;
+};
+
+}  // namespace e3d
@@ -0,0 +1,397 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "job_system.hpp"
+
+namespace e3d {
+
+namespace pointcloud {
+
+// 输入点：位置和 RGBA8 颜色（R 在最低字节）
+struct Point {
+  Eigen::Vector3f position;
+  uint32_t color;
+  uint16_t intensity{};
+};
+
+// GPU 上的紧凑格式，每点 12 字节：位置按所在节点的包围盒量化为 16 位，颜色 RGBA8。
+// 与 points.vert 的顶点输入对应（R16G16B16A16_UNORM + R8G8B8A8_UNORM）。
+struct PackedPoint {
+  uint16_t x, y, z;
+  uint16_t intensity;
+  uint32_t color;
+};
+static_assert(sizeof(PackedPoint) == 12, "PackedPoint must stay 12 bytes");
+
+// 八叉树节点，立方体包围盒。节点之间是叠加关系：每个节点保存自己范围内按 spacing 抽稀的一部分点，
+// 子节点只保存父节点没有取走的点，所以只画到任意一层都是完整但更稀疏的点云。
+struct Node {
+  float min[3];
+  float size;           // 立方体边长
+  float spacing;        // 本节点的点间距（抽稀网格的单元边长）
+  uint32_t level;
+  uint32_t point_count;
+  uint32_t reserved{};
+  uint64_t first_point;  // 在点数组（文件中为点数据区）中的下标
+  int32_t children[8];   // -1 表示没有该子节点
+
+  Eigen::Vector3f Min() const { return {min[0], min[1], min[2]}; }
+  Eigen::Vector3f Center() const { return Min() + Eigen::Vector3f::Constant(size * 0.5f); }
+};
+
+// 节点数据来源。LoadNode 在后台线程中调用，实现需要线程安全。
+class Source {
+ public:
+  virtual ~Source() {}
+  virtual const std::vector<Node> &nodes() const = 0;
+  virtual uint32_t max_points_per_node() const = 0;
+  virtual std::vector<PackedPoint> LoadNode(uint32_t index) = 0;
+};
+
+namespace detail {
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t node_count;
+  uint32_t max_points_per_node;
+  uint64_t point_count;
+};
+
+constexpr char kMagic[4] = {'E', '3', 'P', 'C'};
+constexpr uint32_t kVersion = 1;
+
+inline PackedPoint Pack(const Point &p, const Node &node) {
+  auto quantize = [&](int axis) {
+    float t = (p.position[axis] - node.min[axis]) / node.size;
+    return static_cast<uint16_t>(std::clamp(std::lround(t * 65535.0f), 0l, 65535l));
+  };
+  return {quantize(0), quantize(1), quantize(2), p.intensity, p.color};
+}
+
+}  // namespace detail
+
+// 在内存中构建的八叉树。构建时先在调用线程上处理最上面几层，再把各个子树交给工作线程并行构建。
+class Octree : public Source {
+ public:
+  struct Options {
+    uint32_t max_points_per_node = 20000;  // 超过该点数的节点继续细分
+    uint32_t grid_size = 128;              // 抽稀网格每边的单元数，决定节点的 spacing
+    uint32_t max_depth = 16;               // 到达该深度后不再细分，避免重合点无限递归
+    uint32_t parallel_depth = 2;           // 这一层的每个节点作为一个任务并行构建（最多 8^depth 个）
+  };
+
+  static std::shared_ptr<Octree> Build(const std::vector<Point> &points, JobSystem *jobs) { return Build(points, jobs, Options{}); }
+
+  static std::shared_ptr<Octree> Build(const std::vector<Point> &points, JobSystem *jobs, const Options &options) {
+    auto octree = std::shared_ptr<Octree>(new Octree(options));
+    if (points.empty())
+      return octree;
+
+    Eigen::Vector3f lo = points[0].position, hi = points[0].position;
+    for (const auto &p : points) {
+      lo = lo.cwiseMin(p.position);
+      hi = hi.cwiseMax(p.position);
+    }
+    float size = std::max((hi - lo).maxCoeff(), 1e-6f) * 1.0001f;  // 留一点余量，最大坐标不会落在边界外
+
+    std::vector<uint32_t> indices(points.size());
+    for (uint32_t i = 0; i < indices.size(); ++i)
+      indices[i] = i;
+
+    Builder builder{points, options, jobs, {}};
+    builder.BuildTop(std::move(indices), lo, size, 0, octree->tree_, -1, 0);
+    // 任务引用 builder，先等全部完成，任何一个抛出异常时其余任务也不会访问已销毁的状态
+    for (auto &pending : builder.pending)
+      pending.result.wait();
+    for (auto &pending : builder.pending) {
+      Subtree subtree = pending.result.get();
+      Append(octree->tree_, std::move(subtree), pending.parent, pending.octant);
+    }
+    return octree;
+  }
+
+  const std::vector<Node> &nodes() const override { return tree_.nodes; }
+  uint32_t max_points_per_node() const override { return max_points_; }
+  uint64_t point_count() const { return tree_.points.size(); }
+
+  std::vector<PackedPoint> LoadNode(uint32_t index) override {
+    const auto &node = tree_.nodes[index];
+    auto begin = tree_.points.begin() + static_cast<ptrdiff_t>(node.first_point);
+    return {begin, begin + node.point_count};
+  }
+
+  // 写成可流送的文件：文件头、节点表、按节点连续存放的点数据
+  void Save(const std::string &path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+      throw std::runtime_error("failed to open point cloud file " + path);
+
+    detail::FileHeader header{};
+    std::memcpy(header.magic, detail::kMagic, 4);
+    header.version = detail::kVersion;
+    header.node_count = static_cast<uint32_t>(tree_.nodes.size());
+    header.max_points_per_node = max_points_;
+    header.point_count = tree_.points.size();
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(tree_.nodes.data()), std::streamsize(tree_.nodes.size() * sizeof(Node)));
+    file.write(reinterpret_cast<const char *>(tree_.points.data()), std::streamsize(tree_.points.size() * sizeof(PackedPoint)));
+    if (!file)
+      throw std::runtime_error("failed to write point cloud file " + path);
+  }
+
+ private:
+  struct Subtree {
+    std::vector<Node> nodes;
+    std::vector<PackedPoint> points;
+  };
+
+  struct Pending {
+    int32_t parent;
+    int octant;
+    std::future<Subtree> result;
+  };
+
+  struct Builder {
+    const std::vector<Point> &points;
+    const Options &options;
+    JobSystem *jobs;
+    std::vector<Pending> pending;
+
+    // 抽稀：每个网格单元保留第一个落入的点，其余点按八分体分给子节点
+    int32_t Sample(std::vector<uint32_t> &indices, const Eigen::Vector3f &min, float size, uint32_t level, Subtree &out,
+                   std::array<std::vector<uint32_t>, 8> &children) const {
+      Node node{};
+      for (int a = 0; a < 3; ++a)
+        node.min[a] = min[a];
+      node.size = size;
+      node.level = level;
+      node.first_point = out.points.size();
+      std::fill(std::begin(node.children), std::end(node.children), -1);
+
+      bool leaf = indices.size() <= options.max_points_per_node || level >= options.max_depth;
+      uint32_t grid = options.grid_size;
+      node.spacing = size / float(grid);
+      if (leaf) {
+        for (uint32_t i : indices)
+          out.points.push_back(detail::Pack(points[i], node));
+      } else {
+        std::vector<uint64_t> occupied((size_t(grid) * grid * grid + 63) / 64, 0);
+        float cell_scale = float(grid) / size;
+        Eigen::Vector3f center = min + Eigen::Vector3f::Constant(size * 0.5f);
+        for (uint32_t i : indices) {
+          const auto &p = points[i].position;
+          Eigen::Vector3f t = (p - min) * cell_scale;
+          auto cell = [&](int a) { return std::min(uint32_t(std::max(t[a], 0.0f)), grid - 1); };
+          size_t c = (size_t(cell(2)) * grid + cell(1)) * grid + cell(0);
+          if (!(occupied[c / 64] & (1ull << (c % 64)))) {
+            occupied[c / 64] |= 1ull << (c % 64);
+            out.points.push_back(detail::Pack(points[i], node));
+          } else {
+            int octant = (p.x() >= center.x() ? 1 : 0) | (p.y() >= center.y() ? 2 : 0) | (p.z() >= center.z() ? 4 : 0);
+            children[octant].push_back(i);
+          }
+        }
+      }
+      node.point_count = static_cast<uint32_t>(out.points.size() - node.first_point);
+
+      indices.clear();
+      indices.shrink_to_fit();
+      out.nodes.push_back(node);
+      return static_cast<int32_t>(out.nodes.size() - 1);
+    }
+
+    static Eigen::Vector3f ChildMin(const Eigen::Vector3f &min, float size, int octant) {
+      float half = size * 0.5f;
+      return min + Eigen::Vector3f(octant & 1 ? half : 0.0f, octant & 2 ? half : 0.0f, octant & 4 ? half : 0.0f);
+    }
+
+    int32_t BuildSubtree(std::vector<uint32_t> indices, const Eigen::Vector3f &min, float size, uint32_t level, Subtree &out) const {
+      std::array<std::vector<uint32_t>, 8> children;
+      int32_t self = Sample(indices, min, size, level, out, children);
+      for (int c = 0; c < 8; ++c) {
+        if (!children[c].empty()) {
+          int32_t child = BuildSubtree(std::move(children[c]), ChildMin(min, size, c), size * 0.5f, level + 1, out);
+          out.nodes[self].children[c] = child;
+        }
+      }
+      return self;
+    }
+
+    // 最上面几层在调用线程上构建；到达 parallel_depth 的子树作为任务提交，完成后由调用方拼接
+    void BuildTop(std::vector<uint32_t> indices, const Eigen::Vector3f &min, float size, uint32_t level, Subtree &out, int32_t parent, int octant) {
+      if (level >= options.parallel_depth && jobs && parent >= 0) {
+        pending.push_back({parent, octant, jobs->Submit([this, indices = std::move(indices), min, size, level]() mutable {
+                             Subtree subtree;
+                             BuildSubtree(std::move(indices), min, size, level, subtree);
+                             return subtree;
+                           })});
+        return;
+      }
+
+      std::array<std::vector<uint32_t>, 8> children;
+      int32_t self = Sample(indices, min, size, level, out, children);
+      if (parent >= 0)
+        out.nodes[parent].children[octant] = self;
+      for (int c = 0; c < 8; ++c)
+        if (!children[c].empty())
+          BuildTop(std::move(children[c]), ChildMin(min, size, c), size * 0.5f, level + 1, out, self, c);
+    }
+  };
+
+  explicit Octree(const Options &options) : max_points_(options.max_points_per_node) {}
+
+  static void Append(Subtree &tree, Subtree subtree, int32_t parent, int octant) {
+    auto node_base = static_cast<int32_t>(tree.nodes.size());
+    uint64_t point_base = tree.points.size();
+    for (auto &node : subtree.nodes) {
+      node.first_point += point_base;
+      for (auto &child : node.children)
+        if (child >= 0)
+          child += node_base;
+      tree.nodes.push_back(node);
+    }
+    tree.points.insert(tree.points.end(), subtree.points.begin(), subtree.points.end());
+    tree.nodes[parent].children[octant] = node_base;  // 子树根节点在子树中的下标为 0
+  }
+
+  uint32_t max_points_;
+  Subtree tree_;
+};
+
+// 从 Octree::Save 写出的文件按节点读取点数据，节点表在打开时一次读入
+class OctreeFile : public Source {
+ public:
+  explicit OctreeFile(const std::string &path) : path_(path), file_(path, std::ios::binary) {
+    if (!file_)
+      throw std::runtime_error("failed to open point cloud file " + path);
+
+    detail::FileHeader header{};
+    file_.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file_ || std::memcmp(header.magic, detail::kMagic, 4) != 0 || header.version != detail::kVersion)
+      throw std::runtime_error("invalid point cloud file " + path);
+
+    nodes_.resize(header.node_count);
+    file_.read(reinterpret_cast<char *>(nodes_.data()), std::streamsize(nodes_.size() * sizeof(Node)));
+    if (!file_)
+      throw std::runtime_error("truncated point cloud file " + path);
+    max_points_ = header.max_points_per_node;
+    data_offset_ = sizeof(header) + nodes_.size() * sizeof(Node);
+  }
+
+  const std::vector<Node> &nodes() const override { return nodes_; }
+  uint32_t max_points_per_node() const override { return max_points_; }
+
+  std::vector<PackedPoint> LoadNode(uint32_t index) override {
+    const auto &node = nodes_[index];
+    std::vector<PackedPoint> points(node.point_count);
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_.seekg(std::streamoff(data_offset_ + node.first_point * sizeof(PackedPoint)));
+    file_.read(reinterpret_cast<char *>(points.data()), std::streamsize(points.size() * sizeof(PackedPoint)));
+    if (!file_)
+      throw std::runtime_error("failed to read point cloud node " + std::to_string(index) + " from " + path_);
+    return points;
+  }
+
+ private:
+  std::string path_;
+  std::mutex mutex_;
+  std::ifstream file_;
+  std::vector<Node> nodes_;
+  uint32_t max_points_{};
+  uint64_t data_offset_{};
+};
+
+// 每帧的节点选择：从根节点开始按屏幕上的投影尺寸从大到小展开，视锥外的节点剔除，
+// 点间距投影小于 min_pixel_spacing 的节点不再细化，累计点数达到 point_budget 时停止。
+// 返回的节点按优先级排列，粗的在前，流送按这个顺序加载。
+class Selector {
+ public:
+  float min_pixel_spacing{1.0f};
+  uint64_t point_budget{2000000};
+
+  // proj 为 helper::Perspective 的结果，与 meshopt::LodSelector 相同
+  void SetCamera(const Eigen::Matrix4f &view, const Eigen::Matrix4f &proj, uint32_t viewport_height) {
+    view_ = view;
+    pixels_per_unit_ = std::abs(proj(1, 1)) * 0.5f * static_cast<float>(viewport_height);
+    // 左右上下四个裁剪平面（Gribb-Hartmann）；反向 Z 的远平面在无穷远，近平面交给光栅化裁剪
+    Eigen::Matrix4f m = proj * view;
+    planes_[0] = m.row(3) + m.row(0);
+    planes_[1] = m.row(3) - m.row(0);
+    planes_[2] = m.row(3) + m.row(1);
+    planes_[3] = m.row(3) - m.row(1);
+  }
+
+  // 节点边长在屏幕上的像素数
+  float ProjectedSize(const Node &node) const { return node.size * pixels_per_unit_ / ViewDistance(node); }
+
+  bool Visible(const Node &node) const {
+    Eigen::Vector3f lo = node.Min();
+    Eigen::Vector3f hi = lo + Eigen::Vector3f::Constant(node.size);
+    for (const auto &plane : planes_) {
+      // 包围盒在平面法线方向上最远的顶点也在外侧时整个节点不可见
+      Eigen::Vector4f p(plane.x() >= 0.0f ? hi.x() : lo.x(), plane.y() >= 0.0f ? hi.y() : lo.y(), plane.z() >= 0.0f ? hi.z() : lo.z(), 1.0f);
+      if (plane.dot(p) < 0.0f)
+        return false;
+    }
+    return true;
+  }
+
+  std::vector<uint32_t> Select(const std::vector<Node> &nodes, uint64_t *selected_points = nullptr) const {
+    std::vector<uint32_t> selected;
+    uint64_t points = 0;
+    if (!nodes.empty() && Visible(nodes[0])) {
+      std::priority_queue<std::pair<float, uint32_t>> queue;
+      queue.push({ProjectedSize(nodes[0]), 0});
+      while (!queue.empty()) {
+        uint32_t index = queue.top().second;
+        queue.pop();
+        const auto &node = nodes[index];
+        if (points + node.point_count > point_budget)
+          break;
+        points += node.point_count;
+        selected.push_back(index);
+
+        if (node.spacing * pixels_per_unit_ / ViewDistance(node) < min_pixel_spacing)
+          continue;
+        for (int32_t child : node.children)
+          if (child >= 0 && Visible(nodes[child]))
+            queue.push({ProjectedSize(nodes[child]), uint32_t(child)});
+      }
+    }
+    if (selected_points)
+      *selected_points = points;
+    return selected;
+  }
+
+ private:
+  // 到包围球最近处的视深，相机在节点内时取一个很小的值，使其优先展开
+  float ViewDistance(const Node &node) const {
+    Eigen::Vector3f c = node.Center();
+    Eigen::Vector4f p = view_ * Eigen::Vector4f(c.x(), c.y(), c.z(), 1.0f);
+    float radius = node.size * 0.8660254f;
+    return std::max(p.head<3>().norm() - radius, 1e-4f);
+  }
+
+  Eigen::Matrix4f view_{Eigen::Matrix4f::Identity()};
+  float pixels_per_unit_{1.0f};
+  std::array<Eigen::Vector4f, 4> planes_{Eigen::Vector4f(0, 0, 0, 1), Eigen::Vector4f(0, 0, 0, 1), Eigen::Vector4f(0, 0, 0, 1), Eigen::Vector4f(0, 0, 0, 1)};
+};
+
+}  // namespace pointcloud
+
+}  // namespace e3d
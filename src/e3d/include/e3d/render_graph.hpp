@@ -0,0 +1,715 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "deletion_queue.hpp"
+#include "memory_budget.hpp"
+#include "pass_timer.hpp"
+
+namespace e3d {
+
+// 渲染图：每帧声明各个通道读写哪些图像/缓冲，由图计算执行顺序、插入最少的屏障和布局转换、
+// 剔除输出没有被使用的通道，并让生命周期不重叠的临时图像共用同一块显存。
+// 编译结果（执行顺序、屏障、临时资源）跨帧缓存，只有拓扑变化时才重新编译。
+class RenderGraph {
+ public:
+  using Resource = uint32_t;
+  static constexpr Resource kInvalid = UINT32_MAX;
+
+  // 资源的使用方式，决定了管线阶段、访问掩码和图像布局
+  enum class Access : uint32_t {
+    kColorAttachment,
+    kDepthAttachment,
+    kDepthRead,
+    kSampled,
+    kStorage,
+    kTransferSrc,
+    kTransferDst,
+    kVertexBuffer,
+    kIndexBuffer,
+    kUniformBuffer,
+  };
+
+  struct AccessInfo {
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    VkImageUsageFlags usage;  // 临时图像需要的用途
+  };
+
+  static AccessInfo GetAccessInfo(Access access, bool write) {
+    switch (access) {
+      case Access::kColorAttachment:
+        return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+      case Access::kDepthAttachment:
+        return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+      case Access::kDepthRead:
+        return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+      case Access::kSampled:
+        return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT};
+      case Access::kStorage:
+        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VkAccessFlags(write ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT), VK_IMAGE_LAYOUT_GENERAL,
+                VK_IMAGE_USAGE_STORAGE_BIT};
+      case Access::kTransferSrc:
+        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+      case Access::kTransferDst:
+        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+      case Access::kVertexBuffer:
+        return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0};
+      case Access::kIndexBuffer:
+        return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0};
+      case Access::kUniformBuffer:
+        return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0};
+    }
+    return {};
+  }
+
+  struct ImageDesc {
+    uint32_t width{};
+    uint32_t height{};
+    VkFormat format{};
+  };
+
+  // 通道在 setup 回调中通过 PassBuilder 声明读写
+  class PassBuilder {
+   public:
+    void Read(Resource resource, Access access) { Use(resource, access, false); }
+    void Write(Resource resource, Access access) { Use(resource, access, true); }
+    // 有副作用的通道（例如回读、提交到其他系统）不会被剔除
+    void SetSideEffect() { graph_->passes_[pass_].side_effect = true; }
+
+   private:
+    friend class RenderGraph;
+    PassBuilder(RenderGraph *graph, uint32_t pass) : graph_(graph), pass_(pass) {}
+
+    void Use(Resource resource, Access access, bool write) {
+      if (resource >= graph_->resources_.size())
+        throw std::runtime_error("render graph: invalid resource in pass " + graph_->passes_[pass_].name);
+      graph_->passes_[pass_].uses.push_back({resource, access, write});
+    }
+
+    RenderGraph *graph_;
+    uint32_t pass_;
+  };
+
+  // 提供 deletion_queue 时，重新编译换下的临时资源交给它在当前帧完成后销毁，否则立即销毁
+  RenderGraph(VkPhysicalDevice physical_device, VkDevice device, DeletionQueue *deletion_queue = nullptr)
+      : physical_device_(physical_device), device_(device), deletion_queue_(deletion_queue) {}
+
+  ~RenderGraph() { DestroyTransients(); }
+
+  // 临时资源的显存计入预算统计（render targets 类别）
+  void SetMemoryBudget(MemoryBudget *memory_budget) { memory_budget_ = memory_budget; }
+
+  // Execute 在每个通道前后写时间戳；调用方在 Execute 之前对同一个命令缓冲调用 timer->Begin
+  void SetPassTimer(PassTimer *timer) { pass_timer_ = timer; }
+
+  RenderGraph(const RenderGraph &) = delete;
+  RenderGraph &operator=(const RenderGraph &) = delete;
+
+  // 开始声明新的一帧。编译结果保留，下一次 Compile 时拓扑相同则直接复用。
+  void Reset() {
+    passes_.clear();
+    resources_.clear();
+  }
+
+  // 外部图像（例如交换链图像）。图执行前处于 initial_layout，最后一次写入发生在 initial_stage；
+  // final_layout 不为 UNDEFINED 时视为图的输出，执行结束前转换到该布局。
+  Resource ImportImage(const std::string &name, VkImage image, VkImageView view, const ImageDesc &desc, VkImageLayout initial_layout,
+                       VkPipelineStageFlags initial_stage, VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED) {
+    ResourceNode node{};
+    node.name = name;
+    node.kind = Kind::kImportedImage;
+    node.desc = desc;
+    node.image = image;
+    node.view = view;
+    node.initial_layout = initial_layout;
+    node.initial_stage = initial_stage;
+    node.final_layout = final_layout;
+    resources_.push_back(node);
+    return Resource(resources_.size() - 1);
+  }
+
+  Resource ImportBuffer(const std::string &name, VkBuffer buffer) {
+    ResourceNode node{};
+    node.name = name;
+    node.kind = Kind::kImportedBuffer;
+    node.buffer = buffer;
+    node.initial_stage = 0;  // 缓冲在帧之间由栅栏同步，首次访问不需要屏障
+    resources_.push_back(node);
+    return Resource(resources_.size() - 1);
+  }
+
+  // 由图管理的临时图像，只在本帧的通道之间使用，内存可能与其他临时图像别名
+  Resource CreateImage(const std::string &name, const ImageDesc &desc) {
+    ResourceNode node{};
+    node.name = name;
+    node.kind = Kind::kTransientImage;
+    node.desc = desc;
+    resources_.push_back(node);
+    return Resource(resources_.size() - 1);
+  }
+
+  void AddPass(const std::string &name, const std::function<void(PassBuilder &)> &setup, std::function<void(VkCommandBuffer)> execute) {
+    passes_.push_back({name, std::move(execute)});
+    PassBuilder builder(this, uint32_t(passes_.size() - 1));
+    setup(builder);
+  }
+
+  // 拓扑（通道、资源描述和读写关系）与上一次相同时复用编译结果
+  void Compile() {
+    uint64_t hash = TopologyHash();
+    if (compiled_ && hash == topology_hash_)
+      return;
+
+    DestroyTransients();
+    topology_hash_ = hash;
+    BuildOrder();
+    AllocateTransients();
+    BuildBarriers();
+    compiled_ = true;
+    generation_++;
+  }
+
+  void Execute(VkCommandBuffer cmd) {
+    if (!compiled_)
+      throw std::runtime_error("render graph: Execute before Compile");
+
+    for (const auto &step : steps_) {
+      EmitBarriers(cmd, step.barriers);
+      if (step.pass != kInvalid && passes_[step.pass].execute) {
+        if (pass_timer_)
+          pass_timer_->BeginPass(cmd, passes_[step.pass].name);
+        passes_[step.pass].execute(cmd);
+        if (pass_timer_)
+          pass_timer_->EndPass(cmd);
+      }
+    }
+  }
+
+  // 临时图像在 Compile 之后才有实际的句柄
+  VkImage GetImage(Resource resource) const { return Physical(resource).image; }
+  VkImageView GetImageView(Resource resource) const { return Physical(resource).view; }
+  const ImageDesc &GetImageDesc(Resource resource) const { return resources_[resource].desc; }
+
+  // 每次重新编译加一，依赖临时图像视图的对象（例如帧缓冲）据此重建
+  uint64_t generation() const { return generation_; }
+  uint32_t executed_pass_count() const { return uint32_t(order_.size()); }
+  uint32_t culled_pass_count() const { return uint32_t(passes_.size() - order_.size()); }
+  uint32_t barrier_count() const {
+    uint32_t count = 0;
+    for (const auto &step : steps_)
+      count += uint32_t(step.barriers.images.size() + step.barriers.buffers.size());
+    return count;
+  }
+  VkDeviceSize transient_bytes() const { return transient_bytes_; }
+  VkDeviceSize aliased_bytes() const { return aliased_bytes_; }  // 别名节省的显存
+
+  void Print(std::ostream &os) const {
+    os << "render graph: " << executed_pass_count() << " passes (" << culled_pass_count() << " culled), " << barrier_count() << " barriers, transient "
+       << (transient_bytes_ >> 10) << " KB (" << (aliased_bytes_ >> 10) << " KB saved by aliasing)\n";
+  }
+
+ private:
+  enum class Kind { kImportedImage, kImportedBuffer, kTransientImage };
+
+  struct ResourceNode {
+    std::string name;
+    Kind kind{};
+    ImageDesc desc{};
+    VkImage image{};
+    VkImageView view{};
+    VkBuffer buffer{};
+    VkImageLayout initial_layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    VkPipelineStageFlags initial_stage{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+    VkImageLayout final_layout{VK_IMAGE_LAYOUT_UNDEFINED};
+  };
+
+  struct Use {
+    Resource resource;
+    Access access;
+    bool write;
+  };
+
+  struct PassNode {
+    std::string name;
+    std::function<void(VkCommandBuffer)> execute;
+    std::vector<Use> uses;
+    bool side_effect{};
+  };
+
+  struct ImageBarrier {
+    Resource resource;
+    VkImageLayout old_layout;
+    VkImageLayout new_layout;
+    VkAccessFlags src_access;
+    VkAccessFlags dst_access;
+  };
+
+  struct BufferBarrier {
+    Resource resource;
+    VkAccessFlags src_access;
+    VkAccessFlags dst_access;
+  };
+
+  struct BarrierBatch {
+    VkPipelineStageFlags src_stage{};
+    VkPipelineStageFlags dst_stage{};
+    std::vector<ImageBarrier> images;
+    std::vector<BufferBarrier> buffers;
+  };
+
+  // 每一步先执行屏障，再执行通道；最后一步没有通道，只做输出资源的最终布局转换
+  struct Step {
+    uint32_t pass;
+    BarrierBatch barriers;
+  };
+
+  // 临时图像的实际对象
+  struct Transient {
+    VkImage image{};
+    VkImageView view{};
+    VkImageUsageFlags usage{};
+    VkMemoryRequirements requirements{};
+    uint32_t first{UINT32_MAX};  // 在执行顺序中的首次/末次使用位置
+    uint32_t last{};
+    uint32_t block{UINT32_MAX};
+  };
+
+  struct MemoryBlock {
+    VkDeviceMemory memory{};
+    VkDeviceSize size{};
+    uint32_t type_bits{};
+    std::vector<Resource> occupants;  // 按首次使用排序
+  };
+
+  // 资源在执行过程中的同步状态
+  struct State {
+    VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    VkPipelineStageFlags write_stage{};
+    VkAccessFlags write_access{};
+    VkPipelineStageFlags read_stages{};     // 上次写入之后已经同步过的读取阶段
+    VkPipelineStageFlags visible_stages{};  // 上次写入已对其可见的阶段
+  };
+
+  struct PhysicalImage {
+    VkImage image;
+    VkImageView view;
+  };
+
+  PhysicalImage Physical(Resource resource) const {
+    const auto &node = resources_[resource];
+    if (node.kind == Kind::kTransientImage)
+      return {transients_[resource].image, transients_[resource].view};
+    return {node.image, node.view};
+  }
+
+  static bool IsDepthFormat(VkFormat format) {
+    return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+           format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_X8_D24_UNORM_PACK32;
+  }
+
+  static VkImageAspectFlags AspectOf(VkFormat format) { return IsDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT; }
+
+  uint64_t TopologyHash() const {
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&](uint64_t v) { h = (h ^ v) * 1099511628211ull; };
+    for (const auto &r : resources_) {
+      mix(std::hash<std::string>()(r.name));
+      mix(uint64_t(r.kind));
+      mix(r.desc.width);
+      mix(r.desc.height);
+      mix(r.desc.format);
+      mix(r.initial_layout);
+      mix(r.initial_stage);
+      mix(r.final_layout);
+    }
+    for (const auto &p : passes_) {
+      mix(std::hash<std::string>()(p.name));
+      mix(p.side_effect);
+      for (const auto &u : p.uses)
+        mix(uint64_t(u.resource) << 32 | uint64_t(u.access) << 1 | u.write);
+    }
+    return h;
+  }
+
+  // 剔除无用通道，再按依赖关系做拓扑排序（同层按声明顺序）
+  void BuildOrder() {
+    const uint32_t pass_count = uint32_t(passes_.size());
+    std::vector<std::vector<uint32_t>> producers(pass_count);  // 每个通道读取的资源由谁写入
+    std::vector<std::vector<uint32_t>> edges(pass_count);      // 所有先后约束：写后读、读后写、写后写
+    std::vector<uint32_t> last_writer(resources_.size(), kInvalid);
+    std::vector<std::vector<uint32_t>> readers(resources_.size());
+
+    for (uint32_t p = 0; p < pass_count; ++p) {
+      for (const auto &use : passes_[p].uses) {
+        uint32_t writer = last_writer[use.resource];
+        if (writer != kInvalid && writer != p) {
+          edges[writer].push_back(p);
+          if (!use.write || use.access == Access::kColorAttachment || use.access == Access::kDepthAttachment)
+            producers[p].push_back(writer);  // 附件写入可能保留原内容，保守地当作读取
+        }
+        if (use.write) {
+          for (uint32_t reader : readers[use.resource])
+            if (reader != p)
+              edges[reader].push_back(p);
+          readers[use.resource].clear();
+        } else {
+          readers[use.resource].push_back(p);
+        }
+      }
+      for (const auto &use : passes_[p].uses)
+        if (use.write)
+          last_writer[use.resource] = p;
+    }
+
+    // 从有副作用的通道和输出资源的最终写入者出发，反向标记存活的通道
+    std::vector<bool> live(pass_count, false);
+    std::vector<uint32_t> stack;
+    for (uint32_t p = 0; p < pass_count; ++p)
+      if (passes_[p].side_effect)
+        stack.push_back(p);
+    for (Resource r = 0; r < resources_.size(); ++r)
+      if (resources_[r].final_layout != VK_IMAGE_LAYOUT_UNDEFINED && last_writer[r] != kInvalid)
+        stack.push_back(last_writer[r]);
+    while (!stack.empty()) {
+      uint32_t p = stack.back();
+      stack.pop_back();
+      if (live[p])
+        continue;
+      live[p] = true;
+      for (uint32_t producer : producers[p])
+        stack.push_back(producer);
+    }
+
+    std::vector<uint32_t> in_degree(pass_count, 0);
+    for (uint32_t p = 0; p < pass_count; ++p)
+      if (live[p])
+        for (uint32_t q : edges[p])
+          if (live[q])
+            in_degree[q]++;
+
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+    for (uint32_t p = 0; p < pass_count; ++p)
+      if (live[p] && in_degree[p] == 0)
+        ready.push(p);
+
+    order_.clear();
+    while (!ready.empty()) {
+      uint32_t p = ready.top();
+      ready.pop();
+      order_.push_back(p);
+      for (uint32_t q : edges[p])
+        if (live[q] && --in_degree[q] == 0)
+          ready.push(q);
+    }
+  }
+
+  // 为被存活通道使用的临时图像创建对象，并按生命周期把互不重叠的图像放进同一块内存
+  void AllocateTransients() {
+    transients_.assign(resources_.size(), Transient{});
+    for (uint32_t i = 0; i < order_.size(); ++i) {
+      for (const auto &use : passes_[order_[i]].uses) {
+        if (resources_[use.resource].kind != Kind::kTransientImage)
+          continue;
+        auto &t = transients_[use.resource];
+        t.usage |= GetAccessInfo(use.access, use.write).usage;
+        t.first = std::min(t.first, i);
+        t.last = std::max(t.last, i);
+      }
+    }
+
+    std::vector<Resource> used;
+    for (Resource r = 0; r < resources_.size(); ++r) {
+      if (resources_[r].kind != Kind::kTransientImage || transients_[r].first == UINT32_MAX)
+        continue;
+      auto &t = transients_[r];
+      const auto &desc = resources_[r].desc;
+
+      VkImageCreateInfo imageInfo{};
+      imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      imageInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageInfo.extent = {desc.width, desc.height, 1};
+      imageInfo.mipLevels = 1;
+      imageInfo.arrayLayers = 1;
+      imageInfo.format = desc.format;
+      imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+      imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      imageInfo.usage = t.usage;
+      imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+      imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      if (vkCreateImage(device_, &imageInfo, nullptr, &t.image) != VK_SUCCESS)
+        throw std::runtime_error("render graph: failed to create image " + resources_[r].name);
+      Track(t.image);
+      vkGetImageMemoryRequirements(device_, t.image, &t.requirements);
+      used.push_back(r);
+    }
+
+    // 大的先放；放进第一个类型兼容且所有占用者生命周期都不重叠的块
+    std::sort(used.begin(), used.end(), [&](Resource a, Resource b) { return transients_[a].requirements.size > transients_[b].requirements.size; });
+    transient_bytes_ = 0;
+    aliased_bytes_ = 0;
+    for (Resource r : used) {
+      auto &t = transients_[r];
+      for (uint32_t b = 0; b < blocks_.size() && t.block == UINT32_MAX; ++b) {
+        auto &block = blocks_[b];
+        if (!(block.type_bits & t.requirements.memoryTypeBits) || t.requirements.size > block.size)
+          continue;
+        bool overlap = false;
+        for (Resource o : block.occupants)
+          overlap |= !(t.last < transients_[o].first || transients_[o].last < t.first);
+        if (!overlap) {
+          t.block = b;
+          block.type_bits &= t.requirements.memoryTypeBits;
+          aliased_bytes_ += t.requirements.size;
+        }
+      }
+      if (t.block == UINT32_MAX) {
+        t.block = uint32_t(blocks_.size());
+        blocks_.push_back({VK_NULL_HANDLE, t.requirements.size, t.requirements.memoryTypeBits, {}});
+        transient_bytes_ += t.requirements.size;
+      }
+      blocks_[t.block].occupants.push_back(r);
+    }
+
+    for (auto &block : blocks_) {
+      std::sort(block.occupants.begin(), block.occupants.end(), [&](Resource a, Resource b) { return transients_[a].first < transients_[b].first; });
+
+      VkMemoryAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocInfo.allocationSize = block.size;
+      allocInfo.memoryTypeIndex = FindMemoryType(block.type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      if (vkAllocateMemory(device_, &allocInfo, nullptr, &block.memory) != VK_SUCCESS)
+        throw std::runtime_error("render graph: failed to allocate transient memory");
+      Track(block.memory);
+      if (memory_budget_)
+        memory_budget_->OnAllocate(block.memory, allocInfo.memoryTypeIndex, block.size, MemoryCategory::kRenderTargets);
+
+      for (Resource r : block.occupants) {
+        auto &t = transients_[r];
+        vkBindImageMemory(device_, t.image, block.memory, 0);
+        t.view = CreateView(t.image, resources_[r].desc.format);
+      }
+    }
+  }
+
+  // 按执行顺序模拟每个资源的状态，只在布局变化、写后读/写、读后写时插入屏障
+  void BuildBarriers() {
+    std::vector<State> states(resources_.size());
+    for (Resource r = 0; r < resources_.size(); ++r) {
+      const auto &node = resources_[r];
+      auto &state = states[r];
+      if (node.kind == Kind::kTransientImage) {
+        // 临时图像的旧内容无意义；但要等待同一块内存上一个占用者（或上一帧的自己）用完
+        const auto &t = transients_[r];
+        if (t.block == UINT32_MAX)
+          continue;
+        const auto &occupants = blocks_[t.block].occupants;
+        auto it = std::find(occupants.begin(), occupants.end(), r);
+        Resource previous = it == occupants.begin() ? occupants.back() : *(it - 1);
+        LastUse(previous, state.write_stage, state.write_access);
+      } else {
+        state.layout = node.initial_layout;
+        state.write_stage = node.initial_stage;
+      }
+    }
+
+    steps_.clear();
+    for (uint32_t p : order_) {
+      Step step{p, {}};
+      for (const auto &use : passes_[p].uses)
+        Transition(states[use.resource], use.resource, GetAccessInfo(use.access, use.write), use.write, step.barriers);
+      steps_.push_back(std::move(step));
+    }
+
+    // 输出资源转换到最终布局（例如交换链图像转换到 PRESENT_SRC）
+    Step final_step{kInvalid, {}};
+    for (Resource r = 0; r < resources_.size(); ++r) {
+      const auto &node = resources_[r];
+      if (node.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || states[r].layout == node.final_layout)
+        continue;
+      Transition(states[r], r, {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, node.final_layout, 0}, false, final_step.barriers);
+    }
+    if (!final_step.barriers.images.empty())
+      steps_.push_back(std::move(final_step));
+  }
+
+  void Transition(State &state, Resource resource, const AccessInfo &info, bool write, BarrierBatch &batch) {
+    bool is_image = resources_[resource].kind != Kind::kImportedBuffer;
+    bool layout_change = is_image && state.layout != info.layout;
+
+    if (layout_change || write) {
+      // 写入或布局转换：等待之前的写入和读取全部完成
+      VkPipelineStageFlags src = state.write_stage | state.read_stages;
+      if (src != 0 || layout_change)
+        AddBarrier(batch, resource, src, state.write_access, info.stage, info.access, state.layout, info.layout, is_image);
+      state.layout = is_image ? info.layout : state.layout;
+      state.write_stage = info.stage;
+      state.write_access = write ? info.access : 0;
+      state.read_stages = write ? 0 : info.stage;
+      state.visible_stages = write ? 0 : info.stage;
+    } else {
+      // 读取：只有上次写入尚未对该阶段可见时才需要屏障，连续读取之间不加屏障
+      if (state.write_access != 0 && (info.stage & ~state.visible_stages) != 0) {
+        AddBarrier(batch, resource, state.write_stage, state.write_access, info.stage, info.access, state.layout, state.layout, is_image);
+        state.visible_stages |= info.stage;
+      }
+      state.read_stages |= info.stage;
+    }
+  }
+
+  static void AddBarrier(BarrierBatch &batch, Resource resource, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage,
+                         VkAccessFlags dst_access, VkImageLayout old_layout, VkImageLayout new_layout, bool is_image) {
+    batch.src_stage |= src_stage ? src_stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    batch.dst_stage |= dst_stage;
+    if (is_image)
+      batch.images.push_back({resource, old_layout, new_layout, src_access, dst_access});
+    else
+      batch.buffers.push_back({resource, src_access, dst_access});
+  }
+
+  // 资源在一帧中最后一次被使用的阶段和写访问，用于别名和跨帧的依赖
+  void LastUse(Resource resource, VkPipelineStageFlags &stage, VkAccessFlags &access) const {
+    for (auto it = order_.rbegin(); it != order_.rend(); ++it) {
+      for (const auto &use : passes_[*it].uses) {
+        if (use.resource != resource)
+          continue;
+        auto info = GetAccessInfo(use.access, use.write);
+        stage |= info.stage;
+        access |= use.write ? info.access : 0;
+      }
+      if (stage != 0)
+        return;
+    }
+  }
+
+  void EmitBarriers(VkCommandBuffer cmd, const BarrierBatch &batch) const {
+    if (batch.images.empty() && batch.buffers.empty())
+      return;
+
+    std::vector<VkImageMemoryBarrier> images;
+    images.reserve(batch.images.size());
+    for (const auto &b : batch.images) {
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.oldLayout = b.old_layout;
+      barrier.newLayout = b.new_layout;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = Physical(b.resource).image;
+      barrier.subresourceRange = {AspectOf(resources_[b.resource].desc.format), 0, 1, 0, 1};
+      barrier.srcAccessMask = b.src_access;
+      barrier.dstAccessMask = b.dst_access;
+      images.push_back(barrier);
+    }
+
+    std::vector<VkBufferMemoryBarrier> buffers;
+    buffers.reserve(batch.buffers.size());
+    for (const auto &b : batch.buffers) {
+      VkBufferMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.buffer = resources_[b.resource].buffer;
+      barrier.offset = 0;
+      barrier.size = VK_WHOLE_SIZE;
+      barrier.srcAccessMask = b.src_access;
+      barrier.dstAccessMask = b.dst_access;
+      buffers.push_back(barrier);
+    }
+
+    vkCmdPipelineBarrier(cmd, batch.src_stage, batch.dst_stage, 0, 0, nullptr, uint32_t(buffers.size()), buffers.data(), uint32_t(images.size()),
+                         images.data());
+  }
+
+  VkImageView CreateView(VkImage image, VkFormat format) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {AspectOf(format), 0, 1, 0, 1};
+
+    VkImageView view{};
+    if (vkCreateImageView(device_, &viewInfo, nullptr, &view) != VK_SUCCESS)
+      throw std::runtime_error("render graph: failed to create image view");
+    return Track(view);
+  }
+
+  uint32_t FindMemoryType(uint32_t type_bits, VkMemoryPropertyFlags properties) const {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physical_device_, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+      if ((type_bits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        return i;
+    throw std::runtime_error("render graph: failed to find suitable memory type");
+  }
+
+  template <typename Handle>
+  Handle Track(Handle handle) {
+    return deletion_queue_ ? deletion_queue_->Track(handle) : handle;
+  }
+
+  template <typename Handle>
+  void Release(Handle handle) {
+    if (deletion_queue_) {
+      deletion_queue_->Release(handle);
+    } else if (handle != VK_NULL_HANDLE) {
+      if constexpr (std::is_same_v<Handle, VkDeviceMemory>) {
+        if (memory_budget_)
+          memory_budget_->OnFree(handle);
+      }
+      VulkanObjectTraits<Handle>::Destroy(device_, handle);
+    }
+  }
+
+  // 重新编译前调用；没有删除队列时调用方需保证使用这些对象的帧已经执行完毕
+  void DestroyTransients() {
+    for (auto &t : transients_) {
+      Release(t.view);
+      Release(t.image);
+    }
+    for (auto &block : blocks_)
+      Release(block.memory);
+    transients_.clear();
+    blocks_.clear();
+  }
+
+  VkPhysicalDevice physical_device_;
+  VkDevice device_;
+  DeletionQueue *deletion_queue_;
+  MemoryBudget *memory_budget_{};
+  PassTimer *pass_timer_{};
+
+  // 每帧声明
+  std::vector<ResourceNode> resources_;
+  std::vector<PassNode> passes_;
+
+  // 编译结果
+  bool compiled_{};
+  uint64_t topology_hash_{};
+  uint64_t generation_{};
+  std::vector<uint32_t> order_;
+  std::vector<Step> steps_;
+  std::vector<Transient> transients_;  // 按资源下标索引，非临时资源为空
+  std::vector<MemoryBlock> blocks_;
+  VkDeviceSize transient_bytes_{};
+  VkDeviceSize aliased_bytes_{};
+};
+
+}  // namespace e3d
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define E3D_SIMD_SSE2 1
+#endif
+
+namespace e3d::simd {
+
+// 4 路浮点向量与比较掩码，供遮挡剔除、BVH 遍历等 CPU 热路径使用。
+// 有 SSE2 时直接映射到 __m128，否则退化为逐分量循环，两种实现接口相同。Load/Store 要求 16 字节对齐
+#ifdef E3D_SIMD_SSE2
+struct Float4 {
+  __m128 v;
+
+  static Float4 Load(const float *p) { return {_mm_load_ps(p)}; }
+  static Float4 Broadcast(float x) { return {_mm_set1_ps(x)}; }
+  static Float4 Ramp() { return {_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)}; }
+  void Store(float *p) const { _mm_store_ps(p, v); }
+
+  friend Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+  friend Float4 operator-(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+  friend Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+  friend Float4 Min(Float4 a, Float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+  friend Float4 Max(Float4 a, Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+  float MinElement() const {
+    __m128 m = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm_min_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(m);
+  }
+};
+
+struct Mask4 {
+  __m128 v;
+
+  friend Mask4 operator&(Mask4 a, Mask4 b) { return {_mm_and_ps(a.v, b.v)}; }
+  friend Mask4 operator|(Mask4 a, Mask4 b) { return {_mm_or_ps(a.v, b.v)}; }
+  bool Any() const { return _mm_movemask_ps(v) != 0; }
+  uint32_t Bits() const { return uint32_t(_mm_movemask_ps(v)); }  // 第 i 位对应第 i 路
+};
+
+inline Mask4 operator<(Float4 a, Float4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Mask4 operator>(Float4 a, Float4 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline Mask4 operator>=(Float4 a, Float4 b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline Mask4 operator<=(Float4 a, Float4 b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline Float4 Select(Mask4 m, Float4 a, Float4 b) { return {_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))}; }
+#else
+struct Float4 {
+  float v[4];
+
+  static Float4 Load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+  static Float4 Broadcast(float x) { return {{x, x, x, x}}; }
+  static Float4 Ramp() { return {{0.0f, 1.0f, 2.0f, 3.0f}}; }
+  void Store(float *p) const { std::copy(v, v + 4, p); }
+
+  template <typename Op>
+  static Float4 Map(Float4 a, Float4 b, Op op) {
+    return {{op(a.v[0], b.v[0]), op(a.v[1], b.v[1]), op(a.v[2], b.v[2]), op(a.v[3], b.v[3])}};
+  }
+  friend Float4 operator+(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x + y; }); }
+  friend Float4 operator-(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x - y; }); }
+  friend Float4 operator*(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x * y; }); }
+  // 与 SSE 一致：有 NaN 时返回第二个操作数
+  friend Float4 Min(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x < y ? x : y; }); }
+  friend Float4 Max(Float4 a, Float4 b) { return Map(a, b, [](float x, float y) { return x > y ? x : y; }); }
+  float MinElement() const { return std::min(std::min(v[0], v[1]), std::min(v[2], v[3])); }
+};
+
+struct Mask4 {
+  bool v[4];
+
+  friend Mask4 operator&(Mask4 a, Mask4 b) { return {{a.v[0] && b.v[0], a.v[1] && b.v[1], a.v[2] && b.v[2], a.v[3] && b.v[3]}}; }
+  friend Mask4 operator|(Mask4 a, Mask4 b) { return {{a.v[0] || b.v[0], a.v[1] || b.v[1], a.v[2] || b.v[2], a.v[3] || b.v[3]}}; }
+  bool Any() const { return v[0] || v[1] || v[2] || v[3]; }
+  uint32_t Bits() const { return uint32_t(v[0]) | uint32_t(v[1]) << 1 | uint32_t(v[2]) << 2 | uint32_t(v[3]) << 3; }
+};
+
+template <typename Op>
+inline Mask4 Compare(Float4 a, Float4 b, Op op) {
+  return {{op(a.v[0], b.v[0]), op(a.v[1], b.v[1]), op(a.v[2], b.v[2]), op(a.v[3], b.v[3])}};
+}
+inline Mask4 operator<(Float4 a, Float4 b) { return Compare(a, b, [](float x, float y) { return x < y; }); }
+inline Mask4 operator>(Float4 a, Float4 b) { return Compare(a, b, [](float x, float y) { return x > y; }); }
+inline Mask4 operator>=(Float4 a, Float4 b) { return Compare(a, b, [](float x, float y) { return x >= y; }); }
+inline Mask4 operator<=(Float4 a, Float4 b) { return Compare(a, b, [](float x, float y) { return x <= y; }); }
+inline Float4 Select(Mask4 m, Float4 a, Float4 b) {
+  return {{m.v[0] ? a.v[0] : b.v[0], m.v[1] ? a.v[1] : b.v[1], m.v[2] ? a.v[2] : b.v[2], m.v[3] ? a.v[3] : b.v[3]}};
+}
+#endif
+
+}  // namespace e3d::simd
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace e3d::sprites {
+
+// GPU 实例数据，32 字节。顶点着色器按 gl_VertexIndex 把每个实例展开成两个三角形
+struct Instance {
+  float x, y;  // 中心
+  float width, height;
+  float rotation;  // 弧度，绕中心旋转
+  uint32_t color;  // 与 lines::Vertex 相同按 0xRRGGBBAA 书写
+  uint16_t uv[4];  // 图集中的 u0, v0, u1, v1，按 UNORM16 读入
+};
+static_assert(sizeof(Instance) == 32, "sprites::Instance must stay 32 bytes");
+
+// 图集中的矩形，归一化坐标
+struct UvRect {
+  float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+};
+
+// 没有纹理的纯色精灵。其余纹理句柄需小于 2^24，排序键只有 24 位留给纹理
+constexpr uint32_t kNoTexture = ~0u;
+
+// 一段纹理相同的连续实例，对应一次绘制
+struct Batch {
+  uint32_t first;  // 第一个实例的序号
+  uint32_t count;
+  uint32_t texture;
+  float footprint;  // 按本帧该纹理最大的精灵缩放后，整张纹理在屏幕上的边长（像素），用于选择流送的 mip
+};
+
+// 精灵列表：添加时只追加到按字段分开的数组（SoA），Build 时按 (层, 纹理) 做稳定的基数排序，
+// 再按排序结果一次性写入外部提供的实例内存（通常是常驻映射的缓冲）。层越小越先画；
+// 同一层内纹理相同的精灵合并为一次绘制，不同纹理之间的先后不保证，同一纹理内保持添加顺序。
+class SpriteList {
+ public:
+  void Reserve(size_t count) {
+    if (count > capacity_)
+      Grow(count);
+  }
+
+  // 容量保留，下一帧添加时不再分配
+  void Clear() { size_ = 0; }
+
+  void Add(const Eigen::Vector2f &position, const Eigen::Vector2f &size, float rotation, uint32_t color, const UvRect &uv, uint32_t texture,
+           uint8_t layer = 0) {
+    if (size_ == capacity_)
+      Grow(std::max<size_t>(capacity_ * 2, 1024));
+    // 排序键在高 32 位：层占 8 位，纹理占 24 位（kNoTexture 为全 1），低 32 位是添加顺序
+    uint64_t key = uint64_t(layer) << 24 | (texture & kTextureMask);
+    size_t i = size_++;
+    keys_[i] = key << 32 | uint64_t(i);
+    x_[i] = position.x();
+    y_[i] = position.y();
+    width_[i] = size.x();
+    height_[i] = size.y();
+    rotation_[i] = rotation;
+    color_[i] = color;
+    uv_[i] = PackUv(uv);
+  }
+
+  // 纯色、无旋转的矩形
+  void Add(const Eigen::Vector2f &position, const Eigen::Vector2f &size, uint32_t color, uint8_t layer = 0) {
+    Add(position, size, 0.0f, color, UvRect{}, kNoTexture, layer);
+  }
+
+  size_t size() const { return size_; }
+
+  // 排序后写入 out，返回所有批次。超出 capacity 的精灵（排序后最靠后的）被丢弃并计数。
+  // 按添加顺序顺序读取各数组、把整条实例写到排序后的位置：读是顺序的，写入流的数量等于不同 (层, 纹理) 的数量，
+  // 比按排序结果随机读取 SoA 的每个数组快得多
+  const std::vector<Batch> &Build(Instance *out, uint32_t capacity) {
+    batches_.clear();
+    size_t n = size_;
+    bool sorted = Sort();
+
+    uint32_t count = uint32_t(std::min<size_t>(n, capacity));
+    dropped_ = n - count;
+    for (uint32_t i = 0; i < count;) {
+      uint32_t texture = uint32_t(keys_[i] >> 32) & kTextureMask;
+      uint32_t first = i;
+      while (i < count && (uint32_t(keys_[i] >> 32) & kTextureMask) == texture)
+        ++i;
+      batches_.push_back({first, i - first, texture == kTextureMask ? kNoTexture : texture, 0.0f});
+    }
+
+    // 每种纹理的最大屏幕尺寸在写入时顺带统计；无纹理的精灵统计到最后一个多余的槽位
+    uint32_t max_texture = 0;
+    for (const auto &batch : batches_)
+      if (batch.texture != kNoTexture)
+        max_texture = std::max(max_texture, batch.texture + 1);
+    footprints_.assign(max_texture + 1, 0.0f);
+
+    // 目标位置：排序结果的逆排列；没有移动时就是原位置
+    if (sorted) {
+      rank_.resize(n);
+      for (uint32_t i = 0; i < n; ++i)
+        rank_[uint32_t(keys_[i])] = i;
+    }
+    for (uint32_t s = 0; s < n; ++s) {
+      uint32_t d = sorted ? rank_[s] : s;
+      if (d >= count)
+        continue;
+      Instance instance;
+      instance.x = x_[s];
+      instance.y = y_[s];
+      instance.width = width_[s];
+      instance.height = height_[s];
+      instance.rotation = rotation_[s];
+      instance.color = color_[s];
+      std::memcpy(instance.uv, &uv_[s], sizeof(instance.uv));
+      out[d] = instance;  // 整条 32 字节一次写入，对写合并内存友好
+
+      // 精灵只占纹理的 uv 范围，整张纹理在屏幕上的边长按比例放大。先用乘法比较，只有变大时才做除法
+      uint64_t uv = uv_[s];
+      float du = float(std::max<int>(std::abs(int(uv >> 32 & 0xFFFF) - int(uv & 0xFFFF)), 1));
+      float dv = float(std::max<int>(std::abs(int(uv >> 48) - int(uv >> 16 & 0xFFFF)), 1));
+      float &footprint = footprints_[std::min(uint32_t(keys_[d] >> 32) & kTextureMask, max_texture)];
+      if (std::abs(instance.width) * 65535.0f > footprint * du)
+        footprint = std::abs(instance.width) * 65535.0f / du;
+      if (std::abs(instance.height) * 65535.0f > footprint * dv)
+        footprint = std::abs(instance.height) * 65535.0f / dv;
+    }
+    for (auto &batch : batches_)
+      if (batch.texture != kNoTexture)
+        batch.footprint = footprints_[batch.texture];
+    return batches_;
+  }
+
+  uint64_t dropped() const { return dropped_; }
+  const std::vector<Batch> &batches() const { return batches_; }
+
+ private:
+  static constexpr uint32_t kTextureMask = 0xFFFFFFu;
+
+  void Grow(size_t capacity) {
+    capacity_ = capacity;
+    for (auto *v : {&x_, &y_, &width_, &height_, &rotation_})
+      v->resize(capacity_);
+    color_.resize(capacity_);
+    uv_.resize(capacity_);
+    keys_.resize(capacity_);
+  }
+
+  static uint64_t PackUv(const UvRect &uv) {
+    auto unorm = [](float v) { return uint64_t(std::clamp(v, 0.0f, 1.0f) * 65535.0f + 0.5f); };
+    return unorm(uv.u0) | unorm(uv.v0) << 16 | unorm(uv.u1) << 32 | unorm(uv.v1) << 48;
+  }
+
+  // 对键的高 32 位做 LSD 基数排序，每趟 8 位，稳定。一次遍历统计四趟的直方图，
+  // 所有元素落在同一个桶里的趟直接跳过，只有一种纹理和层时不移动任何数据。返回是否移动过
+  bool Sort() {
+    size_t n = size_;
+    std::array<std::array<uint32_t, 256>, 4> histograms{};
+    for (size_t i = 0; i < n; ++i)
+      for (int pass = 0; pass < 4; ++pass)
+        histograms[pass][(keys_[i] >> (32 + pass * 8)) & 0xFF]++;
+
+    bool moved = false;
+    scratch_.resize(keys_.size());
+    for (int pass = 0; pass < 4; ++pass) {
+      auto &histogram = histograms[pass];
+      if (n == 0 || histogram[(keys_[0] >> (32 + pass * 8)) & 0xFF] == n)
+        continue;
+
+      uint32_t offset = 0;
+      for (auto &bucket : histogram) {
+        uint32_t c = bucket;
+        bucket = offset;
+        offset += c;
+      }
+      for (size_t i = 0; i < n; ++i)
+        scratch_[histogram[(keys_[i] >> (32 + pass * 8)) & 0xFF]++] = keys_[i];
+      keys_.swap(scratch_);
+      moved = true;
+    }
+    return moved;
+  }
+
+  std::vector<float> x_, y_, width_, height_, rotation_;
+  std::vector<uint32_t> color_;
+  std::vector<uint64_t> uv_;  // 4 个 UNORM16
+  std::vector<uint64_t> keys_;  // 高 32 位为排序键，低 32 位为精灵序号
+  std::vector<uint64_t> scratch_;
+  std::vector<uint32_t> rank_;
+  std::vector<Batch> batches_;
+  std::vector<float> footprints_;  // 按纹理句柄索引
+  size_t size_{};
+  size_t capacity_{};
+  uint64_t dropped_{};
+};
+
+}  // namespace e3d::sprites
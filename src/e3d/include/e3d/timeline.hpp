@@ -0,0 +1,212 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace e3d {
+
+class QueueTimeline;
+
+// 时间线上的一个点：timeline 的计数达到 value 时，该点之前提交到这个队列的工作都已完成
+struct SyncPoint {
+  QueueTimeline *timeline{};
+  uint64_t value{};
+};
+
+// 一次队列提交。timeline 依赖可以来自任意队列；二进制信号量只用于交换链的获取和呈现。
+struct Submission {
+  struct Wait {
+    SyncPoint point;
+    VkPipelineStageFlags stage;
+  };
+  struct BinaryWait {
+    VkSemaphore semaphore;
+    VkPipelineStageFlags stage;
+  };
+
+  std::vector<VkCommandBuffer> command_buffers;
+  std::vector<Wait> waits;
+  std::vector<BinaryWait> binary_waits;
+  std::vector<VkSemaphore> binary_signals;
+};
+
+// 队列时间线：每个队列一个 VK_KHR_timeline_semaphore（Vulkan 1.2 核心），每次提交 signal 一个递增的值。
+// 同一队列上的信号操作覆盖之前提交的全部命令，所以计数达到 n 即表示前 n 次提交都已完成，
+// CPU 可以等待或轮询任意值，不再需要为每次提交创建栅栏。
+class QueueTimeline {
+ public:
+  QueueTimeline(VkDevice device, VkQueue queue, uint32_t family_index, std::string name)
+      : device_(device), queue_(queue), family_index_(family_index), name_(std::move(name)) {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &semaphore_) != VK_SUCCESS)
+      throw std::runtime_error("failed to create timeline semaphore for " + name_);
+  }
+
+  ~QueueTimeline() { vkDestroySemaphore(device_, semaphore_, nullptr); }
+
+  QueueTimeline(const QueueTimeline &) = delete;
+  QueueTimeline &operator=(const QueueTimeline &) = delete;
+
+  VkQueue queue() const { return queue_; }
+  uint32_t family_index() const { return family_index_; }
+  VkSemaphore semaphore() const { return semaphore_; }
+  const std::string &name() const { return name_; }
+
+  // 最近一次提交将要 signal 的值
+  uint64_t submitted() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return submitted_;
+  }
+
+  // 当前已完成的值，结果会缓存以减少查询
+  uint64_t Completed() {
+    uint64_t value{};
+    VkResult err = vkGetSemaphoreCounterValue(device_, semaphore_, &value);
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("vkGetSemaphoreCounterValue failed " + std::to_string(err));
+    std::lock_guard<std::mutex> lock(mutex_);
+    completed_ = std::max(completed_, value);
+    return completed_;
+  }
+
+  bool IsComplete(uint64_t value) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (value <= completed_)
+        return true;
+    }
+    return value <= Completed();
+  }
+
+  // 等待计数达到 value，超时返回 false
+  bool Wait(uint64_t value, uint64_t timeout = UINT64_MAX) {
+    if (IsComplete(value))
+      return true;
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &semaphore_;
+    waitInfo.pValues = &value;
+    VkResult err = vkWaitSemaphores(device_, &waitInfo, timeout);
+    if (err == VK_TIMEOUT)
+      return false;
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("vkWaitSemaphores failed " + std::to_string(err));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    completed_ = std::max(completed_, value);
+    return true;
+  }
+
+  void WaitIdle() { Wait(submitted()); }
+
+  // 提交并返回本次提交完成时的同步点。可以从多个线程调用，队列访问在内部串行化。
+  SyncPoint Submit(const Submission &submission) {
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStages;
+    for (const auto &wait : submission.waits) {
+      if (wait.point.timeline == this)
+        continue;  // 同一队列按提交顺序执行，不需要等待自己
+      waitSemaphores.push_back(wait.point.timeline->semaphore());
+      waitValues.push_back(wait.point.value);
+      waitStages.push_back(wait.stage);
+    }
+    for (const auto &wait : submission.binary_waits) {
+      waitSemaphores.push_back(wait.semaphore);
+      waitValues.push_back(0);  // 二进制信号量忽略该值
+      waitStages.push_back(wait.stage);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t value = submitted_ + 1;
+
+    std::vector<VkSemaphore> signalSemaphores = {semaphore_};
+    std::vector<uint64_t> signalValues = {value};
+    for (auto semaphore : submission.binary_signals) {
+      signalSemaphores.push_back(semaphore);
+      signalValues.push_back(0);
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = static_cast<uint32_t>(submission.command_buffers.size());
+    submitInfo.pCommandBuffers = submission.command_buffers.data();
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+    VkResult err = vkQueueSubmit(queue_, 1, &submitInfo, VK_NULL_HANDLE);
+    if (err != VK_SUCCESS)
+      throw std::runtime_error("vkQueueSubmit failed on " + name_ + " " + std::to_string(err));
+
+    submitted_ = value;
+    return {this, value};
+  }
+
+  // 呈现也要访问队列，与提交共用同一把锁
+  VkResult Present(const VkPresentInfoKHR &presentInfo) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return vkQueuePresentKHR(queue_, &presentInfo);
+  }
+
+ private:
+  VkDevice device_;
+  VkQueue queue_;
+  uint32_t family_index_;
+  std::string name_;
+  VkSemaphore semaphore_{};
+
+  mutable std::mutex mutex_;
+  uint64_t submitted_{};
+  uint64_t completed_{};
+};
+
+// CPU 等待多个（可能属于不同队列的）同步点全部完成
+inline void WaitAll(VkDevice device, const std::vector<SyncPoint> &points, uint64_t timeout = UINT64_MAX) {
+  std::vector<VkSemaphore> semaphores;
+  std::vector<uint64_t> values;
+  for (const auto &point : points) {
+    if (point.timeline && !point.timeline->IsComplete(point.value)) {
+      semaphores.push_back(point.timeline->semaphore());
+      values.push_back(point.value);
+    }
+  }
+  if (semaphores.empty())
+    return;
+
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = static_cast<uint32_t>(semaphores.size());
+  waitInfo.pSemaphores = semaphores.data();
+  waitInfo.pValues = values.data();
+  VkResult err = vkWaitSemaphores(device, &waitInfo, timeout);
+  if (err != VK_SUCCESS && err != VK_TIMEOUT)
+    throw std::runtime_error("vkWaitSemaphores failed " + std::to_string(err));
+}
+
+}  // namespace e3d
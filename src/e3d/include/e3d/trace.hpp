@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace e3d::trace {
+
+// 跟踪时钟（纳秒）。steady_clock 在 Linux 上是 CLOCK_MONOTONIC，在 Windows 上是 QueryPerformanceCounter，
+// 与 VK_EXT_calibrated_timestamps 的主机时间域一致，GPU 时间戳可以直接换算到这条时间轴上。
+inline int64_t Now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+// name 和 category 只保存指针，必须是字符串字面量或生命周期足够长的字符串
+struct Event {
+  const char *name;
+  const char *category;
+  int64_t begin_ns;
+  int64_t end_ns;
+  uint32_t track;  // 0 表示写入事件的线程本身，否则为 GPU 队列等虚拟轨道
+};
+
+// GPU 队列的虚拟轨道从这里开始编号，避免与线程编号冲突
+constexpr uint32_t kGpuTrack = 1u << 20;
+
+// 每个线程一个单生产者环形缓冲，热路径只写自己的槽位，不加锁。满了以后覆盖最旧的事件。
+// 每个槽位是一个顺序锁：第 i 个事件写入前把序号置为 2i+1，写完置为 2i+2，读者前后两次读到 2i+2 才采用，
+// 因此正在写入或已被覆盖的槽位会被丢弃。槽位字段都是 relaxed 原子量，读写并发时没有数据竞争。
+class ThreadBuffer {
+ public:
+  static constexpr uint64_t kCapacity = 1u << 15;
+
+  explicit ThreadBuffer(uint32_t tid) : tid_(tid), slots_(kCapacity) {}
+
+  uint32_t tid() const { return tid_; }
+
+  void Push(const Event &event) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    Slot &slot = slots_[head & (kCapacity - 1)];
+    slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(event.name, std::memory_order_relaxed);
+    slot.category.store(event.category, std::memory_order_relaxed);
+    slot.begin_ns.store(event.begin_ns, std::memory_order_relaxed);
+    slot.end_ns.store(event.end_ns, std::memory_order_relaxed);
+    slot.track.store(event.track, std::memory_order_relaxed);
+    slot.sequence.store(2 * head + 2, std::memory_order_release);
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  // 复制 [begin, end] 内开始的事件，可以与 Push 并发
+  void Collect(int64_t begin, int64_t end, std::vector<std::pair<uint32_t, Event>> &out) const {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t first = head > kCapacity ? head - kCapacity : 0;
+    for (uint64_t i = first; i < head; ++i) {
+      const Slot &slot = slots_[i & (kCapacity - 1)];
+      uint64_t expected = 2 * i + 2;
+      if (slot.sequence.load(std::memory_order_acquire) != expected)
+        continue;
+      Event event;
+      event.name = slot.name.load(std::memory_order_relaxed);
+      event.category = slot.category.load(std::memory_order_relaxed);
+      event.begin_ns = slot.begin_ns.load(std::memory_order_relaxed);
+      event.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+      event.track = slot.track.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != expected)
+        continue;  // 读取期间被覆盖
+      if (event.begin_ns >= begin && event.begin_ns <= end)
+        out.push_back({event.track ? event.track : tid_, event});
+    }
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const char *> name{nullptr};
+    std::atomic<const char *> category{nullptr};
+    std::atomic<int64_t> begin_ns{0};
+    std::atomic<int64_t> end_ns{0};
+    std::atomic<uint32_t> track{0};
+  };
+
+  uint32_t tid_;
+  std::vector<Slot> slots_;
+  std::atomic<uint64_t> head_{};
+};
+
+// 全局状态：线程缓冲在线程第一次记录时注册（只有这一步加锁），线程退出后缓冲仍保留到进程结束
+class Tracer {
+ public:
+  static Tracer &Get() {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  ThreadBuffer &Local() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = Register();
+    return *buffer;
+  }
+
+  void SetTrackName(uint32_t track, std::string name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    track_names_[track] = std::move(name);
+  }
+
+  void SetThreadName(std::string name) { SetTrackName(Local().tid(), std::move(name)); }
+
+  void BeginCapture() {
+    capture_begin_ = Now();
+    enabled_.store(true, std::memory_order_relaxed);
+  }
+
+  // 停止采集并把采集期间的事件写成 Chrome trace JSON（可用 Perfetto 或 chrome://tracing 打开），返回事件数
+  size_t EndCapture(const std::string &path) {
+    enabled_.store(false, std::memory_order_relaxed);
+    int64_t end = Now();
+
+    std::vector<std::pair<uint32_t, Event>> events;
+    std::map<uint32_t, std::string> names;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto &buffer : buffers_)
+        buffer->Collect(capture_begin_, end, events);
+      names = track_names_;
+    }
+    std::sort(events.begin(), events.end(), [](const auto &a, const auto &b) { return a.second.begin_ns < b.second.begin_ns; });
+
+    std::ofstream file(path);
+    if (!file)
+      throw std::runtime_error("failed to open trace file " + path);
+
+    file << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const auto &[track, name] : names) {
+      file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << track << ", \"args\": {\"name\": \""
+           << Escape(name) << "\"}}";
+      first = false;
+    }
+    // 时间以采集开始为零点，单位为微秒
+    char buf[64];
+    for (const auto &[track, event] : events) {
+      file << (first ? "" : ",\n") << "{\"name\": \"" << Escape(event.name) << "\", \"cat\": \"" << Escape(event.category)
+           << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << track;
+      std::snprintf(buf, sizeof(buf), ", \"ts\": %.3f, \"dur\": %.3f}", double(event.begin_ns - capture_begin_) * 1e-3,
+                    double(std::max<int64_t>(event.end_ns - event.begin_ns, 0)) * 1e-3);
+      file << buf;
+      first = false;
+    }
+    file << "\n]}\n";
+    return events.size();
+  }
+
+ private:
+  std::shared_ptr<ThreadBuffer> Register() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto buffer = std::make_shared<ThreadBuffer>(next_tid_++);
+    buffers_.push_back(buffer);
+    return buffer;
+  }
+
+  static std::string Escape(const char *s) {
+    std::string out;
+    for (; s && *s; ++s) {
+      if (*s == '"' || *s == '\\')
+        out += '\\';
+      if (static_cast<unsigned char>(*s) >= 0x20)
+        out += *s;
+    }
+    return out;
+  }
+  static std::string Escape(const std::string &s) { return Escape(s.c_str()); }
+
+  std::atomic<bool> enabled_{false};
+  int64_t capture_begin_{};
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+  std::map<uint32_t, std::string> track_names_;
+  uint32_t next_tid_{1};
+};
+
+inline bool Enabled() { return Tracer::Get().enabled(); }
+
+// 记录一段已经结束的时间区间，例如换算到 CPU 时钟后的 GPU 时间戳
+inline void Record(const char *name, const char *category, int64_t begin_ns, int64_t end_ns, uint32_t track = 0) {
+  if (Enabled())
+    Tracer::Get().Local().Push({name, category, begin_ns, end_ns, track});
+}
+
+inline void SetThreadName(std::string name) { Tracer::Get().SetThreadName(std::move(name)); }
+inline void SetTrackName(uint32_t track, std::string name) { Tracer::Get().SetTrackName(track, std::move(name)); }
+inline void BeginCapture() { Tracer::Get().BeginCapture(); }
+inline size_t EndCapture(const std::string &path) { return Tracer::Get().EndCapture(path); }
+
+// 作用域计时，未采集时只读一次原子标志
+class Zone {
+ public:
+  explicit Zone(const char *name, const char *category = "cpu") : name_(name), category_(category), begin_ns_(Enabled() ? Now() : -1) {}
+  ~Zone() {
+    if (begin_ns_ >= 0)
+      Record(name_, category_, begin_ns_, Now());
+  }
+
+  Zone(const Zone &) = delete;
+  Zone &operator=(const Zone &) = delete;
+
+ private:
+  const char *name_;
+  const char *category_;
+  int64_t begin_ns_;
+};
+
+}  // namespace e3d::trace
+
+#define E3D_TRACE_CONCAT_(a, b) a##b
+#define E3D_TRACE_CONCAT(a, b) E3D_TRACE_CONCAT_(a, b)
+
+// 定义 E3D_NO_TRACE 时插桩完全去除
+#ifdef E3D_NO_TRACE
+#define E3D_TRACE_SCOPE(name)
+#define E3D_TRACE_SCOPE_CAT(name, category)
+#else
+#define E3D_TRACE_SCOPE(name) ::e3d::trace::Zone E3D_TRACE_CONCAT(e3d_trace_zone_, __LINE__)(name)
+#define E3D_TRACE_SCOPE_CAT(name, category) ::e3d::trace::Zone E3D_TRACE_CONCAT(e3d_trace_zone_, __LINE__)(name, category)
+#endif
@@ -1,4 +1,5 @@
 #include <e3d/e3d.h>
+#include <e3d/trace.hpp>
 
 #include "window/iWindow.h"
 namespace e3d {
@@ -19,8 +20,13 @@ class E3dImpl : public Engine {
   void E3dImpl::run() {
     bool running = true;
     while (running) {
+      E3D_TRACE_SCOPE("E3dImpl::run");
       WindowEvent event;
-      running = window_->pollEvent(event);
+      {
+        E3D_TRACE_SCOPE("pollEvent");
+        running = window_->pollEvent(event);
+      }
+      E3D_TRACE_SCOPE("event listener");
       userFunc_(event);
     }
   }
@@ -1,17 +1,26 @@
 #version 450
 
+// MeshFeatures 的功能位，创建管线时特化
+layout(constant_id = 0) const bool VERTEX_COLOR = true;
+
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
 
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+} pc;
+
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 fragColor;
 
+// 深度预通道与颜色通道是不同的特化管线，颜色通道用 EQUAL 深度测试，两者的位置必须逐位相同
+invariant gl_Position;
+
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
+    gl_Position = ubo.proj * ubo.view * pc.model * vec4(inPosition, 0.0, 1.0);
+    fragColor = VERTEX_COLOR ? inColor : vec3(0.8);
 }
@@ -0,0 +1,17 @@
+#version 450
+
+// 与 LineConstants 对应
+layout(push_constant) uniform PushConstants {
+    mat4 view_proj;
+    vec4 params;  // xy 为视口尺寸，z 为线宽（像素）
+} pc;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec4 inColor;  // 0xRRGGBBAA 按 R8G8B8A8 读入，分量顺序相反
+
+layout(location = 0) out vec4 fragColor;
+
+void main() {
+    gl_Position = pc.view_proj * vec4(inPosition, 1.0);
+    fragColor = inColor.abgr;
+}
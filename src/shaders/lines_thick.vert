@@ -0,0 +1,52 @@
+#version 450
+
+// 与 LineConstants 对应
+layout(push_constant) uniform PushConstants {
+    mat4 view_proj;
+    vec4 params;  // xy 为视口尺寸，z 为线宽（像素）
+} pc;
+
+// 每条线段一个实例，两个端点按实例读取；每个实例 6 个顶点组成屏幕空间的四边形
+layout(location = 0) in vec3 inPositionA;
+layout(location = 1) in vec4 inColorA;
+layout(location = 2) in vec3 inPositionB;
+layout(location = 3) in vec4 inColorB;
+
+layout(location = 0) out vec4 fragColor;
+
+// x 选择端点，y 选择在线段哪一侧
+const vec2 corners[6] = vec2[](vec2(0.0, -1.0), vec2(0.0, 1.0), vec2(1.0, -1.0), vec2(1.0, -1.0), vec2(0.0, 1.0), vec2(1.0, 1.0));
+
+void main() {
+    vec4 a = pc.view_proj * vec4(inPositionA, 1.0);
+    vec4 b = pc.view_proj * vec4(inPositionB, 1.0);
+
+    // 端点在相机后方时先沿线段裁到 w = epsilon，否则透视除法会把它翻到屏幕另一侧
+    const float epsilon = 1e-5;
+    if (a.w < epsilon && b.w < epsilon) {
+        gl_Position = vec4(0.0);  // 整条线段在相机后方，退化为零面积三角形
+        fragColor = vec4(0.0);
+        return;
+    }
+    if (a.w < epsilon)
+        a = mix(a, b, (epsilon - a.w) / (b.w - a.w));
+    else if (b.w < epsilon)
+        b = mix(b, a, (epsilon - b.w) / (a.w - b.w));
+
+    vec2 half_viewport = pc.params.xy * 0.5;
+    vec2 screen_a = a.xy / a.w * half_viewport;
+    vec2 screen_b = b.xy / b.w * half_viewport;
+    vec2 dir = screen_b - screen_a;
+    float len = length(dir);
+    dir = len > 1e-6 ? dir / len : vec2(1.0, 0.0);
+    vec2 normal = vec2(-dir.y, dir.x);
+
+    vec2 corner = corners[gl_VertexIndex];
+    vec4 position = corner.x < 0.5 ? a : b;
+    // 两端各延长半个线宽，折线连接处不留缺口
+    vec2 offset = (normal * corner.y + dir * (corner.x * 2.0 - 1.0)) * (pc.params.z * 0.5);
+    position.xy += offset / half_viewport * position.w;
+
+    gl_Position = position;
+    fragColor = (corner.x < 0.5 ? inColorA : inColorB).abgr;
+}
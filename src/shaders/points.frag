@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // 圆形点：丢弃点精灵四角
+    vec2 d = gl_PointCoord * 2.0 - 1.0;
+    if (dot(d, d) > 1.0)
+        discard;
+    outColor = vec4(fragColor, 1.0);
+}
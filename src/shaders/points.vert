@@ -0,0 +1,19 @@
+#version 450
+
+// 与 PointConstants 对应；位置按节点包围盒量化，在这里还原
+layout(push_constant) uniform PushConstants {
+    mat4 view_proj;
+    vec4 node;  // xyz 为节点包围盒最小角，w 为边长
+    float point_size;
+} pc;
+
+layout(location = 0) in vec4 inPosition;  // R16G16B16A16_UNORM，w 为强度
+layout(location = 1) in vec4 inColor;     // R8G8B8A8_UNORM
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = pc.view_proj * vec4(pc.node.xyz + inPosition.xyz * pc.node.w, 1.0);
+    gl_PointSize = pc.point_size;
+    fragColor = inColor.rgb;
+}
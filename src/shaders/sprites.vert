@@ -0,0 +1,29 @@
+#version 450
+
+// 与 SpriteConstants 对应
+layout(push_constant) uniform PushConstants {
+    mat4 transform;  // 精灵坐标（像素）到裁剪空间
+} pc;
+
+// 每个精灵一个实例（sprites::Instance），每个实例 6 个顶点组成一个四边形
+layout(location = 0) in vec4 inRect;  // xy 为中心，zw 为宽高
+layout(location = 1) in float inRotation;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in vec4 inUv;  // u0, v0, u1, v1
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragUv;
+
+const vec2 corners[6] = vec2[](vec2(-0.5, -0.5), vec2(0.5, -0.5), vec2(-0.5, 0.5), vec2(-0.5, 0.5), vec2(0.5, -0.5), vec2(0.5, 0.5));
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 offset = corner * inRect.zw;
+    float c = cos(inRotation);
+    float s = sin(inRotation);
+    vec2 position = inRect.xy + vec2(c * offset.x - s * offset.y, s * offset.x + c * offset.y);
+
+    gl_Position = pc.transform * vec4(position, 0.0, 1.0);
+    fragColor = inColor.abgr;
+    fragUv = mix(inUv.xy, inUv.zw, corner + 0.5);
+}
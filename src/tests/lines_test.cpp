@@ -0,0 +1,116 @@
+// LineList 的单元测试：只用 CPU 和 Eigen，不需要 GPU
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "e3d/lines.hpp"
+
+using e3d::lines::LineList;
+using e3d::lines::Segment;
+
+namespace {
+
+int failures = 0;
+
+void Expect(bool ok, const char *expression, int line) {
+  if (!ok) {
+    std::fprintf(stderr, "%s:%d: expected %s\n", __FILE__, line, expression);
+    ++failures;
+  }
+}
+
+#define EXPECT_TRUE(condition) Expect((condition), #condition, __LINE__)
+#define EXPECT_EQ(actual, expected) Expect((actual) == (expected), #actual " == " #expected, __LINE__)
+#define EXPECT_NEAR(actual, expected, tolerance) Expect(std::abs((actual) - (expected)) <= (tolerance), #actual " ~= " #expected, __LINE__)
+
+// 与引擎的相机相同：helper::PerspectiveReverseZ（反向 Z、远平面在无穷远），再翻转 y
+Eigen::Matrix4f EngineProjection(float fov, float aspect, float z_near) {
+  float tan_half_fov = std::tan(fov / 2.0f);
+  Eigen::Matrix4f proj = Eigen::Matrix4f::Zero();
+  proj(0, 0) = 1.0f / (aspect * tan_half_fov);
+  proj(1, 1) = -1.0f / tan_half_fov;
+  proj(2, 3) = z_near;
+  proj(3, 2) = -1.0f;
+  return proj;
+}
+
+// 正向 Z、有限远平面，深度范围 [0, 1]
+Eigen::Matrix4f ForwardProjection(float fov, float aspect, float z_near, float z_far) {
+  float tan_half_fov = std::tan(fov / 2.0f);
+  Eigen::Matrix4f proj = Eigen::Matrix4f::Zero();
+  proj(0, 0) = 1.0f / (aspect * tan_half_fov);
+  proj(1, 1) = 1.0f / tan_half_fov;
+  proj(2, 2) = z_far / (z_near - z_far);
+  proj(2, 3) = z_near * z_far / (z_near - z_far);
+  proj(3, 2) = -1.0f;
+  return proj;
+}
+
+// 与 helper::LookAt 相同
+Eigen::Matrix4f LookAt(const Eigen::Vector3f &eye, const Eigen::Vector3f &center, const Eigen::Vector3f &up) {
+  Eigen::Vector3f f = (center - eye).normalized();
+  Eigen::Vector3f s = f.cross(up.normalized()).normalized();
+  Eigen::Vector3f u = s.cross(f);
+  Eigen::Matrix4f view = Eigen::Matrix4f::Identity();
+  view.row(0) << s.transpose(), -s.dot(eye);
+  view.row(1) << u.transpose(), -u.dot(eye);
+  view.row(2) << -f.transpose(), f.dot(eye);
+  return view;
+}
+
+// 画出视锥，检查所有端点有限，并返回端点沿视线方向到相机的最小和最大距离
+void FrustumDepthRange(const Eigen::Matrix4f &view_proj, const Eigen::Vector3f &eye, const Eigen::Vector3f &forward, float max_distance, float &min_depth,
+                       float &max_depth) {
+  std::vector<Segment> segments(16);
+  LineList list(segments.data(), uint32_t(segments.size()));
+  list.Frustum(view_proj, 0xFFFFFFFF, max_distance);
+  EXPECT_EQ(list.size(), 12u);
+
+  min_depth = INFINITY;
+  max_depth = -INFINITY;
+  for (uint32_t i = 0; i < list.size(); ++i) {
+    for (const auto &v : {segments[i].a, segments[i].b}) {
+      Eigen::Vector3f p(v.x, v.y, v.z);
+      EXPECT_TRUE(p.allFinite());
+      float depth = (p - eye).dot(forward);
+      min_depth = std::min(min_depth, depth);
+      max_depth = std::max(max_depth, depth);
+    }
+  }
+}
+
+// 引擎自己的无穷远反向 Z 相机：远平面截断在近平面之后 max_distance 处
+void TestEngineCamera() {
+  Eigen::Vector3f eye(2.0f, 2.0f, 2.0f);
+  Eigen::Vector3f forward = -eye.normalized();
+  Eigen::Matrix4f view_proj = EngineProjection(0.8f, 16.0f / 9.0f, 0.1f) * LookAt(eye, Eigen::Vector3f::Zero(), Eigen::Vector3f(0.0f, 0.0f, 1.0f));
+  float min_depth, max_depth;
+  FrustumDepthRange(view_proj, eye, forward, 50.0f, min_depth, max_depth);
+  EXPECT_NEAR(min_depth, 0.1f, 1e-3f);
+  EXPECT_NEAR(max_depth, 50.1f, 1e-2f);
+}
+
+// 有限远平面比 max_distance 近时画到远平面，否则截断
+void TestFiniteFarPlane() {
+  Eigen::Matrix4f proj = ForwardProjection(1.0f, 1.0f, 0.5f, 10.0f);
+  Eigen::Vector3f forward(0.0f, 0.0f, -1.0f);
+  float min_depth, max_depth;
+  FrustumDepthRange(proj, Eigen::Vector3f::Zero(), forward, 100.0f, min_depth, max_depth);
+  EXPECT_NEAR(min_depth, 0.5f, 1e-3f);
+  EXPECT_NEAR(max_depth, 10.0f, 1e-2f);
+
+  FrustumDepthRange(proj, Eigen::Vector3f::Zero(), forward, 2.0f, min_depth, max_depth);
+  EXPECT_NEAR(min_depth, 0.5f, 1e-3f);
+  EXPECT_NEAR(max_depth, 2.5f, 1e-3f);
+}
+
+}  // namespace
+
+int main() {
+  TestEngineCamera();
+  TestFiniteFarPlane();
+  if (failures)
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
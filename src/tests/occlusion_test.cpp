@@ -0,0 +1,94 @@
+// OcclusionCuller 的单元测试：只用 CPU 和 Eigen，不需要 GPU
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "e3d/occlusion.hpp"
+
+using e3d::occlusion::Box;
+using e3d::occlusion::OcclusionCuller;
+using e3d::occlusion::Result;
+
+namespace {
+
+int failures = 0;
+
+void Expect(bool ok, const char *expression, int line) {
+  if (!ok) {
+    std::fprintf(stderr, "%s:%d: expected %s\n", __FILE__, line, expression);
+    ++failures;
+  }
+}
+
+#define EXPECT_EQ(actual, expected) Expect((actual) == (expected), #actual " == " #expected, __LINE__)
+
+// 与 helper::PerspectiveReverseZ 相同：反向 Z、远平面在无穷远
+Eigen::Matrix4f Perspective(float fov, float aspect, float z_near) {
+  float tan_half_fov = std::tan(fov / 2.0f);
+  Eigen::Matrix4f proj = Eigen::Matrix4f::Zero();
+  proj(0, 0) = 1.0f / (aspect * tan_half_fov);
+  proj(1, 1) = 1.0f / tan_half_fov;
+  proj(2, 3) = z_near;
+  proj(3, 2) = -1.0f;
+  return proj;
+}
+
+// 相机在原点看向 -z，z = -5 处一块盖满整个屏幕的四边形遮挡物
+void RasterizeWall(OcclusionCuller &culler) {
+  culler.Begin(Perspective(1.0f, 2.0f, 0.1f));
+  std::vector<Eigen::Vector3f> quad = {{-50, -50, -5}, {50, -50, -5}, {50, 50, -5}, {-50, 50, -5}};
+  std::vector<uint16_t> indices = {0, 1, 2, 0, 2, 3};
+  culler.AddOccluder(indices, quad.size(), [&](uint32_t i) { return quad[i]; }, Eigen::Matrix4f::Identity());
+  culler.Rasterize();
+}
+
+void TestSingleBoxes(e3d::JobSystem *jobs) {
+  OcclusionCuller culler(jobs);
+  RasterizeWall(culler);
+  EXPECT_EQ(culler.stats().occluder_triangles, 2u);
+  EXPECT_EQ(culler.Test(Box{{-0.5f, -0.5f, -11.0f}, {0.5f, 0.5f, -10.0f}}), Result::kOccluded);  // 完全在墙后
+  EXPECT_EQ(culler.Test(Box{{-0.5f, -0.5f, -4.0f}, {0.5f, 0.5f, -3.0f}}), Result::kVisible);     // 在墙前
+  EXPECT_EQ(culler.Test(Box{{-0.5f, -0.5f, -5.5f}, {0.5f, 0.5f, -4.5f}}), Result::kVisible);     // 穿过墙
+  EXPECT_EQ(culler.Test(Box{{100.0f, -0.5f, -11.0f}, {101.0f, 0.5f, -10.0f}}), Result::kOutside);  // 屏幕右侧之外
+  EXPECT_EQ(culler.Test(Box{{-0.5f, -0.5f, -1.0f}, {0.5f, 0.5f, 1.0f}}), Result::kVisible);      // 跨越近平面
+}
+
+void TestBatch(e3d::JobSystem *jobs) {
+  OcclusionCuller culler(jobs);
+  RasterizeWall(culler);
+  std::vector<Box> boxes = {{{-0.5f, -0.5f, -11.0f}, {0.5f, 0.5f, -10.0f}},
+                            {{100.0f, 0.0f, -11.0f}, {101.0f, 1.0f, -10.0f}},
+                            {{-1.0f, -1.0f, -3.0f}, {1.0f, 1.0f, -2.0f}}};
+  std::vector<Result> results;
+  culler.Test(boxes, results);
+  EXPECT_EQ(results.size(), boxes.size());
+  EXPECT_EQ(results[0], Result::kOccluded);
+  EXPECT_EQ(results[1], Result::kOutside);
+  EXPECT_EQ(results[2], Result::kVisible);
+  EXPECT_EQ(culler.stats().tested, 3u);
+  EXPECT_EQ(culler.stats().occluded, 1u);
+  EXPECT_EQ(culler.stats().outside, 1u);
+}
+
+// 没有遮挡物时屏幕内的物体都可见
+void TestEmpty() {
+  OcclusionCuller culler(nullptr);
+  culler.Begin(Perspective(1.0f, 2.0f, 0.1f));
+  culler.Rasterize();
+  EXPECT_EQ(culler.Test(Box{{-0.5f, -0.5f, -11.0f}, {0.5f, 0.5f, -10.0f}}), Result::kVisible);
+}
+
+}  // namespace
+
+int main() {
+  e3d::JobSystem jobs(2);
+  for (e3d::JobSystem *j : {static_cast<e3d::JobSystem *>(nullptr), &jobs}) {
+    TestSingleBoxes(j);
+    TestBatch(j);
+  }
+  TestEmpty();
+  if (failures)
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+  return failures ? 1 : 0;
+}